@@ -487,6 +487,44 @@ static void drop_attr_stack(struct attr_stack **stack)
 	}
 }
 
+/*
+ * The rules that can decide an attribute for some path in one directory,
+ * in the order they are tried. Rules whose pattern cannot match anything
+ * in the directory, and rules that only set attributes nobody asked for
+ * (directly or through a macro), are left out. This is kept in the
+ * attr_check, so paths in the same directory that are checked one after
+ * another only pay for the rules that can matter to them.
+ */
+struct attr_rule {
+	const struct match_attr *a;
+	const char *base;
+	int baselen;
+};
+
+struct attr_dir_cache {
+	int valid;
+	struct strbuf dir;
+	/* the attributes that were asked for when the cache was built */
+	const struct git_attr **requested;
+	int requested_nr, requested_alloc;
+	struct attr_rule *rules;
+	int rules_nr, rules_alloc;
+	/* attributes that the rules can set, plus the requested ones */
+	int *reset;
+	int reset_nr, reset_alloc;
+};
+
+static void attr_dir_cache_free(struct attr_dir_cache *c)
+{
+	if (!c)
+		return;
+	strbuf_release(&c->dir);
+	free(c->requested);
+	free(c->rules);
+	free(c->reset);
+	free(c);
+}
+
 /* List of all attr_check structs; access should be surrounded by mutex */
 static struct check_vector {
 	size_t nr;
@@ -548,7 +586,11 @@ static void drop_all_attr_stacks(void)
 	vector_lock();
 
 	for (i = 0; i < check_vector.nr; i++) {
-		drop_attr_stack(&check_vector.checks[i]->stack);
+		struct attr_check *check = check_vector.checks[i];
+
+		drop_attr_stack(&check->stack);
+		if (check->dir_cache)
+			check->dir_cache->valid = 0;
 	}
 
 	vector_unlock();
@@ -641,6 +683,8 @@ void attr_check_clear(struct attr_check *check)
 	check->all_attrs_nr = 0;
 
 	drop_attr_stack(&check->stack);
+	attr_dir_cache_free(check->dir_cache);
+	check->dir_cache = NULL;
 }
 
 void attr_check_free(struct attr_check *check)
@@ -858,6 +902,12 @@ static void bootstrap_attr_stack(const struct index_state *istate,
 	if (*stack)
 		return;
 
+	/*
+	 * The names of the files read below are computed on first use;
+	 * do not let two threads bootstrapping their stacks race on them.
+	 */
+	vector_lock();
+
 	/* builtin frame */
 	e = read_attr_from_array(builtin_attr);
 	push_stack(stack, e, NULL, 0);
@@ -886,6 +936,8 @@ static void bootstrap_attr_stack(const struct index_state *istate,
 	if (!e)
 		e = xcalloc(1, sizeof(struct attr_stack));
 	push_stack(stack, e, NULL, 0);
+
+	vector_unlock();
 }
 
 static void prepare_attr_stack(const struct index_state *istate,
@@ -1030,27 +1082,6 @@ static int fill_one(const char *what, struct all_attrs_item *all_attrs,
 	return rem;
 }
 
-static int fill(const char *path, int pathlen, int basename_offset,
-		const struct attr_stack *stack,
-		struct all_attrs_item *all_attrs, int rem)
-{
-	for (; rem > 0 && stack; stack = stack->prev) {
-		int i;
-		const char *base = stack->origin ? stack->origin : "";
-
-		for (i = stack->num_matches - 1; 0 < rem && 0 <= i; i--) {
-			const struct match_attr *a = stack->attrs[i];
-			if (a->is_macro)
-				continue;
-			if (path_matches(path, pathlen, basename_offset,
-					 &a->u.pat, base, stack->originlen))
-				rem = fill_one("fill", all_attrs, a, rem);
-		}
-	}
-
-	return rem;
-}
-
 static int macroexpand_one(struct all_attrs_item *all_attrs, int nr, int rem)
 {
 	const struct all_attrs_item *item = &all_attrs[nr];
@@ -1083,6 +1114,195 @@ static void determine_macros(struct all_attrs_item *all_attrs,
 	}
 }
 
+static int attr_dir_cache_valid(const struct attr_check *check,
+				const char *path, int dirlen)
+{
+	const struct attr_dir_cache *c = check->dir_cache;
+	int i;
+
+	if (!c || !c->valid || c->dir.len != dirlen ||
+	    memcmp(c->dir.buf, path, dirlen) ||
+	    c->requested_nr != check->nr)
+		return 0;
+	for (i = 0; i < check->nr; i++)
+		if (c->requested[i] != check->items[i].attr)
+			return 0;
+	return 1;
+}
+
+/*
+ * Can a pattern from the .gitattributes file in 'base' match a path
+ * directly inside the directory 'dir'? The pattern's leading part
+ * without wildcards must agree with the part of 'dir' below 'base'.
+ */
+static int pattern_can_match_in_dir(const struct pattern *pat,
+				    const char *base, int baselen,
+				    const char *dir, int dirlen)
+{
+	const char *pattern = pat->pattern;
+	int prefix = pat->nowildcardlen;
+	const char *rel = dir + baselen;
+	int rellen = dirlen - baselen;
+
+	if (pat->flags & PATTERN_FLAG_NODIR)
+		return 1;
+	if (*pattern == '/') {
+		pattern++;
+		prefix--;
+	}
+	if (baselen && rellen) {
+		rel++;
+		rellen--;
+	}
+
+	if (prefix <= rellen)
+		return !fspathncmp(pattern, rel, prefix);
+	if (!rellen)
+		return 1;
+	return !fspathncmp(pattern, rel, rellen) && pattern[rellen] == '/';
+}
+
+static int sets_marked_attr(const struct match_attr *a, const char *marked)
+{
+	int i;
+
+	for (i = 0; i < a->num_attr; i++)
+		if (marked[a->state[i].attr->attr_nr])
+			return 1;
+	return 0;
+}
+
+/* Mark the attributes that macros among the marked ones expand to. */
+static void mark_macro_expansions(const struct all_attrs_item *all_attrs,
+				  int nr, char *marked)
+{
+	int i, j, changed;
+
+	do {
+		changed = 0;
+		for (i = 0; i < nr; i++) {
+			const struct match_attr *macro = all_attrs[i].macro;
+
+			if (!marked[i] || !macro)
+				continue;
+			for (j = 0; j < macro->num_attr; j++) {
+				int n = macro->state[j].attr->attr_nr;
+				if (!marked[n]) {
+					marked[n] = 1;
+					changed = 1;
+				}
+			}
+		}
+	} while (changed);
+}
+
+/*
+ * Build check->dir_cache for the directory of 'path'. check->stack must
+ * be prepared for it and the macros determined.
+ */
+static void build_attr_dir_cache(struct attr_check *check,
+				 const char *path, int dirlen)
+{
+	const struct all_attrs_item *all_attrs = check->all_attrs;
+	const struct attr_stack *stack;
+	struct attr_dir_cache *c;
+	char *relevant = NULL, *settable;
+	int i, changed;
+
+	if (!check->dir_cache) {
+		CALLOC_ARRAY(check->dir_cache, 1);
+		strbuf_init(&check->dir_cache->dir, 0);
+	}
+	c = check->dir_cache;
+	strbuf_reset(&c->dir);
+	strbuf_add(&c->dir, path, dirlen);
+	c->requested_nr = 0;
+	c->rules_nr = 0;
+	c->reset_nr = 0;
+
+	ALLOC_GROW(c->requested, check->nr, c->requested_alloc);
+	for (i = 0; i < check->nr; i++)
+		c->requested[c->requested_nr++] = check->items[i].attr;
+
+	if (check->nr) {
+		/*
+		 * Without a list of attributes every rule is relevant.
+		 * Otherwise a rule is relevant if it sets a requested
+		 * attribute, or a macro that sets a relevant one.
+		 */
+		relevant = xcalloc(check->all_attrs_nr, 1);
+		for (i = 0; i < check->nr; i++)
+			relevant[check->items[i].attr->attr_nr] = 1;
+		do {
+			changed = 0;
+			for (i = 0; i < check->all_attrs_nr; i++) {
+				if (relevant[i] || !all_attrs[i].macro ||
+				    !sets_marked_attr(all_attrs[i].macro,
+						      relevant))
+					continue;
+				relevant[i] = 1;
+				changed = 1;
+			}
+		} while (changed);
+	}
+
+	settable = xcalloc(check->all_attrs_nr, 1);
+	for (stack = check->stack; stack; stack = stack->prev) {
+		const char *base = stack->origin ? stack->origin : "";
+
+		for (i = stack->num_matches - 1; 0 <= i; i--) {
+			const struct match_attr *a = stack->attrs[i];
+			int j;
+
+			if (a->is_macro)
+				continue;
+			if (relevant && !sets_marked_attr(a, relevant))
+				continue;
+			if (!pattern_can_match_in_dir(&a->u.pat, base,
+						      stack->originlen,
+						      path, dirlen))
+				continue;
+
+			ALLOC_GROW(c->rules, c->rules_nr + 1, c->rules_alloc);
+			c->rules[c->rules_nr].a = a;
+			c->rules[c->rules_nr].base = base;
+			c->rules[c->rules_nr].baselen = stack->originlen;
+			c->rules_nr++;
+			for (j = 0; j < a->num_attr; j++)
+				settable[a->state[j].attr->attr_nr] = 1;
+		}
+	}
+	mark_macro_expansions(all_attrs, check->all_attrs_nr, settable);
+	for (i = 0; i < check->nr; i++)
+		settable[check->items[i].attr->attr_nr] = 1;
+
+	for (i = 0; i < check->all_attrs_nr; i++) {
+		if (!settable[i])
+			continue;
+		ALLOC_GROW(c->reset, c->reset_nr + 1, c->reset_alloc);
+		c->reset[c->reset_nr++] = i;
+	}
+
+	free(relevant);
+	free(settable);
+	c->valid = 1;
+}
+
+static void fill(const char *path, int pathlen, int basename_offset,
+		 const struct attr_dir_cache *c,
+		 struct all_attrs_item *all_attrs, int rem)
+{
+	int i;
+
+	for (i = 0; 0 < rem && i < c->rules_nr; i++) {
+		const struct attr_rule *r = &c->rules[i];
+
+		if (path_matches(path, pathlen, basename_offset,
+				 &r->a->u.pat, r->base, r->baselen))
+			rem = fill_one("fill", all_attrs, r->a, rem);
+	}
+}
+
 /*
  * Collect attributes for path into the array pointed to by check->all_attrs.
  * If check->check_nr is non-zero, only attributes in check[] are collected.
@@ -1110,11 +1330,25 @@ static void collect_some_attrs(const struct index_state *istate,
 	}
 
 	prepare_attr_stack(istate, path, dirlen, &check->stack);
-	all_attrs_init(&g_attr_hashmap, check);
-	determine_macros(check->all_attrs, check->stack);
+	if (attr_dir_cache_valid(check, path, dirlen)) {
+		/*
+		 * Only the attributes that the cached rules can set have
+		 * been touched since all_attrs_init().
+		 */
+		const struct attr_dir_cache *c = check->dir_cache;
+		int i;
+
+		for (i = 0; i < c->reset_nr; i++)
+			check->all_attrs[c->reset[i]].value = ATTR__UNKNOWN;
+	} else {
+		all_attrs_init(&g_attr_hashmap, check);
+		determine_macros(check->all_attrs, check->stack);
+		build_attr_dir_cache(check, path, dirlen);
+	}
 
-	rem = check->all_attrs_nr;
-	fill(path, pathlen, basename_offset, check->stack, check->all_attrs, rem);
+	rem = check->dir_cache->reset_nr;
+	fill(path, pathlen, basename_offset, check->dir_cache,
+	     check->all_attrs, rem);
 }
 
 void git_check_attr(const struct index_state *istate,
@@ -1134,6 +1368,19 @@ void git_check_attr(const struct index_state *istate,
 	}
 }
 
+void git_check_attr_batch(const struct index_state *istate,
+			  int nr, const char **paths,
+			  struct attr_check *check,
+			  attr_check_fn fn, void *data)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		git_check_attr(istate, paths[i], check);
+		fn(paths[i], check, data);
+	}
+}
+
 void git_all_attrs(const struct index_state *istate,
 		   const char *path, struct attr_check *check)
 {
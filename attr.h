@@ -105,6 +105,21 @@
  * returned `attr_check.items[]` objects.)
  *
  * - Free the `attr_check` struct by calling `attr_check_free()`.
+ *
+ *
+ * Querying Many Paths
+ * -------------------
+ *
+ * An `attr_check` remembers which rules can apply to the paths in the
+ * directory it was last asked about, so checking paths in sorted order
+ * (e.g. in index order) lets the paths of one directory share that work.
+ * `git_check_attr_batch()` checks a whole list of paths at once.
+ *
+ * The state used for a lookup lives in the `attr_check`, so several
+ * threads can look up attributes at the same time, as long as each
+ * thread uses its own `attr_check` (see `attr_check_dup()`) and, when
+ * attributes are read from the index, object access is protected with
+ * `enable_obj_read_lock()`.
  */
 
 struct index_state;
@@ -121,6 +136,7 @@ struct git_attr;
 /* opaque structures used internally for attribute collection */
 struct all_attrs_item;
 struct attr_stack;
+struct attr_dir_cache;
 struct index_state;
 
 /*
@@ -170,6 +186,7 @@ struct attr_check {
 	int all_attrs_nr;
 	struct all_attrs_item *all_attrs;
 	struct attr_stack *stack;
+	struct attr_dir_cache *dir_cache;
 };
 
 struct attr_check *attr_check_alloc(void);
@@ -193,6 +210,19 @@ const char *git_attr_name(const struct git_attr *);
 void git_check_attr(const struct index_state *istate,
 		    const char *path, struct attr_check *check);
 
+/*
+ * Check the attributes in 'check' for each of the 'nr' paths and call
+ * 'fn' with the result. The values in check->items[] are only valid
+ * until 'fn' returns. The paths should be sorted so that paths in the
+ * same directory follow each other.
+ */
+typedef void (*attr_check_fn)(const char *path,
+			      const struct attr_check *check, void *data);
+void git_check_attr_batch(const struct index_state *istate,
+			  int nr, const char **paths,
+			  struct attr_check *check,
+			  attr_check_fn fn, void *data);
+
 /*
  * Retrieve all attributes that apply to the specified path.
  * check holds the attributes and their values.
@@ -0,0 +1,260 @@
+#include "cache.h"
+#include "batch-lstat.h"
+
+#ifdef HAVE_IO_URING
+
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <linux/io_uring.h>
+
+/*
+ * A minimal io_uring driver for IORING_OP_STATX, so that we do not
+ * need to depend on liburing.  There is a single submitter and a
+ * single reaper (the caller), so the only synchronization needed is
+ * with the kernel, through the ring head and tail indices.
+ */
+struct batch_lstat {
+	int fd;
+
+	void *sq_ring, *cq_ring;
+	size_t sq_ring_size, cq_ring_size;
+	unsigned *sq_tail, *sq_mask, *sq_array;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	/* queued, but not yet handed to the kernel */
+	unsigned int unsubmitted;
+
+	/* one slot per request in flight; unused ones are on free_slot */
+	unsigned int depth, nr_free;
+	unsigned int *free_slot;
+	struct statx *statx;
+	void **data;
+};
+
+static int statx_supported(int fd)
+{
+	struct io_uring_probe *probe;
+	size_t len = st_add(sizeof(*probe),
+			    st_mult(IORING_OP_LAST, sizeof(probe->ops[0])));
+	int ret = 0;
+
+	/* probing, and statx itself, came with Linux 5.6 */
+	probe = xcalloc(1, len);
+	if (!syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE,
+		     probe, IORING_OP_LAST) &&
+	    probe->last_op >= IORING_OP_STATX &&
+	    (probe->ops[IORING_OP_STATX].flags & IO_URING_OP_SUPPORTED))
+		ret = 1;
+	free(probe);
+	return ret;
+}
+
+static void *map_ring(int fd, size_t size, off_t offset)
+{
+	void *ring = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, fd, offset);
+	return ring == MAP_FAILED ? NULL : ring;
+}
+
+struct batch_lstat *batch_lstat_init(unsigned int depth)
+{
+	struct io_uring_params p;
+	struct batch_lstat *b;
+	unsigned int i;
+	int fd;
+
+	memset(&p, 0, sizeof(p));
+	fd = syscall(__NR_io_uring_setup, depth, &p);
+	if (fd < 0)
+		return NULL;
+	if (!statx_supported(fd)) {
+		close(fd);
+		return NULL;
+	}
+
+	b = xcalloc(1, sizeof(*b));
+	b->fd = fd;
+	b->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	b->cq_ring_size = p.cq_off.cqes +
+			  p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (b->cq_ring_size > b->sq_ring_size)
+			b->sq_ring_size = b->cq_ring_size;
+		b->sq_ring = map_ring(fd, b->sq_ring_size, IORING_OFF_SQ_RING);
+		b->cq_ring = b->sq_ring;
+	} else {
+		b->sq_ring = map_ring(fd, b->sq_ring_size, IORING_OFF_SQ_RING);
+		b->cq_ring = map_ring(fd, b->cq_ring_size, IORING_OFF_CQ_RING);
+	}
+	b->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	b->sqes = map_ring(fd, b->sqes_size, IORING_OFF_SQES);
+	if (!b->sq_ring || !b->cq_ring || !b->sqes) {
+		batch_lstat_release(b);
+		return NULL;
+	}
+
+	b->sq_tail = (unsigned *)((char *)b->sq_ring + p.sq_off.tail);
+	b->sq_mask = (unsigned *)((char *)b->sq_ring + p.sq_off.ring_mask);
+	b->sq_array = (unsigned *)((char *)b->sq_ring + p.sq_off.array);
+	b->cq_head = (unsigned *)((char *)b->cq_ring + p.cq_off.head);
+	b->cq_tail = (unsigned *)((char *)b->cq_ring + p.cq_off.tail);
+	b->cq_mask = (unsigned *)((char *)b->cq_ring + p.cq_off.ring_mask);
+	b->cqes = (struct io_uring_cqe *)((char *)b->cq_ring + p.cq_off.cqes);
+
+	/*
+	 * The completion queue is at least as large as the submission
+	 * queue, so it cannot overflow as long as no more requests than
+	 * that are in flight.
+	 */
+	b->depth = p.sq_entries;
+	ALLOC_ARRAY(b->free_slot, b->depth);
+	ALLOC_ARRAY(b->statx, b->depth);
+	ALLOC_ARRAY(b->data, b->depth);
+	for (i = 0; i < b->depth; i++)
+		b->free_slot[i] = b->depth - i - 1;
+	b->nr_free = b->depth;
+	return b;
+}
+
+int batch_lstat_queue(struct batch_lstat *b, const char *path, void *data)
+{
+	unsigned tail = *b->sq_tail;
+	unsigned index = tail & *b->sq_mask;
+	struct io_uring_sqe *sqe = &b->sqes[index];
+	unsigned int slot;
+
+	if (!b->nr_free)
+		return -1;
+	slot = b->free_slot[--b->nr_free];
+	b->data[slot] = data;
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_STATX;
+	sqe->fd = AT_FDCWD;
+	sqe->addr = (uintptr_t)path;
+	sqe->len = STATX_BASIC_STATS;
+	sqe->off = (uintptr_t)&b->statx[slot];
+	sqe->statx_flags = AT_SYMLINK_NOFOLLOW;
+	sqe->user_data = slot;
+	b->sq_array[index] = index;
+	__atomic_store_n(b->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	b->unsubmitted++;
+	return 0;
+}
+
+static void statx_to_stat(const struct statx *stx, struct stat *st)
+{
+	memset(st, 0, sizeof(*st));
+	st->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+	st->st_ino = stx->stx_ino;
+	st->st_mode = stx->stx_mode;
+	st->st_nlink = stx->stx_nlink;
+	st->st_uid = stx->stx_uid;
+	st->st_gid = stx->stx_gid;
+	st->st_size = stx->stx_size;
+	st->st_mtim.tv_sec = stx->stx_mtime.tv_sec;
+	st->st_mtim.tv_nsec = stx->stx_mtime.tv_nsec;
+	st->st_ctim.tv_sec = stx->stx_ctime.tv_sec;
+	st->st_ctim.tv_nsec = stx->stx_ctime.tv_nsec;
+	st->st_atim.tv_sec = stx->stx_atime.tv_sec;
+	st->st_atim.tv_nsec = stx->stx_atime.tv_nsec;
+}
+
+int batch_lstat_next(struct batch_lstat *b, void **data,
+		     struct stat *st, int *err)
+{
+	struct io_uring_cqe *cqe;
+	unsigned head = *b->cq_head;
+	unsigned int slot;
+	int res;
+
+	if (b->nr_free == b->depth)
+		return 0;
+
+	for (;;) {
+		int ready = head != __atomic_load_n(b->cq_tail, __ATOMIC_ACQUIRE);
+		int ret;
+
+		if (ready && !b->unsubmitted)
+			break;
+		ret = syscall(__NR_io_uring_enter, b->fd, b->unsubmitted,
+			      ready ? 0 : 1,
+			      ready ? 0 : IORING_ENTER_GETEVENTS, NULL, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			die_errno(_("unable to wait for lstat() results"));
+		}
+		b->unsubmitted -= ret;
+		if (ready)
+			break;
+	}
+
+	cqe = &b->cqes[head & *b->cq_mask];
+	slot = cqe->user_data;
+	res = cqe->res;
+	__atomic_store_n(b->cq_head, head + 1, __ATOMIC_RELEASE);
+
+	*data = b->data[slot];
+	if (res < 0) {
+		*err = -res;
+	} else {
+		*err = 0;
+		statx_to_stat(&b->statx[slot], st);
+	}
+	b->free_slot[b->nr_free++] = slot;
+	return 1;
+}
+
+void batch_lstat_release(struct batch_lstat *b)
+{
+	void *data;
+	struct stat st;
+	int err;
+
+	if (!b)
+		return;
+
+	/* the kernel may still be writing to our buffers */
+	while (batch_lstat_next(b, &data, &st, &err))
+		; /* nothing */
+
+	if (b->sqes)
+		munmap(b->sqes, b->sqes_size);
+	if (b->cq_ring && b->cq_ring != b->sq_ring)
+		munmap(b->cq_ring, b->cq_ring_size);
+	if (b->sq_ring)
+		munmap(b->sq_ring, b->sq_ring_size);
+	close(b->fd);
+	free(b->free_slot);
+	free(b->statx);
+	free(b->data);
+	free(b);
+}
+
+#else
+
+struct batch_lstat *batch_lstat_init(unsigned int depth)
+{
+	return NULL;
+}
+
+int batch_lstat_queue(struct batch_lstat *b, const char *path, void *data)
+{
+	BUG("batched lstat() is not available");
+}
+
+int batch_lstat_next(struct batch_lstat *b, void **data,
+		     struct stat *st, int *err)
+{
+	BUG("batched lstat() is not available");
+}
+
+void batch_lstat_release(struct batch_lstat *b)
+{
+}
+
+#endif
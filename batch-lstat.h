@@ -0,0 +1,37 @@
+#ifndef BATCH_LSTAT_H
+#define BATCH_LSTAT_H
+
+/*
+ * Keep many lstat() calls in flight at once, for file systems where
+ * each call has a high latency (e.g. NFS).  This is only implemented
+ * with io_uring on Linux.  Elsewhere, or when the kernel does not
+ * support it, batch_lstat_init() returns NULL and the caller has to
+ * lstat() the paths itself.
+ */
+struct batch_lstat;
+
+/*
+ * Set up for at most `depth` requests in flight.  Returns NULL if
+ * batched lstat() is not available.
+ */
+struct batch_lstat *batch_lstat_init(unsigned int depth);
+
+/*
+ * Queue an lstat() of `path`.  `path` must stay valid until its result
+ * has been returned by batch_lstat_next().  Returns -1 without queueing
+ * anything when `depth` requests are already in flight.
+ */
+int batch_lstat_queue(struct batch_lstat *b, const char *path, void *data);
+
+/*
+ * Wait for the result of one of the queued requests.  Returns 0 when
+ * nothing is in flight.  Otherwise returns 1 and sets `*data` to what
+ * was passed to batch_lstat_queue(), and either fills in `st` and sets
+ * `*err` to 0, or sets `*err` to the errno of the failed lstat().
+ */
+int batch_lstat_next(struct batch_lstat *b, void **data,
+		     struct stat *st, int *err);
+
+void batch_lstat_release(struct batch_lstat *b);
+
+#endif /* BATCH_LSTAT_H */
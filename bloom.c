@@ -184,125 +184,176 @@ static void init_truncated_large_filter(struct bloom_filter *filter)
 	filter->len = 1;
 }
 
-struct bloom_filter *get_or_compute_bloom_filter(struct repository *r,
-						 struct commit *c,
-						 int compute_if_not_present,
-						 const struct bloom_filter_settings *settings,
-						 enum bloom_filter_computed *computed)
+struct bloom_diff_data {
+	struct hashmap pathmap;
+	int max_changes;
+	int nr_changes;
+};
+
+static void bloom_diff_add_path(struct diff_options *opt, const char *fullpath)
 {
-	struct bloom_filter *filter;
-	int i;
-	struct diff_options diffopt;
+	struct bloom_diff_data *data = opt->change_fn_data;
+	size_t len = strlen(fullpath);
+
+	if (++data->nr_changes > data->max_changes) {
+		/* the filter will be truncated anyway; stop the tree walk */
+		opt->flags.quick = 1;
+		opt->flags.has_changes = 1;
+		return;
+	}
 
-	if (computed)
-		*computed = BLOOM_NOT_COMPUTED;
+	/*
+	 * Add each leading directory of the changed file, i.e. for
+	 * 'dir/subdir/file' add 'dir' and 'dir/subdir' as well, so
+	 * the Bloom filter could be used to speed up commands like
+	 * 'git log dir/subdir', too.
+	 *
+	 * Note that directories are added without the trailing '/'.
+	 * Once a directory is found to be present already, all of its
+	 * leading directories are as well.
+	 */
+	while (len) {
+		struct pathmap_hash_entry *e;
 
-	if (!bloom_filters.slab_size)
-		return NULL;
+		FLEX_ALLOC_MEM(e, path, fullpath, len);
+		hashmap_entry_init(&e->entry, memhash(fullpath, len));
 
-	filter = bloom_filter_slab_at(&bloom_filters, c);
+		if (hashmap_get(&data->pathmap, &e->entry, NULL)) {
+			free(e);
+			break;
+		}
+		hashmap_add(&data->pathmap, &e->entry);
 
-	if (!filter->data) {
-		load_commit_graph_info(r, c);
-		if (commit_graph_position(c) != COMMIT_NOT_FROM_GRAPH)
-			load_bloom_filter_from_graph(r->objects->commit_graph, filter, c);
+		do {
+			len--;
+		} while (len && fullpath[len] != '/');
 	}
+}
 
-	if (filter->data && filter->len)
-		return filter;
-	if (!compute_if_not_present)
-		return NULL;
+static void bloom_diff_change(struct diff_options *opt,
+			      unsigned old_mode, unsigned new_mode,
+			      const struct object_id *old_oid,
+			      const struct object_id *new_oid,
+			      int old_oid_valid, int new_oid_valid,
+			      const char *fullpath,
+			      unsigned old_dirty_submodule,
+			      unsigned new_dirty_submodule)
+{
+	bloom_diff_add_path(opt, fullpath);
+}
+
+static void bloom_diff_addremove(struct diff_options *opt,
+				 int addremove, unsigned mode,
+				 const struct object_id *oid,
+				 int oid_valid,
+				 const char *fullpath, unsigned dirty_submodule)
+{
+	bloom_diff_add_path(opt, fullpath);
+}
 
+void fill_bloom_filter(struct repository *r,
+		       const struct object_id *parent,
+		       const struct object_id *oid,
+		       struct bloom_filter *filter,
+		       const struct bloom_filter_settings *settings,
+		       enum bloom_filter_computed *computed)
+{
+	struct bloom_diff_data data;
+	struct pathmap_hash_entry *e;
+	struct hashmap_iter iter;
+	struct diff_options diffopt;
+	enum bloom_filter_computed result = BLOOM_COMPUTED;
+
+	hashmap_init(&data.pathmap, pathmap_cmp, NULL, 0);
+	data.max_changes = settings->max_changed_paths;
+	data.nr_changes = 0;
+
+	/*
+	 * Collect the changed paths through our own callbacks rather
+	 * than diff_queued_diff, so that several threads can compute
+	 * filters at the same time.
+	 */
 	repo_diff_setup(r, &diffopt);
 	diffopt.flags.recursive = 1;
 	diffopt.detect_rename = 0;
-	diffopt.max_changes = settings->max_changed_paths;
+	diffopt.change = bloom_diff_change;
+	diffopt.add_remove = bloom_diff_addremove;
+	diffopt.change_fn_data = &data;
 	diff_setup_done(&diffopt);
 
-	/* ensure commit is parsed so we have parent information */
-	repo_parse_commit(r, c);
+	diff_tree_oid(parent, oid, "", &diffopt);
 
-	if (c->parents)
-		diff_tree_oid(&c->parents->item->object.oid, &c->object.oid, "", &diffopt);
-	else
-		diff_tree_oid(NULL, &c->object.oid, "", &diffopt);
-	diffcore_std(&diffopt);
+	if (data.nr_changes > settings->max_changed_paths ||
+	    hashmap_get_size(&data.pathmap) > settings->max_changed_paths) {
+		init_truncated_large_filter(filter);
+		result |= BLOOM_TRUNC_LARGE;
+		goto cleanup;
+	}
 
-	if (diff_queued_diff.nr <= settings->max_changed_paths) {
-		struct hashmap pathmap;
-		struct pathmap_hash_entry *e;
-		struct hashmap_iter iter;
-		hashmap_init(&pathmap, pathmap_cmp, NULL, 0);
-
-		for (i = 0; i < diff_queued_diff.nr; i++) {
-			const char *path = diff_queued_diff.queue[i]->two->path;
-
-			/*
-			 * Add each leading directory of the changed file, i.e. for
-			 * 'dir/subdir/file' add 'dir' and 'dir/subdir' as well, so
-			 * the Bloom filter could be used to speed up commands like
-			 * 'git log dir/subdir', too.
-			 *
-			 * Note that directories are added without the trailing '/'.
-			 */
-			do {
-				char *last_slash = strrchr(path, '/');
-
-				FLEX_ALLOC_STR(e, path, path);
-				hashmap_entry_init(&e->entry, strhash(path));
-
-				if (!hashmap_get(&pathmap, &e->entry, NULL))
-					hashmap_add(&pathmap, &e->entry);
-				else
-					free(e);
-
-				if (!last_slash)
-					last_slash = (char*)path;
-				*last_slash = '\0';
-
-			} while (*path);
-
-			diff_free_filepair(diff_queued_diff.queue[i]);
-		}
+	filter->len = (hashmap_get_size(&data.pathmap) * settings->bits_per_entry + BITS_PER_WORD - 1) / BITS_PER_WORD;
+	if (!filter->len) {
+		result |= BLOOM_TRUNC_EMPTY;
+		filter->len = 1;
+	}
+	filter->data = xcalloc(filter->len, sizeof(unsigned char));
 
-		if (hashmap_get_size(&pathmap) > settings->max_changed_paths) {
-			init_truncated_large_filter(filter);
-			if (computed)
-				*computed |= BLOOM_TRUNC_LARGE;
-			goto cleanup;
-		}
+	hashmap_for_each_entry(&data.pathmap, &iter, e, entry) {
+		struct bloom_key key;
+		fill_bloom_key(e->path, strlen(e->path), &key, settings);
+		add_key_to_filter(&key, filter, settings);
+		clear_bloom_key(&key);
+	}
 
-		filter->len = (hashmap_get_size(&pathmap) * settings->bits_per_entry + BITS_PER_WORD - 1) / BITS_PER_WORD;
-		if (!filter->len) {
-			if (computed)
-				*computed |= BLOOM_TRUNC_EMPTY;
-			filter->len = 1;
-		}
-		filter->data = xcalloc(filter->len, sizeof(unsigned char));
+cleanup:
+	hashmap_free_entries(&data.pathmap, struct pathmap_hash_entry, entry);
+	if (computed)
+		*computed = result;
+}
 
-		hashmap_for_each_entry(&pathmap, &iter, e, entry) {
-			struct bloom_key key;
-			fill_bloom_key(e->path, strlen(e->path), &key, settings);
-			add_key_to_filter(&key, filter, settings);
-		}
+struct bloom_filter *get_bloom_filter_slot(struct repository *r,
+					   struct commit *c)
+{
+	struct bloom_filter *filter;
 
-	cleanup:
-		hashmap_free_entries(&pathmap, struct pathmap_hash_entry, entry);
-	} else {
-		for (i = 0; i < diff_queued_diff.nr; i++)
-			diff_free_filepair(diff_queued_diff.queue[i]);
-		init_truncated_large_filter(filter);
+	if (!bloom_filters.slab_size)
+		return NULL;
+
+	filter = bloom_filter_slab_at(&bloom_filters, c);
 
-		if (computed)
-			*computed |= BLOOM_TRUNC_LARGE;
+	if (!filter->data) {
+		load_commit_graph_info(r, c);
+		if (commit_graph_position(c) != COMMIT_NOT_FROM_GRAPH)
+			load_bloom_filter_from_graph(r->objects->commit_graph, filter, c);
 	}
 
+	return filter;
+}
+
+struct bloom_filter *get_or_compute_bloom_filter(struct repository *r,
+						 struct commit *c,
+						 int compute_if_not_present,
+						 const struct bloom_filter_settings *settings,
+						 enum bloom_filter_computed *computed)
+{
+	struct bloom_filter *filter;
+
 	if (computed)
-		*computed |= BLOOM_COMPUTED;
+		*computed = BLOOM_NOT_COMPUTED;
+
+	filter = get_bloom_filter_slot(r, c);
+	if (!filter)
+		return NULL;
+
+	if (filter->data && filter->len)
+		return filter;
+	if (!compute_if_not_present)
+		return NULL;
 
-	free(diff_queued_diff.queue);
-	DIFF_QUEUE_CLEAR(&diff_queued_diff);
+	/* ensure commit is parsed so we have parent information */
+	repo_parse_commit(r, c);
 
+	fill_bloom_filter(r, c->parents ? &c->parents->item->object.oid : NULL,
+			  &c->object.oid, filter, settings, computed);
 	return filter;
 }
 
@@ -2,6 +2,7 @@
 #define BLOOM_H
 
 struct commit;
+struct object_id;
 struct repository;
 
 struct bloom_filter_settings {
@@ -96,6 +97,29 @@ enum bloom_filter_computed {
 	BLOOM_TRUNC_EMPTY  = (1 << 3),
 };
 
+/*
+ * Return the slot holding the Bloom filter for the given commit, after
+ * loading its filter from the commit-graph if there is one. The slot is
+ * left empty (i.e. "data" is NULL) when no filter is available yet.
+ */
+struct bloom_filter *get_bloom_filter_slot(struct repository *r,
+					   struct commit *c);
+
+/*
+ * Compute the filter for the changes between the trees of "parent"
+ * (which may be NULL for a root commit) and "oid" into "filter".
+ *
+ * This neither parses objects nor touches global diff state, so it can
+ * run in several threads at once, as long as each of them fills in a
+ * different filter and the object read lock is enabled.
+ */
+void fill_bloom_filter(struct repository *r,
+		       const struct object_id *parent,
+		       const struct object_id *oid,
+		       struct bloom_filter *filter,
+		       const struct bloom_filter_settings *settings,
+		       enum bloom_filter_computed *computed);
+
 struct bloom_filter *get_or_compute_bloom_filter(struct repository *r,
 						 struct commit *c,
 						 int compute_if_not_present,
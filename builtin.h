@@ -111,6 +111,21 @@ void setup_auto_pager(const char *cmd, int def);
 
 int is_builtin(const char *s);
 
+/*
+ * Whether the built-in `cmd` is read-only plumbing that "git resident"
+ * may run for its clients.
+ */
+int is_resident_builtin(const char *cmd);
+
+/*
+ * Run a built-in for a client of "git resident", in a process in which
+ * the repository has been set up already, with `prefix` as the prefix of
+ * the client's working directory `cwd`.  The built-in starts out in
+ * `cwd`, as it would in the client.
+ */
+int run_resident_builtin(int argc, const char **argv, const char *prefix,
+			 const char *cwd);
+
 int cmd_add(int argc, const char **argv, const char *prefix);
 int cmd_am(int argc, const char **argv, const char *prefix);
 int cmd_annotate(int argc, const char **argv, const char *prefix);
@@ -205,6 +220,7 @@ int cmd_remote_fd(int argc, const char **argv, const char *prefix);
 int cmd_repack(int argc, const char **argv, const char *prefix);
 int cmd_rerere(int argc, const char **argv, const char *prefix);
 int cmd_reset(int argc, const char **argv, const char *prefix);
+int cmd_resident(int argc, const char **argv, const char *prefix);
 int cmd_restore(int argc, const char **argv, const char *prefix);
 int cmd_rev_list(int argc, const char **argv, const char *prefix);
 int cmd_rev_parse(int argc, const char **argv, const char *prefix);
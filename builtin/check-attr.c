@@ -26,7 +26,7 @@ static const struct option check_attr_options[] = {
 	OPT_END()
 };
 
-static void output_attr(struct attr_check *check, const char *file)
+static void output_attr(const struct attr_check *check, const char *file)
 {
 	int j;
 	int cnt = check->nr;
@@ -73,6 +73,32 @@ static void check_attr(const char *prefix,
 	free(full_path);
 }
 
+static void output_batch_attr(const char *path,
+			      const struct attr_check *check, void *data)
+{
+	const char ***file = data;
+
+	output_attr(check, *(*file)++);
+}
+
+static void check_attr_paths(const char *prefix, struct attr_check *check,
+			     int nr, const char **files)
+{
+	char **full_paths;
+	int i;
+
+	ALLOC_ARRAY(full_paths, nr);
+	for (i = 0; i < nr; i++)
+		full_paths[i] = prefix_path(prefix, prefix ? strlen(prefix) : 0,
+					    files[i]);
+	git_check_attr_batch(&the_index, nr, (const char **)full_paths,
+			     check, output_batch_attr, &files);
+
+	for (i = 0; i < nr; i++)
+		free(full_paths[i]);
+	free(full_paths);
+}
+
 static void check_attr_stdin_paths(const char *prefix,
 				   struct attr_check *check,
 				   int collect_all)
@@ -179,8 +205,12 @@ int cmd_check_attr(int argc, const char **argv, const char *prefix)
 	if (stdin_paths)
 		check_attr_stdin_paths(prefix, check, all_attrs);
 	else {
-		for (i = filei; i < argc; i++)
-			check_attr(prefix, check, all_attrs, argv[i]);
+		if (all_attrs)
+			for (i = filei; i < argc; i++)
+				check_attr(prefix, check, all_attrs, argv[i]);
+		else
+			check_attr_paths(prefix, check, argc - filei,
+					 argv + filei);
 		maybe_flush_or_die(stdout, "attribute to stdout");
 	}
 
@@ -188,6 +188,8 @@ static int git_commit_graph_write_config(const char *var, const char *value,
 {
 	if (!strcmp(var, "commitgraph.maxnewfilters"))
 		write_opts.max_new_filters = git_config_int(var, value);
+	else if (!strcmp(var, "commitgraph.maxnewfilterstime"))
+		write_opts.max_new_filters_time = git_config_int(var, value);
 	/*
 	 * No need to fall-back to 'git_default_config', since this was already
 	 * called in 'cmd_commit_graph()'.
@@ -233,6 +235,10 @@ static int graph_write(int argc, const char **argv)
 		OPT_CALLBACK_F(0, "max-new-filters", &write_opts.max_new_filters,
 			NULL, N_("maximum number of changed-path Bloom filters to compute"),
 			0, write_option_max_new_filters),
+		OPT_INTEGER(0, "max-new-filters-time", &write_opts.max_new_filters_time,
+			N_("stop computing changed-path Bloom filters after this many seconds")),
+		OPT_INTEGER(0, "threads", &write_opts.threads,
+			N_("use threads when computing changed-path Bloom filters")),
 		OPT_END(),
 	};
 
@@ -242,6 +248,8 @@ static int graph_write(int argc, const char **argv)
 	write_opts.max_commits = 0;
 	write_opts.expire_time = 0;
 	write_opts.max_new_filters = -1;
+	write_opts.max_new_filters_time = 0;
+	write_opts.threads = 0;
 
 	trace2_cmd_mode("write");
 
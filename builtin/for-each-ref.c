@@ -76,6 +76,7 @@ int cmd_for_each_ref(int argc, const char **argv, const char *prefix)
 	filter.name_patterns = argv;
 	filter.match_as_path = 1;
 	filter_refs(&array, &filter, FILTER_REFS_ALL | FILTER_REFS_INCLUDE_BROKEN);
+	filter_ahead_behind(&array);
 	ref_array_sort(sorting, &array);
 
 	if (!maxcount || array.nr < maxcount)
@@ -15,6 +15,7 @@
 #include "packfile.h"
 #include "object-store.h"
 #include "promisor-remote.h"
+#include "oid-array.h"
 
 static const char index_pack_usage[] =
 "git index-pack [-v] [-o <index-file>] [--keep | --keep=<msg>] [--verify] [--strict] (<pack-file> | --stdin [--fix-thin] [<pack-file>])";
@@ -125,6 +126,9 @@ static int verbose;
 static int show_resolving_progress;
 static int show_stat;
 static int check_self_contained_and_connected;
+static int report_foreign;
+static int foreign_incomplete;
+static struct oid_array foreign_objects = OID_ARRAY_INIT;
 
 static struct progress *progress;
 
@@ -237,6 +241,12 @@ static unsigned check_object(struct object *obj)
 	if (!(obj->flags & FLAG_CHECKED)) {
 		unsigned long size;
 		int type = oid_object_info(the_repository, &obj->oid, &size);
+		if (type <= 0 && report_foreign && !strict) {
+			/* leave it to the caller's connectivity check */
+			foreign_incomplete = 1;
+			obj->flags |= FLAG_CHECKED;
+			return 1;
+		}
 		if (type <= 0)
 			die(_("did not receive expected object %s"),
 			      oid_to_hex(&obj->oid));
@@ -245,6 +255,8 @@ static unsigned check_object(struct object *obj)
 			    oid_to_hex(&obj->oid),
 			    type_name(obj->type), type_name(type));
 		obj->flags |= FLAG_CHECKED;
+		if (report_foreign && type != OBJ_BLOB)
+			oid_array_append(&foreign_objects, &obj->oid);
 		return 1;
 	}
 
@@ -836,7 +848,7 @@ static void sha1_object(const void *data, struct object_entry *obj_entry,
 		free(has_data);
 	}
 
-	if (strict || do_fsck_object) {
+	if (strict || do_fsck_object || report_foreign) {
 		read_lock();
 		if (type == OBJ_BLOB) {
 			struct blob *blob = lookup_blob(the_repository, oid);
@@ -866,7 +878,8 @@ static void sha1_object(const void *data, struct object_entry *obj_entry,
 			if (do_fsck_object &&
 			    fsck_object(obj, buf, size, &fsck_options))
 				die(_("fsck error in packed object"));
-			if (strict && fsck_walk(obj, NULL, &fsck_options))
+			if ((strict || report_foreign) &&
+			    fsck_walk(obj, NULL, &fsck_options))
 				die(_("Not all child objects of %s are reachable"), oid_to_hex(&obj->oid));
 
 			if (obj->type == OBJ_TREE) {
@@ -1431,6 +1444,13 @@ static void fix_unresolved_deltas(struct hashfile *f)
 		append_obj_to_pack(f, d->oid.hash, data, size, type);
 		threaded_second_pass(NULL);
 
+		/*
+		 * The links of a local base were never looked at, so it
+		 * is as foreign to the pack as the objects it points to.
+		 */
+		if (report_foreign && type != OBJ_BLOB)
+			oid_array_append(&foreign_objects, &d->oid);
+
 		display_progress(progress, nr_resolved_deltas);
 	}
 	free(sorted_by_pos);
@@ -1482,6 +1502,33 @@ static void write_special_file(const char *suffix, const char *msg,
 	strbuf_release(&name_buf);
 }
 
+static int add_foreign_object(const struct object_id *oid, void *data)
+{
+	struct strbuf *buf = data;
+
+	if (buf->len)
+		strbuf_addch(buf, '\n');
+	strbuf_addstr(buf, oid_to_hex(oid));
+	return 0;
+}
+
+/*
+ * List the commits, trees and tags the pack refers to without
+ * containing them, one per line, in a ".foreign" file next to the
+ * pack. Together with the links in the pack, which we checked, these
+ * are all a connectivity check needs to walk for tips in this pack.
+ */
+static void write_foreign_file(const char *pack_name, const unsigned char *hash)
+{
+	struct strbuf buf = STRBUF_INIT;
+
+	if (foreign_incomplete)
+		return;
+	oid_array_for_each_unique(&foreign_objects, add_foreign_object, &buf);
+	write_special_file("foreign", buf.buf, pack_name, hash, NULL);
+	strbuf_release(&buf);
+}
+
 static void final(const char *final_pack_name, const char *curr_pack_name,
 		  const char *final_index_name, const char *curr_index_name,
 		  const char *keep_msg, const char *promisor_msg,
@@ -1507,6 +1554,8 @@ static void final(const char *final_pack_name, const char *curr_pack_name,
 	if (promisor_msg)
 		write_special_file("promisor", promisor_msg, final_pack_name,
 				   hash, NULL);
+	if (report_foreign)
+		write_foreign_file(final_pack_name, hash);
 
 	if (final_pack_name != curr_pack_name) {
 		if (!final_pack_name)
@@ -1742,6 +1791,8 @@ int cmd_index_pack(int argc, const char **argv, const char *prefix)
 			} else if (!strcmp(arg, "--check-self-contained-and-connected")) {
 				strict = 1;
 				check_self_contained_and_connected = 1;
+			} else if (!strcmp(arg, "--report-foreign")) {
+				report_foreign = 1;
 			} else if (!strcmp(arg, "--fsck-objects")) {
 				do_fsck_object = 1;
 			} else if (!strcmp(arg, "--verify")) {
@@ -1868,7 +1919,7 @@ int cmd_index_pack(int argc, const char **argv, const char *prefix)
 	conclude_pack(fix_thin_pack, curr_pack, pack_hash);
 	free(ofs_deltas);
 	free(ref_deltas);
-	if (strict)
+	if (strict || report_foreign)
 		foreign_nr = check_objects();
 
 	if (show_stat)
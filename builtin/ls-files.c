@@ -514,7 +514,7 @@ static int option_parse_exclude_standard(const struct option *opt,
 
 int cmd_ls_files(int argc, const char **argv, const char *cmd_prefix)
 {
-	int require_work_tree = 0, show_tag = 0, i;
+	int require_work_tree = 0, show_tag = 0, i, ret;
 	const char *max_prefix;
 	struct dir_struct dir;
 	struct pattern_list *pl;
@@ -590,9 +590,6 @@ int cmd_ls_files(int argc, const char **argv, const char *cmd_prefix)
 		prefix_len = strlen(prefix);
 	git_config(git_default_config, NULL);
 
-	if (repo_read_index(the_repository) < 0)
-		die("index file corrupt");
-
 	argc = parse_options(argc, argv, prefix, builtin_ls_files_options,
 			ls_files_usage, 0);
 	pl = add_pattern_list(&dir, EXC_CMDL, "--exclude option");
@@ -650,6 +647,21 @@ int cmd_ls_files(int argc, const char **argv, const char *cmd_prefix)
 		max_prefix = common_prefix(&pathspec);
 	max_prefix_len = get_common_prefix_len(max_prefix);
 
+	/*
+	 * Unless we need to look at other parts of the index, e.g. for
+	 * untracked files, attributes, ignore rules or --with-tree, the
+	 * entries below max_prefix are all we need.
+	 */
+	if (show_others || show_killed || show_resolve_undo || show_eol ||
+	    show_fsmonitor_bit || with_tree || (dir.flags & DIR_SHOW_IGNORED) ||
+	    (pathspec.magic & PATHSPEC_ATTR) || !max_prefix)
+		ret = repo_read_index(the_repository);
+	else
+		ret = repo_read_index_subtree(the_repository, max_prefix,
+					      strlen(max_prefix));
+	if (ret < 0)
+		die("index file corrupt");
+
 	prune_index(the_repository->index, max_prefix, max_prefix_len);
 
 	/* Treat unmatching pathspec elements as errors */
@@ -109,6 +109,7 @@ static uint16_t write_bitmap_options = BITMAP_OPT_HASH_CACHE;
 static int exclude_promisor_objects;
 
 static int use_delta_islands;
+static int full_path_hash;
 
 static unsigned long delta_cache_size = 0;
 static unsigned long max_delta_cache_size = DEFAULT_DELTA_CACHE_SIZE;
@@ -290,17 +291,53 @@ static void copy_pack_data(struct hashfile *f,
 {
 	unsigned char *in;
 	unsigned long avail;
+	int zero_copy = pack_to_stdout && len >= HASHWRITE_SENDFILE_MIN;
 
 	while (len) {
 		in = use_pack(p, w_curs, offset, &avail);
 		if (avail > len)
 			avail = (unsigned long)len;
-		hashwrite(f, in, avail);
+		hashwrite_from_fd(f, in, avail,
+				  zero_copy ? use_pack_fd(p) : -1, offset);
 		offset += avail;
 		len -= avail;
 	}
 }
 
+/*
+ * When streaming a pack to stdout, objects that can be reused byte for
+ * byte are not copied one at a time. Instead, a run of such objects
+ * that are adjacent in their source pack is collected here and copied
+ * in one go once the run ends.
+ */
+static struct {
+	struct packed_git *p;
+	off_t start, end;
+} verbatim_run;
+
+static void flush_verbatim_run(struct hashfile *f)
+{
+	struct pack_window *w_curs = NULL;
+
+	if (!verbatim_run.p)
+		return;
+	copy_pack_data(f, verbatim_run.p, &w_curs, verbatim_run.start,
+		       verbatim_run.end - verbatim_run.start);
+	unuse_pack(&w_curs);
+	verbatim_run.p = NULL;
+}
+
+static void add_to_verbatim_run(struct hashfile *f, struct packed_git *p,
+				off_t offset, off_t len)
+{
+	if (verbatim_run.p != p || verbatim_run.end != offset) {
+		flush_verbatim_run(f);
+		verbatim_run.p = p;
+		verbatim_run.start = offset;
+	}
+	verbatim_run.end = offset + len;
+}
+
 /* Return 0 if we will bust the pack-size limit */
 static unsigned long write_no_reuse_object(struct hashfile *f, struct object_entry *entry,
 					   unsigned long limit, int usable_delta)
@@ -314,6 +351,8 @@ static unsigned long write_no_reuse_object(struct hashfile *f, struct object_ent
 	struct git_istream *st = NULL;
 	const unsigned hashsz = the_hash_algo->rawsz;
 
+	flush_verbatim_run(f);
+
 	if (!usable_delta) {
 		if (oe_type(entry) == OBJ_BLOB &&
 		    oe_size_greater_than(&to_pack, entry, big_file_threshold) &&
@@ -463,6 +502,28 @@ static off_t write_reuse_object(struct hashfile *f, struct object_entry *entry,
 		dheader[pos] = ofs & 127;
 		while (ofs >>= 7)
 			dheader[--pos] = 128 | (--ofs & 127);
+
+		/*
+		 * If the base sits at the same distance in front of us
+		 * as it does in the source pack, the object's bytes do
+		 * not change at all; otherwise the new offset has to
+		 * be patched in.
+		 */
+		if (pack_to_stdout &&
+		    entry->in_pack_type == OBJ_OFS_DELTA &&
+		    IN_PACK(DELTA(entry)) == p &&
+		    entry->in_pack_offset - DELTA(entry)->in_pack_offset ==
+		    entry->idx.offset - DELTA(entry)->idx.offset &&
+		    hdrlen + sizeof(dheader) - pos == entry->in_pack_header_size) {
+			unuse_pack(&w_curs);
+			add_to_verbatim_run(f, p, entry->in_pack_offset,
+					    entry->in_pack_header_size + datalen);
+			reused_delta++;
+			reused++;
+			return entry->in_pack_header_size + datalen;
+		}
+
+		flush_verbatim_run(f);
 		if (limit && hdrlen + sizeof(dheader) - pos + datalen + hashsz >= limit) {
 			unuse_pack(&w_curs);
 			return 0;
@@ -471,7 +532,22 @@ static off_t write_reuse_object(struct hashfile *f, struct object_entry *entry,
 		hashwrite(f, dheader + pos, sizeof(dheader) - pos);
 		hdrlen += sizeof(dheader) - pos;
 		reused_delta++;
+	} else if (pack_to_stdout && type == entry->in_pack_type &&
+		   hdrlen + (type == OBJ_REF_DELTA ? hashsz : 0) ==
+		   entry->in_pack_header_size) {
+		/*
+		 * A whole object, or a REF_DELTA against the same base:
+		 * the header we would write is the one already there.
+		 */
+		unuse_pack(&w_curs);
+		add_to_verbatim_run(f, p, entry->in_pack_offset,
+				    entry->in_pack_header_size + datalen);
+		if (type == OBJ_REF_DELTA)
+			reused_delta++;
+		reused++;
+		return entry->in_pack_header_size + datalen;
 	} else if (type == OBJ_REF_DELTA) {
+		flush_verbatim_run(f);
 		if (limit && hdrlen + hashsz + datalen + hashsz >= limit) {
 			unuse_pack(&w_curs);
 			return 0;
@@ -481,6 +557,7 @@ static off_t write_reuse_object(struct hashfile *f, struct object_entry *entry,
 		hdrlen += hashsz;
 		reused_delta++;
 	} else {
+		flush_verbatim_run(f);
 		if (limit && hdrlen + datalen + hashsz >= limit) {
 			unuse_pack(&w_curs);
 			return 0;
@@ -1042,6 +1119,7 @@ static void write_pack_file(void)
 				break;
 			display_progress(progress_state, written);
 		}
+		flush_verbatim_run(f);
 
 		/*
 		 * Did we write the wrong # entries in the header?
@@ -1319,13 +1397,13 @@ static int want_object_in_pack(const struct object_id *oid,
 	return 1;
 }
 
-static void create_object_entry(const struct object_id *oid,
-				enum object_type type,
-				uint32_t hash,
-				int exclude,
-				int no_try_delta,
-				struct packed_git *found_pack,
-				off_t found_offset)
+static struct object_entry *create_object_entry(const struct object_id *oid,
+						enum object_type type,
+						uint32_t hash,
+						int exclude,
+						int no_try_delta,
+						struct packed_git *found_pack,
+						off_t found_offset)
 {
 	struct object_entry *entry;
 
@@ -1342,6 +1420,8 @@ static void create_object_entry(const struct object_id *oid,
 	}
 
 	entry->no_try_delta = no_try_delta;
+
+	return entry;
 }
 
 static const char no_closure_warning[] = N_(
@@ -1353,6 +1433,7 @@ static int add_object_entry(const struct object_id *oid, enum object_type type,
 {
 	struct packed_git *found_pack = NULL;
 	off_t found_offset = 0;
+	struct object_entry *entry;
 
 	display_progress(progress_state, ++nr_seen);
 
@@ -1369,9 +1450,11 @@ static int add_object_entry(const struct object_id *oid, enum object_type type,
 		return 0;
 	}
 
-	create_object_entry(oid, type, pack_name_hash(name),
-			    exclude, name && no_try_delta(name),
-			    found_pack, found_offset);
+	entry = create_object_entry(oid, type, pack_name_hash(name),
+				    exclude, name && no_try_delta(name),
+				    found_pack, found_offset);
+	if (full_path_hash && name && *name)
+		oe_set_path_hash(&to_pack, entry, strhash(name));
 	return 1;
 }
 
@@ -2137,6 +2220,20 @@ static int type_size_sort(const void *_a, const void *_b)
 		return -1;
 	if (a->hash < b->hash)
 		return 1;
+	if (to_pack.path_hash) {
+		/*
+		 * The name hash only looks at the end of the path, so
+		 * files like "Makefile" in different directories all end
+		 * up in one group; keep the versions of each path together
+		 * within it.
+		 */
+		const uint32_t a_path = oe_path_hash(&to_pack, a);
+		const uint32_t b_path = oe_path_hash(&to_pack, b);
+		if (a_path > b_path)
+			return -1;
+		if (a_path < b_path)
+			return 1;
+	}
 	if (a->preferred_base > b->preferred_base)
 		return -1;
 	if (a->preferred_base < b->preferred_base)
@@ -2923,6 +3020,10 @@ static int git_pack_config(const char *k, const char *v, void *cb)
 		use_bitmap_index_default = git_config_bool(k, v);
 		return 0;
 	}
+	if (!strcmp(k, "pack.fullpathhash")) {
+		full_path_hash = git_config_bool(k, v);
+		return 0;
+	}
 	if (!strcmp(k, "pack.allowpackreuse")) {
 		allow_pack_reuse = git_config_bool(k, v);
 		return 0;
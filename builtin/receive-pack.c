@@ -66,6 +66,7 @@ static int prefer_ofs_delta = 1;
 static int auto_update_server_info;
 static int auto_gc = 1;
 static int reject_thin;
+static int connectivity_from_pack;
 static int stateless_rpc;
 static const char *service_dir;
 static const char *head_name;
@@ -97,6 +98,7 @@ static enum {
 static int keepalive_in_sec = 5;
 
 static struct tmp_objdir *tmp_objdir;
+static char *quarantine_pack_keep;
 
 static struct proc_receive_ref {
 	unsigned int want_add:1,
@@ -178,6 +180,11 @@ static int receive_pack_config(const char *var, const char *value, void *cb)
 		return 0;
 	}
 
+	if (strcmp(var, "receive.connectivityfrompack") == 0) {
+		connectivity_from_pack = git_config_bool(var, value);
+		return 0;
+	}
+
 	if (strcmp(var, "transfer.fsckobjects") == 0) {
 		transfer_fsck_objects = git_config_bool(var, value);
 		return 0;
@@ -1895,6 +1902,7 @@ static void execute_commands(struct command *commands,
 	opt.err_fd = err_fd;
 	opt.progress = err_fd && !quiet;
 	opt.env = tmp_objdir_env(tmp_objdir);
+	opt.new_pack_keep = quarantine_pack_keep;
 	if (check_connected(iterate_receive_command_list, &data, &opt))
 		set_connectivity_errors(commands, si);
 
@@ -2209,6 +2217,8 @@ static const char *unpack(int err_fd, struct shallow_info *si)
 				     fsck_msg_types.buf);
 		if (!reject_thin)
 			strvec_push(&child.args, "--fix-thin");
+		if (connectivity_from_pack)
+			strvec_push(&child.args, "--report-foreign");
 		if (max_input_size)
 			strvec_pushf(&child.args, "--max-input-size=%"PRIuMAX,
 				     (uintmax_t)max_input_size);
@@ -2219,6 +2229,10 @@ static const char *unpack(int err_fd, struct shallow_info *si)
 		if (status)
 			return "index-pack fork failed";
 		pack_lockfile = index_pack_lockfile(child.out);
+		if (pack_lockfile)
+			quarantine_pack_keep =
+				xstrfmt("%s/pack/%s", tmp_objdir_path(tmp_objdir),
+					find_last_dir_sep(pack_lockfile) + 1);
 		close(child.out);
 		status = finish_command(&child);
 		if (status)
@@ -0,0 +1,938 @@
+#include "builtin.h"
+#include "config.h"
+#include "commit-graph.h"
+#include "exec-cmd.h"
+#include "object-store.h"
+#include "packfile.h"
+#include "parse-options.h"
+#include "pkt-line.h"
+#include "refs.h"
+#include "resident.h"
+#include "string-list.h"
+#include "strvec.h"
+#include "tempfile.h"
+#include "unix-socket.h"
+
+static const char * const resident_usage[] = {
+	N_("git resident (run | start) [--timeout=<seconds>]"),
+	N_("git resident (stop | status)"),
+	NULL
+};
+
+#ifndef NO_UNIX_SOCKETS
+
+/*
+ * The environment and working directory we were started with, before
+ * the repository was set up, to compare clients with and to restart
+ * with.
+ */
+static struct strvec startup_env = STRVEC_INIT;
+static struct strbuf startup_cwd = STRBUF_INIT;
+
+/*
+ * The real path of the top of the working tree (or of the git directory
+ * of a bare repository), and of the git directory.
+ */
+static struct strbuf top = STRBUF_INIT;
+static struct strbuf gitdir = STRBUF_INIT;
+static int is_bare;
+
+/*
+ * Whether we were started with $GIT_DIR or $GIT_WORK_TREE, and if so,
+ * the real path of the directory we were started in and its prefix.
+ */
+static int explicit_repository;
+static struct strbuf startup_cwd_real = STRBUF_INIT;
+static const char *startup_prefix;
+
+static char *socket_path;
+static struct stat socket_st;
+static int idle_timeout;
+
+/*
+ * Environment variables that have to be the same for a client as for
+ * us.  Everything that git reads once at startup is among them, except
+ * for the tracing variables; commands we run trace where we do.
+ */
+static int must_match(const char *var)
+{
+	static const char *vars[] = {
+		"HOME", "XDG_CONFIG_HOME", "TZ",
+		"LANG", "LANGUAGE", "LC_ALL", "LC_CTYPE", "LC_MESSAGES",
+		NULL
+	};
+	const char **v;
+	size_t len = strchrnul(var, '=') - var;
+
+	if (starts_with(var, "GIT_TRACE"))
+		return 0;
+	if (starts_with(var, "GIT_"))
+		return !(len == strlen(RESIDENT_SOCKET_ENVIRONMENT) &&
+			 starts_with(var, RESIDENT_SOCKET_ENVIRONMENT));
+	for (v = vars; *v; v++)
+		if (len == strlen(*v) && starts_with(var, *v))
+			return 1;
+	return 0;
+}
+
+static void relevant_env(struct string_list *out, const char **env)
+{
+	for (; *env; env++)
+		if (must_match(*env))
+			string_list_append(out, *env);
+	string_list_sort(out);
+}
+
+static int same_relevant_env(const char **env)
+{
+	struct string_list ours = STRING_LIST_INIT_NODUP;
+	struct string_list theirs = STRING_LIST_INIT_NODUP;
+	int i, same;
+
+	relevant_env(&ours, startup_env.v);
+	relevant_env(&theirs, env);
+	same = ours.nr == theirs.nr;
+	for (i = 0; same && i < ours.nr; i++)
+		same = !strcmp(ours.items[i].string, theirs.items[i].string);
+	string_list_clear(&ours, 0);
+	string_list_clear(&theirs, 0);
+	return same;
+}
+
+/*
+ * Files whose change makes what we have loaded stale.  A missing file
+ * is watched, too, in case it is created.
+ */
+struct watched_path {
+	char *path;
+	int exists;
+	struct stat_data sd;
+};
+
+static struct watched_path *watched;
+static int watched_nr, watched_alloc;
+
+static void watch_path(const char *path)
+{
+	struct watched_path *w;
+	struct stat st;
+	int i;
+
+	for (i = 0; i < watched_nr; i++)
+		if (!strcmp(watched[i].path, path))
+			return;
+
+	ALLOC_GROW(watched, watched_nr + 1, watched_alloc);
+	w = &watched[watched_nr++];
+	w->path = xstrdup(path);
+	w->exists = !stat(path, &st);
+	if (w->exists)
+		fill_stat_data(&w->sd, &st);
+}
+
+static int watched_paths_changed(void)
+{
+	int i;
+
+	for (i = 0; i < watched_nr; i++) {
+		struct watched_path *w = &watched[i];
+		struct stat st;
+		int exists = !stat(w->path, &st);
+
+		if (exists != w->exists ||
+		    (exists && match_stat_data(&w->sd, &st)))
+			return 1;
+	}
+	return 0;
+}
+
+static void watch_config_files(void)
+{
+	char *path;
+
+	if (git_config_system())
+		watch_path(git_etc_gitconfig());
+	path = expand_user_path("~/.gitconfig", 0);
+	if (path)
+		watch_path(path);
+	free(path);
+	path = xdg_config_home("config");
+	if (path)
+		watch_path(path);
+	free(path);
+	watch_path(git_path("config"));
+	watch_path(git_path("config.worktree"));
+}
+
+static void watch_included_config_files(struct config_set *cs)
+{
+	int i;
+
+	if (!cs)
+		return;
+	for (i = 0; i < cs->list.nr; i++) {
+		struct configset_list_item *item = &cs->list.items[i];
+		struct key_value_info *kvi =
+			item->e->value_list.items[item->value_index].util;
+
+		if (kvi->origin_type == CONFIG_ORIGIN_FILE && kvi->filename)
+			watch_path(kvi->filename);
+	}
+}
+
+static void watch_object_store(struct repository *r)
+{
+	struct object_directory *odb;
+	struct strbuf path = STRBUF_INIT;
+
+	prepare_alt_odb(r);
+	for (odb = r->objects->odb; odb; odb = odb->next) {
+		char *graph;
+
+		strbuf_reset(&path);
+		strbuf_addf(&path, "%s/pack", odb->path);
+		watch_path(path.buf);
+		strbuf_reset(&path);
+		strbuf_addf(&path, "%s/info/alternates", odb->path);
+		watch_path(path.buf);
+
+		graph = get_commit_graph_filename(odb);
+		watch_path(graph);
+		free(graph);
+		graph = get_commit_graph_chain_filename(odb);
+		watch_path(graph);
+		free(graph);
+	}
+	watch_path(git_path_shallow(r));
+	strbuf_release(&path);
+}
+
+/*
+ * Load what every command would load again: the configuration, the
+ * pack indexes and the commit-graph.  The files involved are watched
+ * before they are read, so that a change while we read them is noticed.
+ */
+static void warm_up(struct repository *r)
+{
+	struct packed_git *p;
+
+	watch_config_files();
+	watch_object_store(r);
+
+	git_config(git_default_config, NULL);
+	watch_included_config_files(r->config);
+
+	for (p = get_all_packs(r); p; p = p->next)
+		open_pack_index(p);
+	prepare_commit_graph(r);
+
+	/*
+	 * Looking up a ref that has no loose file loads the packed refs,
+	 * which are revalidated each time they are used.  Loose refs are
+	 * deliberately not cached here, as nothing would tell us when
+	 * they change.
+	 */
+	refs_resolve_ref_unsafe(get_main_ref_store(r), "refs/resident/warm-up",
+				0, NULL, NULL);
+}
+
+/*
+ * Start afresh, with the listening socket kept open, so that nothing
+ * loaded from a file that has changed since stays around.
+ */
+static void NORETURN restart(int listen_fd)
+{
+	struct strvec args = STRVEC_INIT;
+	extern char **environ;
+
+	strvec_pushl(&args, "git", "resident", "run", NULL);
+	strvec_pushf(&args, "--listen-fd=%d", listen_fd);
+	if (idle_timeout)
+		strvec_pushf(&args, "--timeout=%d", idle_timeout);
+
+	if (chdir(startup_cwd.buf))
+		die_errno(_("cannot change to '%s'"), startup_cwd.buf);
+	environ = (char **)startup_env.v;
+	execv(mkpath("%s/git", git_exec_path()), (char **)args.v);
+	die_errno(_("unable to restart git resident"));
+}
+
+struct request {
+	struct strbuf cwd;
+	struct strvec env;
+	struct strvec args;
+};
+
+#define REQUEST_INIT { STRBUF_INIT, STRVEC_INIT, STRVEC_INIT }
+
+/*
+ * A client sends its whole request at once, so one that takes longer
+ * than this is stuck, and would keep everybody else waiting.  A request
+ * larger than this is not worth the memory; the client can run the
+ * command itself.
+ */
+#define REQUEST_TIMEOUT_MS (5 * 1000)
+#define REQUEST_MAX_SIZE (4 * 1024 * 1024)
+
+/*
+ * Wait until `fd` has something to read, but not beyond `deadline_ns`.
+ * Returns 0 if there is, -1 otherwise.
+ */
+static int wait_for_client(int fd, uint64_t deadline_ns)
+{
+	for (;;) {
+		struct pollfd pfd;
+		uint64_t now = getnanotime();
+		int ret;
+
+		if (now >= deadline_ns)
+			return -1;
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		ret = poll(&pfd, 1, (deadline_ns - now) / 1000000 + 1);
+		if (ret > 0)
+			return 0;
+		if (ret < 0 && errno != EINTR)
+			return -1;
+	}
+}
+
+/*
+ * Read a request, which the client ends by shutting down its side of
+ * the connection.  Returns 0 on success, -1 if the request is broken or
+ * the client too slow, and -2 if the request is too large.
+ */
+static int read_request(int fd, struct request *req, uint64_t deadline_ns)
+{
+	struct strbuf buf = STRBUF_INIT;
+	char *src;
+	size_t src_len;
+	int ret = -1;
+
+	for (;;) {
+		ssize_t got;
+
+		if (buf.len >= REQUEST_MAX_SIZE) {
+			ret = -2;
+			goto out;
+		}
+		if (wait_for_client(fd, deadline_ns) < 0)
+			goto out;
+		strbuf_grow(&buf, 8192);
+		got = read(fd, buf.buf + buf.len, buf.alloc - buf.len - 1);
+		if (got < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			goto out;
+		}
+		if (!got)
+			break;
+		strbuf_setlen(&buf, buf.len + got);
+	}
+	src = buf.buf;
+	src_len = buf.len;
+
+	for (;;) {
+		const char *p;
+		int len;
+
+		switch (packet_read_with_status(-1, &src, &src_len,
+						packet_buffer,
+						sizeof(packet_buffer), &len,
+						PACKET_READ_GENTLE_ON_EOF)) {
+		case PACKET_READ_NORMAL:
+			break;
+		case PACKET_READ_FLUSH:
+			if (req->args.nr)
+				ret = 0;
+			goto out;
+		default:
+			goto out;
+		}
+
+		if (skip_prefix(packet_buffer, "cwd ", &p))
+			strbuf_addstr(&req->cwd, p);
+		else if (skip_prefix(packet_buffer, "env ", &p))
+			strvec_push(&req->env, p);
+		else if (skip_prefix(packet_buffer, "arg ", &p))
+			strvec_push(&req->args, p);
+		else
+			goto out;
+	}
+
+out:
+	strbuf_release(&buf);
+	return ret;
+}
+
+/*
+ * Find out whether discovering the repository from the directory `rel`
+ * below the top of the working tree would find our repository.
+ */
+static const char *check_discovery(const char *rel)
+{
+	struct strbuf path = STRBUF_INIT;
+	int across_fs = git_env_bool("GIT_DISCOVERY_ACROSS_FILESYSTEM", 0);
+	const char *reason = NULL;
+	struct stat st;
+	dev_t dev;
+
+	if (stat(top.buf, &st))
+		return "working tree is gone";
+	dev = st.st_dev;
+
+	strbuf_addbuf(&path, &top);
+	while (!reason && *rel) {
+		const char *end = strchrnul(rel + 1, '/');
+		size_t len;
+
+		strbuf_add(&path, rel, end - rel);
+		rel = end;
+		if (stat(path.buf, &st))
+			reason = "working directory is gone";
+		else if (!across_fs && st.st_dev != dev)
+			reason = "mount point";
+
+		len = path.len;
+		strbuf_addstr(&path, "/.git");
+		if (!reason && !lstat(path.buf, &st))
+			reason = "nested repository";
+		strbuf_setlen(&path, len);
+	}
+	strbuf_release(&path);
+	return reason;
+}
+
+/*
+ * Decide whether we can run the request exactly as the client would.
+ * Returns the reason if not; otherwise sets `prefix` to the prefix of
+ * the client's working directory.
+ */
+static const char *check_request(struct request *req, struct strbuf *prefix)
+{
+	struct strbuf cwd = STRBUF_INIT;
+	const char *reason = NULL;
+	const char *rel;
+
+	if (!is_resident_builtin(req->args.v[0]))
+		return "not a read-only command";
+	if (!same_relevant_env(req->env.v))
+		return "different environment";
+	if (!strbuf_realpath(&cwd, req->cwd.buf, 0))
+		return "working directory is gone";
+
+	if (explicit_repository) {
+		/*
+		 * $GIT_DIR or $GIT_WORK_TREE decide the working tree, and
+		 * the prefix depends on how; only serve from where we
+		 * were started.
+		 */
+		if (strcmp(cwd.buf, startup_cwd_real.buf))
+			reason = "GIT_DIR or GIT_WORK_TREE in another directory";
+		else if (startup_prefix)
+			strbuf_addstr(prefix, startup_prefix);
+	} else if (!strcmp(cwd.buf, top.buf)) {
+		; /* no prefix */
+	} else if (is_bare || !skip_prefix(cwd.buf, top.buf, &rel) ||
+		   *rel != '/' ||
+		   (starts_with(cwd.buf, gitdir.buf) &&
+		    (!cwd.buf[gitdir.len] || cwd.buf[gitdir.len] == '/'))) {
+		reason = "outside of the working tree";
+	} else if (getenv(CEILING_DIRECTORIES_ENVIRONMENT)) {
+		reason = "ceiling directories";
+	} else if (!(reason = check_discovery(rel))) {
+		strbuf_addstr(prefix, rel + 1);
+		strbuf_addch(prefix, '/');
+	}
+
+	strbuf_release(&cwd);
+	return reason;
+}
+
+/*
+ * Run the command of the request in this process, which is a fork of
+ * the server with everything it loaded.
+ */
+static void NORETURN run_request(struct request *req, const int *fds,
+				 const char *prefix)
+{
+	struct strvec env = STRVEC_INIT;
+	extern char **environ;
+	const char **e;
+	char **ours;
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		if (dup2(fds[i], i) < 0)
+			die_errno(_("dup2 failed"));
+		if (fds[i] > 2)
+			close(fds[i]);
+	}
+
+	/*
+	 * The client's environment, except that the GIT_* variables are
+	 * ours, which are the client's plus those set up for the
+	 * repository.
+	 */
+	for (e = req->env.v; *e; e++)
+		if (!starts_with(*e, "GIT_"))
+			strvec_push(&env, *e);
+	for (ours = environ; *ours; ours++)
+		if (starts_with(*ours, "GIT_"))
+			strvec_push(&env, *ours);
+	environ = (char **)env.v;
+
+	exit(run_resident_builtin(req->args.nr, req->args.v,
+				  *prefix ? prefix : NULL, req->cwd.buf));
+}
+
+/*
+ * The commands we are running, and the clients waiting for their exit
+ * codes.  We learn that one is done through `sigchld_pipe`, and that a
+ * client has gone away, e.g. because it was interrupted, when its
+ * connection hangs up; its command is then killed, as it would have
+ * been with the client.
+ */
+struct worker {
+	pid_t pid;
+	int client;
+	unsigned killed : 1;
+};
+
+static struct worker *workers;
+static int workers_nr, workers_alloc;
+static int sigchld_pipe[2] = { -1, -1 };
+
+static void note_sigchld(int sig)
+{
+	int saved_errno = errno;
+
+	/* if the pipe is full, the next read will do just as well */
+	if (write(sigchld_pipe[1], "", 1) < 0)
+		; /* nothing */
+	errno = saved_errno;
+}
+
+static void setup_sigchld_pipe(void)
+{
+	int i;
+
+	if (pipe(sigchld_pipe))
+		die_errno(_("unable to create pipe"));
+	for (i = 0; i < 2; i++) {
+		int flags = fcntl(sigchld_pipe[i], F_GETFL);
+
+		if (flags < 0 ||
+		    fcntl(sigchld_pipe[i], F_SETFL, flags | O_NONBLOCK) ||
+		    fcntl(sigchld_pipe[i], F_SETFD, FD_CLOEXEC))
+			die_errno(_("unable to set up pipe"));
+	}
+	signal(SIGCHLD, note_sigchld);
+}
+
+/*
+ * Tell the clients of the commands that are done how they exited.  With
+ * `wait_all`, wait for all commands to be done.
+ */
+static void reap_workers(int wait_all)
+{
+	char buf[64];
+
+	while (read(sigchld_pipe[0], buf, sizeof(buf)) > 0)
+		; /* drain */
+
+	while (workers_nr) {
+		pid_t pid;
+		int status, i;
+
+		pid = waitpid(-1, &status, wait_all ? 0 : WNOHANG);
+		if (!pid)
+			break;
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (i = 0; i < workers_nr; i++)
+			if (workers[i].pid == pid)
+				break;
+		if (i == workers_nr)
+			continue;
+
+		if (WIFSIGNALED(status))
+			packet_write_fmt_gently(workers[i].client, "signal %d",
+						WTERMSIG(status));
+		else
+			packet_write_fmt_gently(workers[i].client, "exit %d",
+						WEXITSTATUS(status));
+		close(workers[i].client);
+		workers[i] = workers[--workers_nr];
+	}
+}
+
+/*
+ * Start the command of a run request.  Returns 1 if the client is to
+ * wait for it, and 0 if we are done with the client.
+ */
+static int serve_run(int fd, const int *fds, int listen_fd,
+		     uint64_t deadline_ns)
+{
+	struct request req = REQUEST_INIT;
+	struct strbuf prefix = STRBUF_INIT;
+	const char *reason;
+	pid_t pid;
+	int i;
+
+	switch (read_request(fd, &req, deadline_ns)) {
+	case 0:
+		break;
+	case -2:
+		packet_write_fmt_gently(fd, "fallback request too large");
+		goto fail;
+	default:
+		goto fail;
+	}
+
+	reason = check_request(&req, &prefix);
+	if (reason) {
+		packet_write_fmt_gently(fd, "fallback %s", reason);
+		goto fail;
+	}
+
+	fflush(NULL);
+	pid = fork();
+	if (pid < 0) {
+		packet_write_fmt_gently(fd, "fallback fork failed");
+		goto fail;
+	}
+	if (!pid) {
+		close(listen_fd);
+		close(sigchld_pipe[0]);
+		close(sigchld_pipe[1]);
+		for (i = 0; i < workers_nr; i++)
+			close(workers[i].client);
+		close(fd);
+		signal(SIGCHLD, SIG_DFL);
+		signal(SIGPIPE, SIG_DFL);
+		run_request(&req, fds, prefix.buf);
+	}
+
+	ALLOC_GROW(workers, workers_nr + 1, workers_alloc);
+	workers[workers_nr].pid = pid;
+	workers[workers_nr].client = fd;
+	workers[workers_nr].killed = 0;
+	workers_nr++;
+	i = 1;
+	goto out;
+
+fail:
+	i = 0;
+out:
+	strbuf_release(&req.cwd);
+	strvec_clear(&req.env);
+	strvec_clear(&req.args);
+	strbuf_release(&prefix);
+	return i;
+}
+
+#if defined(SO_PEERCRED) || defined(HAVE_GETPEEREID)
+#define HAVE_PEER_CREDENTIALS
+#endif
+
+/*
+ * Whether the client at the other end of `fd` is run by our user.
+ * Anybody who gets to connect would otherwise run commands as us.
+ */
+static int peer_is_us(int fd)
+{
+#if defined(SO_PEERCRED)
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len))
+		return 0;
+	return cred.uid == geteuid();
+#elif defined(HAVE_GETPEEREID)
+	uid_t uid;
+	gid_t gid;
+
+	if (getpeereid(fd, &uid, &gid))
+		return 0;
+	return uid == geteuid();
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Serve one client.  Returns 0 if we are to stop.
+ */
+static int serve_client(int fd, int listen_fd)
+{
+	uint64_t deadline_ns = getnanotime() + REQUEST_TIMEOUT_MS * 1000000ULL;
+	int fds[3], nr = 0, ret = 1;
+
+	if (!peer_is_us(fd) || wait_for_client(fd, deadline_ns) < 0) {
+		close(fd);
+		return 1;
+	}
+
+	switch (resident_receive_verb(fd, fds, 3, &nr)) {
+	case RESIDENT_RUN:
+		if (nr == 3 && serve_run(fd, fds, listen_fd, deadline_ns))
+			fd = -1; /* answered by reap_workers() */
+		break;
+	case RESIDENT_PING:
+		packet_write_fmt_gently(fd, "ok");
+		break;
+	case RESIDENT_STOP:
+		packet_write_fmt_gently(fd, "ok");
+		ret = 0;
+		break;
+	}
+
+	while (nr)
+		close(fds[--nr]);
+	if (fd >= 0)
+		close(fd);
+	return ret;
+}
+
+static int socket_is_ours(void)
+{
+	struct stat st;
+
+	return !lstat(socket_path, &st) &&
+	       st.st_dev == socket_st.st_dev && st.st_ino == socket_st.st_ino;
+}
+
+/*
+ * Kill the commands whose clients have hung up, going by `pfd`, which
+ * has an entry for the client of each worker that was not killed yet,
+ * in order.
+ */
+static void kill_abandoned_workers(const struct pollfd *pfd)
+{
+	int i;
+
+	for (i = 0; i < workers_nr; i++) {
+		if (workers[i].killed)
+			continue;
+		if (pfd++->revents & (POLLHUP | POLLERR | POLLNVAL)) {
+			kill(workers[i].pid, SIGTERM);
+			workers[i].killed = 1;
+		}
+	}
+}
+
+/*
+ * Wait for a client or a command to finish, and return whether to
+ * carry on.
+ */
+static int serve_loop(int listen_fd)
+{
+	static uint64_t last_request_ns;
+	static struct pollfd *pfd;
+	static int pfd_alloc;
+	int wait_ms = 60 * 1000, client, nr = 2, i;
+	uint64_t now = getnanotime();
+
+	if (!last_request_ns || workers_nr)
+		last_request_ns = now;
+	if (idle_timeout) {
+		uint64_t deadline = last_request_ns + idle_timeout * 1000000000ULL;
+
+		if (now >= deadline)
+			return 0;
+		if ((deadline - now) / 1000000 < wait_ms)
+			wait_ms = (deadline - now) / 1000000 + 1;
+	}
+
+	ALLOC_GROW(pfd, workers_nr + 2, pfd_alloc);
+	pfd[0].fd = listen_fd;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = sigchld_pipe[0];
+	pfd[1].events = POLLIN;
+	/* the clients have sent everything; we only look for hang-ups */
+	for (i = 0; i < workers_nr; i++) {
+		if (workers[i].killed)
+			continue;
+		pfd[nr].fd = workers[i].client;
+		pfd[nr].events = 0;
+		nr++;
+	}
+	switch (poll(pfd, nr, wait_ms)) {
+	case -1:
+		if (errno != EINTR)
+			die_errno(_("poll failed"));
+		return 1;
+	case 0:
+		/* quit when another server took over our socket */
+		return socket_is_ours();
+	}
+
+	kill_abandoned_workers(pfd + 2);
+	if (pfd[1].revents)
+		reap_workers(0);
+	if (!(pfd[0].revents & POLLIN))
+		return 1;
+
+	if (watched_paths_changed()) {
+		reap_workers(1);
+		restart(listen_fd);
+	}
+
+	client = accept(listen_fd, NULL, NULL);
+	if (client < 0) {
+		warning_errno(_("accept failed"));
+		return 1;
+	}
+	last_request_ns = getnanotime();
+	return serve_client(client, listen_fd);
+}
+
+static int ask_server(char verb)
+{
+	int fd = unix_stream_connect(socket_path);
+	char *line = NULL;
+
+	if (fd < 0)
+		return -1;
+	if (resident_send_verb(fd, verb, NULL, 0) < 0 ||
+	    packet_read_line_gently(fd, NULL, &line) < 0 ||
+	    !line || strcmp(line, "ok")) {
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	return 0;
+}
+
+static int resident_stop(void)
+{
+	int i;
+
+	if (ask_server(RESIDENT_STOP) < 0)
+		return error(_("resident server is not running"));
+
+	/* wait for it to go away, for a while */
+	for (i = 0; i < 500; i++) {
+		int fd = unix_stream_connect(socket_path);
+
+		if (fd < 0)
+			return 0;
+		close(fd);
+		sleep_millisec(10);
+	}
+	return error(_("resident server did not stop"));
+}
+
+static int resident_run(int listen_fd, int detach)
+{
+	struct tempfile *socket_file;
+	extern char **environ;
+	char **e;
+
+#ifndef HAVE_PEER_CREDENTIALS
+	die(_("git resident cannot tell who connects to it on this platform"));
+#endif
+
+	for (e = environ; *e; e++)
+		strvec_push(&startup_env, *e);
+	if (strbuf_getcwd(&startup_cwd))
+		die_errno(_("unable to get current working directory"));
+
+	explicit_repository = !!getenv(GIT_DIR_ENVIRONMENT) ||
+			      !!getenv(GIT_WORK_TREE_ENVIRONMENT);
+	startup_prefix = setup_git_directory();
+	strbuf_realpath(&startup_cwd_real, startup_cwd.buf, 1);
+	if (is_bare_repository()) {
+		is_bare = 1;
+		strbuf_realpath(&top, get_git_dir(), 1);
+	} else {
+		strbuf_realpath(&top, get_git_work_tree(), 1);
+	}
+	strbuf_realpath(&gitdir, get_git_dir(), 1);
+	socket_path = git_pathdup("resident.sock");
+
+	if (listen_fd < 0) {
+		if (!ask_server(RESIDENT_PING))
+			die(_("resident server is already running"));
+		listen_fd = unix_stream_listen(socket_path);
+		if (listen_fd < 0)
+			die_errno(_("unable to bind to '%s'"), socket_path);
+	}
+	if (lstat(socket_path, &socket_st))
+		die_errno(_("unable to stat '%s'"), socket_path);
+
+	warm_up(the_repository);
+
+	if (detach && daemonize())
+		die_errno(_("unable to detach"));
+	/* only now, or the parent would remove it as it exits */
+	socket_file = register_tempfile(socket_path);
+
+	/* clients that hang up must not take us down */
+	signal(SIGPIPE, SIG_IGN);
+	setup_sigchld_pipe();
+
+	while (serve_loop(listen_fd))
+		; /* nothing */
+	reap_workers(1);
+
+	if (socket_is_ours())
+		delete_tempfile(&socket_file);
+	close(listen_fd);
+	return 0;
+}
+
+int cmd_resident(int argc, const char **argv, const char *prefix)
+{
+	int listen_fd = -1;
+	struct option options[] = {
+		OPT_INTEGER(0, "timeout", &idle_timeout,
+			    N_("exit after this many seconds without a request")),
+		OPT_INTEGER_F(0, "listen-fd", &listen_fd,
+			      N_("serve on this socket (internal)"),
+			      PARSE_OPT_HIDDEN),
+		OPT_END()
+	};
+	const char *action;
+
+	argc = parse_options(argc, argv, prefix, options, resident_usage, 0);
+	if (argc != 1)
+		usage_with_options(resident_usage, options);
+	action = argv[0];
+
+	if (!strcmp(action, "run"))
+		return resident_run(listen_fd, 0);
+	if (!strcmp(action, "start"))
+		return resident_run(listen_fd, 1);
+
+	setup_git_directory();
+	socket_path = git_pathdup("resident.sock");
+	if (!strcmp(action, "stop"))
+		return !!resident_stop();
+	if (!strcmp(action, "status")) {
+		if (ask_server(RESIDENT_PING) < 0) {
+			printf(_("resident server is not running\n"));
+			return 1;
+		}
+		printf(_("resident server is running\n"));
+		return 0;
+	}
+	usage_with_options(resident_usage, options);
+}
+
+#else
+
+int cmd_resident(int argc, const char **argv, const char *prefix)
+{
+	struct option options[] = { OPT_END() };
+
+	argc = parse_options(argc, argv, prefix, options, resident_usage, 0);
+	die(_("git resident is not available; no unix socket support"));
+}
+
+#endif /* NO_UNIX_SOCKETS */
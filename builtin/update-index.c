@@ -1229,7 +1229,11 @@ int cmd_update_index(int argc, const char **argv, const char *prefix)
 		report(_("fsmonitor disabled"));
 	}
 
-	if (active_cache_changed || force_write) {
+	/* rewrite the whole file instead of appending to a delta log */
+	if (force_write)
+		active_cache_changed |= SOMETHING_CHANGED;
+
+	if (active_cache_changed) {
 		if (newfd < 0) {
 			if (refresh_args.flags & REFRESH_QUIET)
 				exit(128);
@@ -305,6 +305,7 @@ static inline unsigned int canon_mode(unsigned int mode)
 struct split_index;
 struct untracked_cache;
 struct progress;
+struct index_delta_log;
 
 struct index_state {
 	struct cache_entry **cache;
@@ -319,19 +320,27 @@ struct index_state {
 		 drop_cache_tree : 1,
 		 updated_workdir : 1,
 		 updated_skipworktree : 1,
-		 fsmonitor_has_run_once : 1;
+		 fsmonitor_has_run_once : 1,
+		 partial_read : 1;
 	struct hashmap name_hash;
 	struct hashmap dir_hash;
+	unsigned int name_hash_lookups;
 	struct object_id oid;
 	struct untracked_cache *untracked;
 	char *fsmonitor_last_update;
 	struct ewah_bitmap *fsmonitor_dirty;
 	struct mem_pool *ce_mem_pool;
 	struct progress *progress;
+	struct index_delta_log *delta_log;
 };
 
 /* Name hashing */
 int test_lazy_init_name_hash(struct index_state *istate, int try_threaded);
+/*
+ * Build the name hash now rather than on first lookup, e.g. before
+ * several threads start looking up names concurrently.
+ */
+void lazy_init_name_hash(struct index_state *istate);
 void add_name_hash(struct index_state *istate, struct cache_entry *ce);
 void remove_name_hash(struct index_state *istate, struct cache_entry *ce);
 void free_name_hash(struct index_state *istate);
@@ -601,6 +610,14 @@ int discover_git_directory(struct strbuf *commondir,
 			   struct strbuf *gitdir);
 const char *setup_git_directory_gently(int *);
 const char *setup_git_directory(void);
+/*
+ * Make further calls to setup_git_directory() and its gentle variant
+ * return `prefix`, and change back to the current directory, without
+ * doing anything else.  This is for a process that has set up the
+ * repository for a working directory other than its current one (see
+ * builtin/resident.c).
+ */
+void setup_git_directory_preset(const char *prefix);
 char *prefix_path(const char *prefix, int len, const char *path);
 char *prefix_path_gently(const char *prefix, int len, int *remaining, const char *path);
 
@@ -718,6 +735,16 @@ int do_read_index(struct index_state *istate, const char *path,
 		  int must_exist); /* for testting only! */
 int read_index_from(struct index_state *, const char *path,
 		    const char *gitdir);
+/*
+ * Like read_index_from(), but if the index file records a directory
+ * table, only read the entries of the deepest recorded directory that
+ * contains all paths starting with `prefix` (which must end with a
+ * slash).  Such an index is marked with `partial_read` and cannot be
+ * written out.  Falls back to reading the whole index otherwise.
+ */
+int read_index_subtree_from(struct index_state *, const char *path,
+			    const char *gitdir,
+			    const char *prefix, int prefixlen);
 int is_index_unborn(struct index_state *);
 
 /* For use with `write_locked_index()`. */
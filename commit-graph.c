@@ -19,6 +19,7 @@
 #include "shallow.h"
 #include "json-writer.h"
 #include "trace2.h"
+#include "thread-utils.h"
 
 void git_test_write_commit_graph_or_die(void)
 {
@@ -611,13 +612,7 @@ static void prepare_commit_graph_one(struct repository *r,
 	r->objects->commit_graph = read_commit_graph_one(r, odb);
 }
 
-/*
- * Return 1 if commit_graph is non-NULL, and 0 otherwise.
- *
- * On the first invocation, this function attempts to load the commit
- * graph if the_repository is configured to have one.
- */
-static int prepare_commit_graph(struct repository *r)
+int prepare_commit_graph(struct repository *r)
 {
 	struct object_directory *odb;
 
@@ -1410,12 +1405,105 @@ static void trace2_bloom_filter_write_statistics(struct write_commit_graph_conte
 			   ctx->count_bloom_filter_trunc_large);
 }
 
+struct bloom_filter_job {
+	const struct object_id *parent;
+	const struct object_id *oid;
+	struct bloom_filter *filter;
+	enum bloom_filter_computed computed;
+};
+
+struct bloom_filter_workers {
+	struct write_commit_graph_context *ctx;
+	struct bloom_filter_job *jobs;
+	size_t jobs_nr, next_job;
+	uint64_t deadline;
+	struct progress *progress;
+	uint64_t progress_cnt;
+	pthread_mutex_t mutex;
+};
+
+static void *compute_bloom_filters_worker(void *arg)
+{
+	struct bloom_filter_workers *w = arg;
+
+	for (;;) {
+		struct bloom_filter_job *job;
+
+		pthread_mutex_lock(&w->mutex);
+		if (w->next_job < w->jobs_nr && w->deadline &&
+		    getnanotime() > w->deadline)
+			w->next_job = w->jobs_nr;
+		if (w->next_job >= w->jobs_nr) {
+			pthread_mutex_unlock(&w->mutex);
+			break;
+		}
+		job = &w->jobs[w->next_job++];
+		pthread_mutex_unlock(&w->mutex);
+
+		fill_bloom_filter(w->ctx->r, job->parent, job->oid,
+				  job->filter, w->ctx->bloom_settings,
+				  &job->computed);
+
+		pthread_mutex_lock(&w->mutex);
+		display_progress(w->progress, ++w->progress_cnt);
+		pthread_mutex_unlock(&w->mutex);
+	}
+
+	return NULL;
+}
+
+static void run_bloom_filter_workers(struct bloom_filter_workers *w)
+{
+	int i, nr_threads = 1;
+	pthread_t *threads;
+
+	if (HAVE_THREADS) {
+		if (w->ctx->opts && w->ctx->opts->threads > 0)
+			nr_threads = w->ctx->opts->threads;
+		else
+			nr_threads = online_cpus();
+		if (nr_threads > w->jobs_nr)
+			nr_threads = w->jobs_nr;
+	}
+
+	pthread_mutex_init(&w->mutex, NULL);
+
+	if (nr_threads <= 1) {
+		compute_bloom_filters_worker(w);
+		pthread_mutex_destroy(&w->mutex);
+		return;
+	}
+
+	trace2_data_intmax("bloom", w->ctx->r, "threads", nr_threads);
+
+	/* the object layer is only safe to share under its read lock */
+	enable_obj_read_lock();
+
+	ALLOC_ARRAY(threads, nr_threads);
+	for (i = 0; i < nr_threads; i++) {
+		int err = pthread_create(&threads[i], NULL,
+					 compute_bloom_filters_worker, w);
+		if (err)
+			die(_("unable to create thread: %s"), strerror(err));
+	}
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_join(threads[i], NULL))
+			die("unable to join thread");
+
+	pthread_mutex_destroy(&w->mutex);
+	disable_obj_read_lock();
+	free(threads);
+}
+
 static void compute_bloom_filters(struct write_commit_graph_context *ctx)
 {
 	int i;
 	struct progress *progress = NULL;
 	struct commit **sorted_commits;
+	struct bloom_filter **filters;
+	struct bloom_filter_workers workers;
 	int max_new_filters;
+	size_t j;
 
 	init_bloom_filters();
 
@@ -1435,31 +1523,68 @@ static void compute_bloom_filters(struct write_commit_graph_context *ctx)
 	max_new_filters = ctx->opts && ctx->opts->max_new_filters >= 0 ?
 		ctx->opts->max_new_filters : ctx->commits.nr;
 
+	memset(&workers, 0, sizeof(workers));
+	workers.ctx = ctx;
+	workers.progress = progress;
+	if (ctx->opts && ctx->opts->max_new_filters_time > 0)
+		workers.deadline = getnanotime() +
+			(uint64_t)ctx->opts->max_new_filters_time * 1000000000;
+
+	/*
+	 * Load the filters we already have and queue the missing ones
+	 * (up to the limit) in order, so that they can be computed by
+	 * several threads without any of them parsing objects.
+	 */
+	ALLOC_ARRAY(filters, ctx->commits.nr);
+	ALLOC_ARRAY(workers.jobs, ctx->commits.nr);
 	for (i = 0; i < ctx->commits.nr; i++) {
-		enum bloom_filter_computed computed = 0;
 		struct commit *c = sorted_commits[i];
-		struct bloom_filter *filter = get_or_compute_bloom_filter(
-			ctx->r,
-			c,
-			ctx->count_bloom_filter_computed < max_new_filters,
-			ctx->bloom_settings,
-			&computed);
+		struct bloom_filter *filter = get_bloom_filter_slot(ctx->r, c);
+		struct bloom_filter_job *job;
+
+		filters[i] = filter;
+		if ((filter->data && filter->len) ||
+		    workers.jobs_nr >= max_new_filters) {
+			display_progress(progress, ++workers.progress_cnt);
+			continue;
+		}
+
+		/* ensure commit is parsed so we have parent information */
+		repo_parse_commit(ctx->r, c);
+
+		job = &workers.jobs[workers.jobs_nr++];
+		job->parent = c->parents ? &c->parents->item->object.oid : NULL;
+		job->oid = &c->object.oid;
+		job->filter = filter;
+		job->computed = BLOOM_NOT_COMPUTED;
+	}
+
+	if (workers.jobs_nr)
+		run_bloom_filter_workers(&workers);
+
+	for (j = 0; j < workers.jobs_nr; j++) {
+		enum bloom_filter_computed computed = workers.jobs[j].computed;
+
 		if (computed & BLOOM_COMPUTED) {
 			ctx->count_bloom_filter_computed++;
 			if (computed & BLOOM_TRUNC_EMPTY)
 				ctx->count_bloom_filter_trunc_empty++;
 			if (computed & BLOOM_TRUNC_LARGE)
 				ctx->count_bloom_filter_trunc_large++;
-		} else if (computed & BLOOM_NOT_COMPUTED)
-			ctx->count_bloom_filter_not_computed++;
-		ctx->total_bloom_filter_data_size += filter
-			? sizeof(unsigned char) * filter->len : 0;
-		display_progress(progress, i + 1);
+		}
 	}
+	ctx->count_bloom_filter_not_computed +=
+		ctx->commits.nr - ctx->count_bloom_filter_computed;
+
+	for (i = 0; i < ctx->commits.nr; i++)
+		ctx->total_bloom_filter_data_size += filters[i]->data
+			? sizeof(unsigned char) * filters[i]->len : 0;
 
 	if (trace2_is_enabled())
 		trace2_bloom_filter_write_statistics(ctx);
 
+	free(workers.jobs);
+	free(filters);
 	free(sorted_commits);
 	stop_progress(&progress);
 }
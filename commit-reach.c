@@ -8,6 +8,8 @@
 #include "revision.h"
 #include "tag.h"
 #include "commit-reach.h"
+#include "pack-bitmap.h"
+#include "strvec.h"
 
 /* Remember to update object flag allocation in object.h */
 #define PARENT1		(1u<<16)
@@ -802,3 +804,66 @@ struct commit_list *get_reachable_subset(struct commit **from, int nr_from,
 
 	return found_commits;
 }
+
+static void walk_ahead_behind(struct repository *r, struct commit *base,
+			      struct commit *tip,
+			      struct ahead_behind_count *count)
+{
+	struct rev_info revs;
+	struct strvec argv = STRVEC_INIT;
+
+	count->ahead = count->behind = 0;
+	if (tip == base)
+		return;
+
+	/* Run "rev-list --left-right tip...base" internally... */
+	strvec_push(&argv, ""); /* ignored */
+	strvec_push(&argv, "--left-right");
+	strvec_pushf(&argv, "%s...%s",
+		     oid_to_hex(&tip->object.oid),
+		     oid_to_hex(&base->object.oid));
+	strvec_push(&argv, "--");
+
+	repo_init_revisions(r, &revs, NULL);
+	setup_revisions(argv.nr, argv.v, &revs, NULL);
+	if (prepare_revision_walk(&revs))
+		die(_("revision walk setup failed"));
+
+	/* ... and count the commits on each side. */
+	while (1) {
+		struct commit *c = get_revision(&revs);
+		if (!c)
+			break;
+		if (c->object.flags & SYMMETRIC_LEFT)
+			count->ahead++;
+		else
+			count->behind++;
+	}
+
+	/* clear object flags smudged by the above traversal */
+	clear_commit_marks(tip, ALL_REV_FLAGS);
+	clear_commit_marks(base, ALL_REV_FLAGS);
+
+	strvec_clear(&argv);
+}
+
+void ahead_behind(struct repository *r, struct commit *base,
+		  struct commit **tips, size_t tips_nr,
+		  struct ahead_behind_count *counts)
+{
+	struct bitmap_index *bitmap_git;
+	size_t i;
+
+	if (!tips_nr)
+		return;
+
+	bitmap_git = prepare_bitmap_git(r);
+	if (bitmap_git) {
+		bitmap_ahead_behind(r, bitmap_git, base, tips, tips_nr, counts);
+		free_bitmap_index(bitmap_git);
+		return;
+	}
+
+	for (i = 0; i < tips_nr; i++)
+		walk_ahead_behind(r, base, tips[i], &counts[i]);
+}
@@ -104,4 +104,21 @@ struct commit_list *get_reachable_subset(struct commit **from, int nr_from,
 					 struct commit **to, int nr_to,
 					 unsigned int reachable_flag);
 
+struct ahead_behind_count {
+	unsigned int ahead;
+	unsigned int behind;
+};
+
+/*
+ * For each commit in 'tips', count the commits that are reachable from
+ * it but not from 'base' (ahead) and those reachable from 'base' but not
+ * from it (behind), storing the result in the matching slot of 'counts'.
+ *
+ * Reachability bitmaps are used when available, so that a large batch of
+ * tips costs one bitmap operation per tip instead of one history walk.
+ */
+void ahead_behind(struct repository *r, struct commit *base,
+		  struct commit **tips, size_t tips_nr,
+		  struct ahead_behind_count *counts);
+
 #endif
@@ -13,11 +13,76 @@
 #include <errno.h>
 #include <limits.h>
 
+/*
+ * The destructors of the keys that have one, to be run by the threads
+ * we start as they return.  Git creates keys once, before starting
+ * threads, so a handful will do.
+ */
+#define MAX_KEY_DESTRUCTORS 8
+
+static struct {
+	pthread_key_t key;
+	void (*destructor)(void *value);
+} key_destructors[MAX_KEY_DESTRUCTORS];
+static volatile LONG key_destructors_nr;
+
+int pthread_key_create(pthread_key_t *keyp, void (*destructor)(void *value))
+{
+	LONG i;
+
+	if ((*keyp = TlsAlloc()) == TLS_OUT_OF_INDEXES)
+		return EAGAIN;
+	if (!destructor)
+		return 0;
+
+	i = InterlockedIncrement(&key_destructors_nr) - 1;
+	if (i >= MAX_KEY_DESTRUCTORS) {
+		InterlockedDecrement(&key_destructors_nr);
+		TlsFree(*keyp);
+		return EAGAIN;
+	}
+	key_destructors[i].key = *keyp;
+	key_destructors[i].destructor = destructor;
+	return 0;
+}
+
+int pthread_key_delete(pthread_key_t key)
+{
+	LONG i;
+
+	for (i = 0; i < key_destructors_nr && i < MAX_KEY_DESTRUCTORS; i++)
+		if (key_destructors[i].destructor &&
+		    key_destructors[i].key == key)
+			key_destructors[i].destructor = NULL;
+	return TlsFree(key) ? 0 : EINVAL;
+}
+
+static void run_key_destructors(void)
+{
+	LONG i, nr = key_destructors_nr;
+
+	if (nr > MAX_KEY_DESTRUCTORS)
+		nr = MAX_KEY_DESTRUCTORS;
+	for (i = 0; i < nr; i++) {
+		void (*destructor)(void *value) = key_destructors[i].destructor;
+		void *value;
+
+		if (!destructor)
+			continue;
+		value = TlsGetValue(key_destructors[i].key);
+		if (!value)
+			continue;
+		TlsSetValue(key_destructors[i].key, NULL);
+		destructor(value);
+	}
+}
+
 static unsigned __stdcall win32_start_routine(void *arg)
 {
 	pthread_t *thread = arg;
 	thread->tid = GetCurrentThreadId();
 	thread->arg = thread->start_routine(thread->arg);
+	run_key_destructors();
 	return 0;
 }
 
@@ -70,15 +70,8 @@ static inline void NORETURN pthread_exit(void *ret)
 }
 
 typedef DWORD pthread_key_t;
-static inline int pthread_key_create(pthread_key_t *keyp, void (*destructor)(void *value))
-{
-	return (*keyp = TlsAlloc()) == TLS_OUT_OF_INDEXES ? EAGAIN : 0;
-}
-
-static inline int pthread_key_delete(pthread_key_t key)
-{
-	return TlsFree(key) ? 0 : EINVAL;
-}
+int pthread_key_create(pthread_key_t *keyp, void (*destructor)(void *value));
+int pthread_key_delete(pthread_key_t key);
 
 static inline int pthread_setspecific(pthread_key_t key, const void *value)
 {
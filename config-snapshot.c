@@ -0,0 +1,367 @@
+#include "cache.h"
+#include "config.h"
+#include "config-snapshot.h"
+#include "lockfile.h"
+#include "string-list.h"
+
+#define SNAPSHOT_SIGNATURE 0x43534e50 /* "CSNP" */
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_NO_FILENAME 0xffffffff
+
+struct snapshot_file {
+	int exists;
+	struct stat_data sd;
+};
+
+static void stat_snapshot_file(struct snapshot_file *f, const char *path)
+{
+	struct stat st;
+
+	memset(f, 0, sizeof(*f));
+	f->exists = !stat(path, &st);
+	if (f->exists)
+		fill_stat_data(&f->sd, &st);
+	else if (errno != ENOENT)
+		f->exists = -1; /* neither here nor there */
+}
+
+/*
+ * Spell `path` the same whatever directory we are in, and however the
+ * git directory was given.  Only its leading directories are resolved,
+ * so that a symbolic link to a configuration file is still followed
+ * every time the snapshot is checked.
+ */
+static void snapshot_path(struct strbuf *sb, const char *path)
+{
+	const char *slash = find_last_dir_sep(path);
+	struct strbuf dir = STRBUF_INIT;
+
+	if (slash && slash != path) {
+		strbuf_add(&dir, path, slash - path);
+		path = slash + 1;
+	} else if (slash) {
+		strbuf_addch(&dir, '/');
+		path = slash + 1;
+	} else {
+		strbuf_addch(&dir, '.');
+	}
+	if (strbuf_realpath(sb, dir.buf, 0)) {
+		if (!is_dir_sep(sb->buf[sb->len - 1]))
+			strbuf_addch(sb, '/');
+		strbuf_addstr(sb, path);
+	} else {
+		strbuf_reset(sb);
+		strbuf_add_absolute_path(sb, dir.buf);
+		strbuf_addf(sb, "/%s", path);
+	}
+	strbuf_release(&dir);
+}
+
+void config_snapshot_add_file(struct string_list *files, const char *path)
+{
+	struct snapshot_file *f = xmalloc(sizeof(*f));
+	struct strbuf sb = STRBUF_INIT;
+
+	snapshot_path(&sb, path);
+	stat_snapshot_file(f, sb.buf);
+	string_list_append(files, sb.buf)->util = f;
+	strbuf_release(&sb);
+}
+
+/*
+ * Reading a snapshot, with bounds checks throughout.  Once `error` is
+ * set, nothing more is read.
+ */
+struct snapshot_reader {
+	const unsigned char *p, *end;
+	int error;
+};
+
+static uint32_t read_u32(struct snapshot_reader *r)
+{
+	uint32_t v;
+
+	if (r->error || r->end - r->p < 4) {
+		r->error = 1;
+		return 0;
+	}
+	v = get_be32(r->p);
+	r->p += 4;
+	return v;
+}
+
+static unsigned char read_u8(struct snapshot_reader *r)
+{
+	if (r->error || r->p == r->end) {
+		r->error = 1;
+		return 0;
+	}
+	return *r->p++;
+}
+
+static const char *read_string(struct snapshot_reader *r)
+{
+	const unsigned char *nul;
+	const char *s;
+
+	if (r->error)
+		return "";
+	nul = memchr(r->p, '\0', r->end - r->p);
+	if (!nul) {
+		r->error = 1;
+		return "";
+	}
+	s = (const char *)r->p;
+	r->p = nul + 1;
+	return s;
+}
+
+static void read_stat_data(struct snapshot_reader *r, struct stat_data *sd)
+{
+	sd->sd_ctime.sec = read_u32(r);
+	sd->sd_ctime.nsec = read_u32(r);
+	sd->sd_mtime.sec = read_u32(r);
+	sd->sd_mtime.nsec = read_u32(r);
+	sd->sd_dev = read_u32(r);
+	sd->sd_ino = read_u32(r);
+	sd->sd_uid = read_u32(r);
+	sd->sd_gid = read_u32(r);
+	sd->sd_size = read_u32(r);
+}
+
+static int files_changed(struct snapshot_reader *r)
+{
+	uint32_t nr = read_u32(r);
+
+	while (nr-- && !r->error) {
+		struct snapshot_file now;
+		struct stat_data sd;
+		int exists = read_u8(r);
+		const char *path;
+
+		read_stat_data(r, &sd);
+		path = read_string(r);
+		if (r->error)
+			break;
+
+		stat_snapshot_file(&now, path);
+		if (now.exists != exists ||
+		    (exists && memcmp(&sd, &now.sd, sizeof(sd))))
+			return 1;
+	}
+	return r->error;
+}
+
+/*
+ * Go through the entries, and feed them to `fn` unless it is NULL.
+ */
+static int read_entries(struct snapshot_reader *r,
+			config_snapshot_fn fn, void *data)
+{
+	uint32_t nr_names = read_u32(r), nr, i;
+	const char **names;
+
+	/* each name takes at least a byte */
+	if (r->error || nr_names > r->end - r->p)
+		return -1;
+	ALLOC_ARRAY(names, nr_names);
+	for (i = 0; i < nr_names; i++) {
+		names[i] = read_string(r);
+		if (fn)
+			names[i] = strintern(names[i]);
+	}
+
+	nr = read_u32(r);
+	while (nr-- && !r->error) {
+		struct key_value_info kvi;
+		const char *key, *value = NULL;
+		uint32_t name;
+		int has_value;
+
+		kvi.scope = read_u8(r);
+		/* never let a file in $GIT_DIR pass for anything else */
+		if (kvi.scope != CONFIG_SCOPE_LOCAL &&
+		    kvi.scope != CONFIG_SCOPE_WORKTREE)
+			r->error = 1;
+		kvi.origin_type = read_u8(r);
+		has_value = read_u8(r);
+		name = read_u32(r);
+		kvi.linenr = (int)read_u32(r);
+		key = read_string(r);
+		if (has_value)
+			value = read_string(r);
+
+		if (name == SNAPSHOT_NO_FILENAME)
+			kvi.filename = NULL;
+		else if (name < nr_names)
+			kvi.filename = names[name];
+		else
+			r->error = 1;
+
+		if (fn && !r->error)
+			fn(key, value, &kvi, data);
+	}
+
+	free(names);
+	return r->error ? -1 : 0;
+}
+
+int read_config_snapshot(const char *path, const char *key,
+			 config_snapshot_fn fn, void *data)
+{
+	struct snapshot_reader r, entries;
+	struct stat st;
+	size_t len;
+	void *map;
+	int fd, ret = 1;
+
+	fd = git_open(path);
+	if (fd < 0)
+		return errno == ENOENT ? -1 : 1;
+	if (fstat(fd, &st) || !st.st_size) {
+		close(fd);
+		return 1;
+	}
+	len = xsize_t(st.st_size);
+	map = xmmap_gently(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return 1;
+
+	r.p = map;
+	r.end = r.p + len;
+	r.error = 0;
+	if (read_u32(&r) != SNAPSHOT_SIGNATURE ||
+	    read_u32(&r) != SNAPSHOT_VERSION ||
+	    strcmp(read_string(&r), key) || r.error)
+		goto out;
+	if (files_changed(&r))
+		goto out;
+
+	/* check all of it before feeding anything to `fn` */
+	entries = r;
+	if (read_entries(&r, NULL, NULL) || r.p != r.end)
+		goto out;
+	read_entries(&entries, fn, data);
+	ret = 0;
+
+out:
+	munmap(map, len);
+	return ret;
+}
+
+static void add_u32(struct strbuf *sb, uint32_t v)
+{
+	unsigned char buf[4];
+
+	put_be32(buf, v);
+	strbuf_add(sb, buf, sizeof(buf));
+}
+
+static void add_stat_data(struct strbuf *sb, const struct stat_data *sd)
+{
+	add_u32(sb, sd->sd_ctime.sec);
+	add_u32(sb, sd->sd_ctime.nsec);
+	add_u32(sb, sd->sd_mtime.sec);
+	add_u32(sb, sd->sd_mtime.nsec);
+	add_u32(sb, sd->sd_dev);
+	add_u32(sb, sd->sd_ino);
+	add_u32(sb, sd->sd_uid);
+	add_u32(sb, sd->sd_gid);
+	add_u32(sb, sd->sd_size);
+}
+
+static uint32_t name_index(struct string_list *names, const char *name)
+{
+	int i;
+
+	if (!name)
+		return SNAPSHOT_NO_FILENAME;
+	/* the names are interned, and there are only a few */
+	for (i = 0; i < names->nr; i++)
+		if (names->items[i].string == name ||
+		    !strcmp(names->items[i].string, name))
+			return i;
+	string_list_append(names, name);
+	return names->nr - 1;
+}
+
+int write_config_snapshot(const char *path, const char *key,
+			  struct string_list *files, struct config_set *cs,
+			  time_t started)
+{
+	struct strbuf sb = STRBUF_INIT, entries = STRBUF_INIT;
+	struct string_list names = STRING_LIST_INIT_NODUP;
+	struct lock_file lk = LOCK_INIT;
+	uint32_t nr_entries = 0;
+	int i, ret = -1;
+
+	add_u32(&sb, SNAPSHOT_SIGNATURE);
+	add_u32(&sb, SNAPSHOT_VERSION);
+	strbuf_add(&sb, key, strlen(key) + 1);
+
+	add_u32(&sb, files->nr);
+	for (i = 0; i < files->nr; i++) {
+		struct snapshot_file *f = files->items[i].util, now;
+
+		/*
+		 * A file that changed since we looked at it, or that was
+		 * modified as we started (and may change again within the
+		 * granularity of its timestamp), is not to be trusted.
+		 */
+		stat_snapshot_file(&now, files->items[i].string);
+		if (f->exists < 0 || now.exists != f->exists ||
+		    memcmp(&now.sd, &f->sd, sizeof(now.sd)) ||
+		    (f->exists && f->sd.sd_mtime.sec >= (uint32_t)started))
+			goto out;
+
+		strbuf_addch(&sb, f->exists);
+		add_stat_data(&sb, &f->sd);
+		strbuf_add(&sb, files->items[i].string,
+			   strlen(files->items[i].string) + 1);
+	}
+
+	for (i = 0; i < cs->list.nr; i++) {
+		struct configset_list_item *item = &cs->list.items[i];
+		struct string_list_item *v =
+			&item->e->value_list.items[item->value_index];
+		struct key_value_info *kvi = v->util;
+
+		if (kvi->scope != CONFIG_SCOPE_LOCAL &&
+		    kvi->scope != CONFIG_SCOPE_WORKTREE)
+			continue;
+
+		strbuf_addch(&entries, kvi->scope);
+		strbuf_addch(&entries, kvi->origin_type);
+		strbuf_addch(&entries, !!v->string);
+		add_u32(&entries, name_index(&names, kvi->filename));
+		add_u32(&entries, kvi->linenr);
+		strbuf_add(&entries, item->e->key, strlen(item->e->key) + 1);
+		if (v->string)
+			strbuf_add(&entries, v->string, strlen(v->string) + 1);
+		nr_entries++;
+	}
+
+	add_u32(&sb, names.nr);
+	for (i = 0; i < names.nr; i++)
+		strbuf_add(&sb, names.items[i].string,
+			   strlen(names.items[i].string) + 1);
+	add_u32(&sb, nr_entries);
+	strbuf_addbuf(&sb, &entries);
+
+	/* someone else is writing it; they can have it */
+	if (hold_lock_file_for_update(&lk, path, 0) < 0)
+		goto out;
+	if (write_in_full(get_lock_file_fd(&lk), sb.buf, sb.len) < 0 ||
+	    commit_lock_file(&lk)) {
+		rollback_lock_file(&lk);
+		goto out;
+	}
+	ret = 0;
+
+out:
+	string_list_clear(&names, 0);
+	strbuf_release(&entries);
+	strbuf_release(&sb);
+	return ret;
+}
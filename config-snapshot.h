@@ -0,0 +1,51 @@
+#ifndef CONFIG_SNAPSHOT_H
+#define CONFIG_SNAPSHOT_H
+
+/*
+ * A snapshot of the repository's own configuration (the repository and
+ * worktree configuration, and the files they include), along with the
+ * stat data of each file that was read or looked for, so that processes
+ * can use it instead of parsing the files again for as long as none of
+ * them changes.  As it is kept in the repository, it is only trusted to
+ * stand for that configuration; entries of any other scope make it
+ * unusable.  The format is described in
+ * Documentation/technical/config-snapshot-format.txt.
+ */
+
+struct config_set;
+struct key_value_info;
+struct string_list;
+
+typedef void (*config_snapshot_fn)(const char *key, const char *value,
+				   const struct key_value_info *kvi,
+				   void *data);
+
+/*
+ * Add `path` to `files`, the files the configuration is read from, and
+ * note its stat data.  Call this before reading the file, or checking
+ * whether it exists.  The stat data is kept in the `util` fields, for
+ * string_list_clear(files, 1) to free.
+ */
+void config_snapshot_add_file(struct string_list *files, const char *path);
+
+/*
+ * Feed the entries of the snapshot at `path` to `fn`, in order, if it
+ * was taken under the same `key` and none of its files changed since.
+ * Returns 0 if so.  Otherwise `fn` is not called, and this returns -1
+ * if there is no snapshot, and 1 if it cannot be used.
+ */
+int read_config_snapshot(const char *path, const char *key,
+			 config_snapshot_fn fn, void *data);
+
+/*
+ * Write a snapshot of the entries of `cs` from the repository and
+ * worktree configuration, which were read from `files` after `started`.  Nothing
+ * is written if one of the files may have changed in the meantime, or
+ * if the snapshot cannot be locked.  Returns 0 if the snapshot was
+ * written, and -1 otherwise.
+ */
+int write_config_snapshot(const char *path, const char *key,
+			  struct string_list *files, struct config_set *cs,
+			  time_t started);
+
+#endif /* CONFIG_SNAPSHOT_H */
@@ -8,6 +8,7 @@
 #include "cache.h"
 #include "branch.h"
 #include "config.h"
+#include "config-snapshot.h"
 #include "repository.h"
 #include "lockfile.h"
 #include "exec-cmd.h"
@@ -75,6 +76,45 @@ static struct key_value_info *current_config_kvi;
  */
 static enum config_scope current_parsing_scope;
 
+/*
+ * While the configuration of a repository is read to take a snapshot of
+ * it, the files that are read, or would be if they existed.
+ */
+static struct string_list *snapshot_files;
+
+/*
+ * Only the repository's own configuration goes into its snapshot; a file
+ * inside $GIT_DIR must not speak for the system or global configuration,
+ * which are read afresh every time, as is the command line.
+ */
+static int snapshot_scope(enum config_scope scope)
+{
+	return scope == CONFIG_SCOPE_LOCAL || scope == CONFIG_SCOPE_WORKTREE;
+}
+
+static void snapshot_add_file(const char *path)
+{
+	if (snapshot_files && snapshot_scope(current_parsing_scope))
+		config_snapshot_add_file(snapshot_files, path);
+}
+
+/*
+ * The absolute path of the git directory, as "gitdir:" conditions match
+ * it when its real path does not.  Spell it the same however the
+ * directory was given, e.g. with a trailing "/.".
+ */
+static void add_absolute_git_dir(struct strbuf *sb, const char *git_dir)
+{
+	struct strbuf path = STRBUF_INIT;
+
+	strbuf_add_absolute_path(&path, git_dir);
+	if (!strbuf_normalize_path(&path))
+		while (path.len > 1 && is_dir_sep(path.buf[path.len - 1]))
+			strbuf_setlen(&path, path.len - 1);
+	strbuf_addbuf(sb, &path);
+	strbuf_release(&path);
+}
+
 static int core_compression_seen;
 static int pack_compression_seen;
 static int zlib_compression_seen;
@@ -158,6 +198,7 @@ static int handle_path_include(const char *path, struct config_include_data *inc
 		path = buf.buf;
 	}
 
+	snapshot_add_file(path);
 	if (!access_or_die(path, R_OK, 0)) {
 		if (++inc->depth > MAX_INCLUDE_DEPTH)
 			die(_(include_depth_advice), MAX_INCLUDE_DEPTH, path,
@@ -261,7 +302,7 @@ static int include_by_gitdir(const struct config_options *opts,
 		 * which'll do the right thing
 		 */
 		strbuf_reset(&text);
-		strbuf_add_absolute_path(&text, git_dir);
+		add_absolute_git_dir(&text, git_dir);
 		already_tried_absolute = 1;
 		goto again;
 	}
@@ -276,10 +317,14 @@ static int include_by_branch(const char *cond, size_t cond_len)
 	int flags;
 	int ret;
 	struct strbuf pattern = STRBUF_INIT;
-	const char *refname = !the_repository->gitdir ?
-		NULL : resolve_ref_unsafe("HEAD", 0, NULL, &flags);
+	const char *refname = NULL;
 	const char *shortname;
 
+	if (the_repository->gitdir) {
+		snapshot_add_file(git_path("HEAD"));
+		refname = resolve_ref_unsafe("HEAD", 0, NULL, &flags);
+	}
+
 	if (!refname || !(flags & REF_ISSYMREF)	||
 			!skip_prefix(refname, "refs/heads/", &shortname))
 		return 0;
@@ -1742,6 +1787,8 @@ static int do_git_config_sequence(const struct config_options *opts,
 		ret += git_config_from_file(fn, user_config, data);
 
 	current_parsing_scope = CONFIG_SCOPE_LOCAL;
+	if (!opts->ignore_repo && repo_config)
+		snapshot_add_file(repo_config);
 	if (!opts->ignore_repo && repo_config &&
 	    !access_or_die(repo_config, R_OK, 0))
 		ret += git_config_from_file(fn, repo_config, data);
@@ -1749,6 +1796,7 @@ static int do_git_config_sequence(const struct config_options *opts,
 	current_parsing_scope = CONFIG_SCOPE_WORKTREE;
 	if (!opts->ignore_worktree && repository_format_worktree_config) {
 		char *path = git_pathdup("config.worktree");
+		snapshot_add_file(path);
 		if (!access_or_die(path, R_OK, 0))
 			ret += git_config_from_file(fn, path, data);
 		free(path);
@@ -1866,9 +1914,18 @@ void read_very_early_config(config_fn_t cb, void *data)
 	config_with_options(cb, data, NULL, &opts);
 }
 
-static struct config_set_element *configset_find_element(struct config_set *cs, const char *key)
+static struct config_set_element *configset_find_normalized(struct config_set *cs,
+							   const char *key)
 {
 	struct config_set_element k;
+
+	hashmap_entry_init(&k.ent, strhash(key));
+	k.key = (char *)key;
+	return hashmap_get_entry(&cs->config_hash, &k, ent, NULL);
+}
+
+static struct config_set_element *configset_find_element(struct config_set *cs, const char *key)
+{
 	struct config_set_element *found_entry;
 	char *normalized_key;
 	/*
@@ -1878,25 +1935,24 @@ static struct config_set_element *configset_find_element(struct config_set *cs,
 	if (git_config_parse_key(key, &normalized_key, NULL))
 		return NULL;
 
-	hashmap_entry_init(&k.ent, strhash(normalized_key));
-	k.key = normalized_key;
-	found_entry = hashmap_get_entry(&cs->config_hash, &k, ent, NULL);
+	found_entry = configset_find_normalized(cs, normalized_key);
 	free(normalized_key);
 	return found_entry;
 }
 
-static int configset_add_value(struct config_set *cs, const char *key, const char *value)
+static void configset_add_entry(struct config_set *cs, const char *key,
+				const char *value, struct key_value_info *kv_info)
 {
 	struct config_set_element *e;
 	struct string_list_item *si;
 	struct configset_list_item *l_item;
-	struct key_value_info *kv_info = xmalloc(sizeof(*kv_info));
 
-	e = configset_find_element(cs, key);
 	/*
-	 * Since the keys are being fed by git_config*() callback mechanism, they
-	 * are already normalized. So simply add them without any further munging.
+	 * Since the keys are being fed by git_config*() callback mechanism, or
+	 * come from a snapshot of what was, they are already normalized. So
+	 * simply look them up and add them without any further munging.
 	 */
+	e = configset_find_normalized(cs, key);
 	if (!e) {
 		e = xmalloc(sizeof(*e));
 		hashmap_entry_init(&e->ent, strhash(key));
@@ -1910,6 +1966,12 @@ static int configset_add_value(struct config_set *cs, const char *key, const cha
 	l_item = &cs->list.items[cs->list.nr++];
 	l_item->e = e;
 	l_item->value_index = e->value_list.nr - 1;
+	si->util = kv_info;
+}
+
+static int configset_add_value(struct config_set *cs, const char *key, const char *value)
+{
+	struct key_value_info *kv_info = xmalloc(sizeof(*kv_info));
 
 	if (!cf)
 		BUG("configset_add_value has no source");
@@ -1924,7 +1986,7 @@ static int configset_add_value(struct config_set *cs, const char *key, const cha
 		kv_info->origin_type = CONFIG_ORIGIN_CMDLINE;
 	}
 	kv_info->scope = current_parsing_scope;
-	si->util = kv_info;
+	configset_add_entry(cs, key, value, kv_info);
 
 	return 0;
 }
@@ -2091,10 +2153,65 @@ int git_configset_get_pathname(struct config_set *cs, const char *key, const cha
 		return 1;
 }
 
+static void configset_add_snapshot_value(const char *key, const char *value,
+					 const struct key_value_info *kvi,
+					 void *cs)
+{
+	struct key_value_info *kv_info = xmalloc(sizeof(*kv_info));
+
+	*kv_info = *kvi;
+	configset_add_entry(cs, key, value, kv_info);
+}
+
+/*
+ * Besides the files, what decides which files the repository's
+ * configuration includes: a snapshot is only good for the same.
+ */
+static void config_snapshot_key(struct strbuf *key, struct repository *repo)
+{
+	struct strbuf realpath = STRBUF_INIT;
+	const char *env;
+
+	strbuf_addstr(key, "gitdir ");
+	add_absolute_git_dir(key, repo->gitdir);
+	strbuf_addch(key, '\n');
+	if (strbuf_realpath(&realpath, repo->gitdir, 0))
+		strbuf_addf(key, "realgitdir %s\n", realpath.buf);
+	if ((env = getenv("HOME")))
+		strbuf_addf(key, "home %s\n", env);
+	strbuf_addf(key, "worktree %d\n", repository_format_worktree_config);
+	strbuf_release(&realpath);
+}
+
+/*
+ * Whether the files ask for snapshots; the command line does not count,
+ * as it is not part of them.
+ */
+static int config_snapshot_enabled(struct config_set *cs)
+{
+	const struct string_list *values =
+		git_configset_get_value_multi(cs, "core.configsnapshot");
+	int i;
+
+	for (i = values ? values->nr - 1 : -1; i >= 0; i--) {
+		const struct key_value_info *kvi = values->items[i].util;
+
+		if (kvi->scope != CONFIG_SCOPE_COMMAND)
+			return git_config_bool("core.configsnapshot",
+					       values->items[i].string);
+	}
+	return git_env_bool("GIT_TEST_CONFIG_SNAPSHOT", 0);
+}
+
 /* Functions use to read configuration from a repository */
 static void repo_read_config(struct repository *repo)
 {
 	struct config_options opts = { 0 };
+	struct string_list files = STRING_LIST_INIT_DUP;
+	struct strbuf key = STRBUF_INIT;
+	char *snapshot = NULL;
+	time_t started = 0;
+	int ret = -1;
 
 	opts.respect_includes = 1;
 	opts.commondir = repo->commondir;
@@ -2107,6 +2224,54 @@ static void repo_read_config(struct repository *repo)
 
 	git_configset_init(repo->config);
 
+	/*
+	 * The files are only read in this order for the_repository; see
+	 * "config.worktree" in do_git_config_sequence().
+	 */
+	if (repo == the_repository && repo->gitdir) {
+		snapshot = repo_git_path(repo, "config.snapshot");
+		config_snapshot_key(&key, repo);
+
+		/* the system and global configuration come first, afresh */
+		opts.ignore_repo = opts.ignore_worktree = opts.ignore_cmdline = 1;
+		if (config_with_options(config_set_callback, repo->config,
+					NULL, &opts) < 0)
+			die(_("unknown error occurred while reading the configuration files"));
+		opts.ignore_repo = opts.ignore_worktree = opts.ignore_cmdline = 0;
+
+		ret = read_config_snapshot(snapshot, key.buf,
+					  configset_add_snapshot_value,
+					  repo->config);
+		/* only if the configuration still asks for it */
+		if (!ret && !config_snapshot_enabled(repo->config))
+			ret = 1;
+		if (ret) {
+			git_configset_clear(repo->config);
+			git_configset_init(repo->config);
+		}
+	}
+
+	if (!ret) {
+		struct config_include_data inc = CONFIG_INCLUDE_INIT;
+		enum config_scope prev_parsing_scope = current_parsing_scope;
+
+		trace2_data_string("config", repo, "snapshot", "used");
+
+		/* what do_git_config_sequence() reads after the files */
+		inc.fn = config_set_callback;
+		inc.data = repo->config;
+		inc.opts = &opts;
+		current_parsing_scope = CONFIG_SCOPE_COMMAND;
+		if (git_config_from_parameters(git_config_include, &inc) < 0)
+			die(_("unable to parse command-line config"));
+		current_parsing_scope = prev_parsing_scope;
+		goto out;
+	}
+
+	if (snapshot) {
+		started = time(NULL);
+		snapshot_files = &files;
+	}
 	if (config_with_options(config_set_callback, repo->config, NULL, &opts) < 0)
 		/*
 		 * config_with_options() normally returns only
@@ -2120,6 +2285,22 @@ static void repo_read_config(struct repository *repo)
 		 * immediately.
 		 */
 		die(_("unknown error occurred while reading the configuration files"));
+	snapshot_files = NULL;
+
+	if (!snapshot)
+		; /* nothing to do */
+	else if (!config_snapshot_enabled(repo->config)) {
+		/* a stale one that is not to be used anymore */
+		if (ret > 0)
+			unlink(snapshot);
+	} else if (!write_config_snapshot(snapshot, key.buf, &files,
+					  repo->config, started))
+		trace2_data_string("config", repo, "snapshot", "written");
+
+out:
+	string_list_clear(&files, 1);
+	strbuf_release(&key);
+	free(snapshot);
 }
 
 static void git_config_check_init(struct repository *repo)
@@ -6,6 +6,51 @@
 #include "transport.h"
 #include "packfile.h"
 #include "promisor-remote.h"
+#include "oid-array.h"
+
+/*
+ * Consume the ".foreign" file that "index-pack --report-foreign" left
+ * next to the pack locked by "keep_file", and return that pack with
+ * the listed objects added to "foreign". Returns NULL if there is no
+ * such file or it cannot be used.
+ */
+static struct packed_git *open_reported_pack(const char *keep_file,
+					     struct oid_array *foreign)
+{
+	struct strbuf name = STRBUF_INIT;
+	struct strbuf buf = STRBUF_INIT;
+	struct packed_git *pack = NULL;
+	const char *p, *end;
+	size_t base_len;
+
+	if (!strip_suffix(keep_file, ".keep", &base_len))
+		return NULL;
+	strbuf_add(&name, keep_file, base_len);
+	strbuf_addstr(&name, ".foreign");
+	if (strbuf_read_file(&buf, name.buf, 0) < 0)
+		goto out;
+	unlink_or_warn(name.buf);
+
+	for (p = buf.buf; *p; p = end + !!*end) {
+		struct object_id oid;
+
+		if (parse_oid_hex(p, &oid, &end) || (*end && *end != '\n')) {
+			oid_array_clear(foreign);
+			goto out;
+		}
+		oid_array_append(foreign, &oid);
+	}
+
+	strbuf_setlen(&name, base_len);
+	strbuf_addstr(&name, ".idx");
+	pack = add_packed_git(name.buf, name.len, 1);
+	if (!pack)
+		oid_array_clear(foreign);
+out:
+	strbuf_release(&buf);
+	strbuf_release(&name);
+	return pack;
+}
 
 /*
  * If we feed all the commits we want to verify to this command
@@ -16,6 +61,10 @@
  * these commits locally exists and is connected to our existing refs.
  * Note that this does _not_ validate the individual objects.
  *
+ * When index-pack has already checked the links inside the new pack
+ * and told us which objects outside of it they point at, those
+ * objects take the place of the commits that are in the pack.
+ *
  * Returns 0 if everything is connected, non-zero otherwise.
  */
 int check_connected(oid_iterate_fn fn, void *cb_data,
@@ -28,19 +77,29 @@ int check_connected(oid_iterate_fn fn, void *cb_data,
 	int err = 0;
 	struct packed_git *new_pack = NULL;
 	struct transport *transport;
+	const char *new_pack_keep;
+	struct oid_array to_walk = OID_ARRAY_INIT;
+	int i;
 	size_t base_len;
 
 	if (!opt)
 		opt = &defaults;
 	transport = opt->transport;
 
+	new_pack_keep = opt->new_pack_keep;
+	if (!new_pack_keep && transport && transport->pack_lockfiles.nr == 1)
+		new_pack_keep = transport->pack_lockfiles.items[0].string;
+	if (new_pack_keep)
+		new_pack = open_reported_pack(new_pack_keep, &to_walk);
+
 	if (fn(cb_data, &oid)) {
 		if (opt->err_fd)
 			close(opt->err_fd);
+		oid_array_clear(&to_walk);
 		return err;
 	}
 
-	if (transport && transport->smart_options &&
+	if (!new_pack && transport && transport->smart_options &&
 	    transport->smart_options->self_contained_and_connected &&
 	    transport->pack_lockfiles.nr == 1 &&
 	    strip_suffix(transport->pack_lockfiles.items[0].string,
@@ -84,10 +143,32 @@ int check_connected(oid_iterate_fn fn, void *cb_data,
 promisor_pack_found:
 			;
 		} while (!fn(cb_data, &oid));
+		oid_array_clear(&to_walk);
 		return 0;
 	}
 
 no_promisor_pack_found:
+	do {
+		/*
+		 * If index-pack already checked that:
+		 * - there are no dangling pointers in the new pack
+		 * - the pack is self contained, or the objects it
+		 *   points at outside of itself are walked instead
+		 * Then if the updated ref is in the new pack, then we
+		 * are sure the ref is good and not sending it to
+		 * rev-list for verification.
+		 */
+		if (new_pack && find_pack_entry_one(oid.hash, new_pack))
+			continue;
+		oid_array_append(&to_walk, &oid);
+	} while (!fn(cb_data, &oid));
+
+	if (!to_walk.nr) {
+		if (opt->err_fd)
+			close(opt->err_fd);
+		return 0;
+	}
+
 	if (opt->shallow_file) {
 		strvec_push(&rev_list.args, "--shallow-file");
 		strvec_push(&rev_list.args, opt->shallow_file);
@@ -116,28 +197,19 @@ int check_connected(oid_iterate_fn fn, void *cb_data,
 	else
 		rev_list.no_stderr = opt->quiet;
 
-	if (start_command(&rev_list))
+	if (start_command(&rev_list)) {
+		oid_array_clear(&to_walk);
 		return error(_("Could not run 'git rev-list'"));
+	}
 
 	sigchain_push(SIGPIPE, SIG_IGN);
 
 	rev_list_in = xfdopen(rev_list.in, "w");
 
-	do {
-		/*
-		 * If index-pack already checked that:
-		 * - there are no dangling pointers in the new pack
-		 * - the pack is self contained
-		 * Then if the updated ref is in the new pack, then we
-		 * are sure the ref is good and not sending it to
-		 * rev-list for verification.
-		 */
-		if (new_pack && find_pack_entry_one(oid.hash, new_pack))
-			continue;
-
-		if (fprintf(rev_list_in, "%s\n", oid_to_hex(&oid)) < 0)
+	for (i = 0; i < to_walk.nr; i++)
+		if (fprintf(rev_list_in, "%s\n", oid_to_hex(&to_walk.oid[i])) < 0)
 			break;
-	} while (!fn(cb_data, &oid));
+	oid_array_clear(&to_walk);
 
 	if (ferror(rev_list_in) || fflush(rev_list_in)) {
 		if (errno != EPIPE && errno != EINVAL)
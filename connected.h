@@ -25,6 +25,13 @@ struct check_connected_options {
 	/* Transport whose objects we are checking, if available. */
 	struct transport *transport;
 
+	/*
+	 * The ".keep" file of the pack that brought in the objects we are
+	 * checking, if it was written by "index-pack --report-foreign".
+	 * Defaults to the one in "transport", if it fetched a single pack.
+	 */
+	const char *new_pack_keep;
+
 	/*
 	 * If non-zero, send error messages to this descriptor rather
 	 * than stderr. The descriptor is closed before check_connected
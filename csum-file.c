@@ -118,6 +118,50 @@ void hashwrite(struct hashfile *f, const void *buf, unsigned int count)
 	}
 }
 
+/*
+ * Like hashwrite(), but `buf` holds a copy of the `count` bytes found
+ * at `src_offset` in `src_fd` (typically because `buf` is mmapped from
+ * it). If we can, the data is checksummed straight from `buf` and then
+ * handed to the kernel to copy from `src_fd`, so that it never passes
+ * through our buffer or user space again.
+ */
+void hashwrite_from_fd(struct hashfile *f, const void *buf, unsigned int count,
+		       int src_fd, off_t src_offset)
+{
+#ifdef HAVE_SENDFILE
+	if (src_fd < 0 || 0 <= f->check_fd || count < HASHWRITE_SENDFILE_MIN) {
+		hashwrite(f, buf, count);
+		return;
+	}
+
+	hashflush(f);
+	if (f->do_crc)
+		f->crc32 = crc32(f->crc32, buf, count);
+	the_hash_algo->update_fn(&f->ctx, buf, count);
+
+	while (count) {
+		ssize_t ret = sendfile(f->fd, src_fd, &src_offset, count);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			/*
+			 * The output might not support it (or might be
+			 * non-blocking); write the rest the old way.
+			 */
+			flush(f, buf, count);
+			return;
+		}
+		f->total += ret;
+		display_throughput(f->tp, f->total);
+		buf = (const char *)buf + ret;
+		count -= ret;
+	}
+#else
+	hashwrite(f, buf, count);
+#endif
+}
+
 struct hashfile *hashfd(int fd, const char *name)
 {
 	return hashfd_throughput(fd, name, NULL);
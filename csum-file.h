@@ -38,6 +38,14 @@ struct hashfile *hashfd_check(const char *name);
 struct hashfile *hashfd_throughput(int fd, const char *name, struct progress *tp);
 int finalize_hashfile(struct hashfile *, unsigned char *, unsigned int);
 void hashwrite(struct hashfile *, const void *, unsigned int);
+
+/*
+ * Writes shorter than this are not worth the extra system calls of
+ * hashwrite_from_fd() and are copied through the buffer instead.
+ */
+#define HASHWRITE_SENDFILE_MIN (64 * 1024)
+void hashwrite_from_fd(struct hashfile *, const void *, unsigned int,
+		       int src_fd, off_t src_offset);
 void hashflush(struct hashfile *f);
 void crc32_begin(struct hashfile *);
 uint32_t crc32_end(struct hashfile *);
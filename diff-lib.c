@@ -506,6 +506,20 @@ static int diff_cache(struct rev_info *revs,
 	opts.pathspec = &revs->diffopt.pathspec;
 	opts.pathspec->recursive = 1;
 
+	/*
+	 * A valid top-level cache-tree that records the very tree we
+	 * are comparing with means the index has no staged changes;
+	 * unpack_trees() would skip every subtree anyway, but only
+	 * after walking the top-level tree and the index.
+	 */
+	if (opts.diff_index_cached) {
+		struct cache_tree *it = opts.src_index->cache_tree;
+
+		if (it && it->entry_count >= 0 &&
+		    oideq(&it->oid, &tree->object.oid))
+			return 0;
+	}
+
 	init_tree_desc(&t, tree->buffer, tree->size);
 	return unpack_trees(1, &t, &opts);
 }
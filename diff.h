@@ -276,6 +276,12 @@ struct diff_options {
 	int rename_score;
 	int rename_limit;
 
+	/* Threads to score inexact rename candidates with; 0 means one per CPU. */
+	int rename_threads;
+
+	/* Look up and store inexact rename results in $GIT_DIR/rename-cache. */
+	int rename_cache;
+
 	int needed_rename_limit;
 	int degraded_cc_to_c;
 	int show_rename_progress;
@@ -556,6 +562,12 @@ int diff_queue_is_empty(void);
 void diff_flush(struct diff_options*);
 void diff_warn_rename_limit(const char *varname, int needed, int degraded_cc);
 
+/*
+ * Remove the entries of the rename cache (see diff.renameCache) that
+ * were last used at or before `expire`.
+ */
+void prune_rename_cache(struct repository *r, timestamp_t expire);
+
 /* diff-raw status letters */
 #define DIFF_STATUS_ADDED		'A'
 #define DIFF_STATUS_COPIED		'C'
@@ -163,6 +163,23 @@ static struct spanhash_top *hash_chars(struct repository *r,
 	return hash;
 }
 
+void diffcore_prepare_count(struct repository *r, struct diff_filespec *one)
+{
+	if (!one->cnt_data)
+		one->cnt_data = hash_chars(r, one);
+}
+
+void diffcore_for_each_span(struct diff_filespec *one,
+			    each_span_fn fn, void *data)
+{
+	struct spanhash_top *count = one->cnt_data;
+	struct spanhash *s;
+
+	/* hash_chars() sorted the used slots to the front */
+	for (s = count->data; s->cnt; s++)
+		fn(s->hashval, s->cnt, data);
+}
+
 int diffcore_count_changes(struct repository *r,
 			   struct diff_filespec *src,
 			   struct diff_filespec *dst,
@@ -3,12 +3,17 @@
  * Copyright (C) 2005 Junio C Hamano
  */
 #include "cache.h"
+#include "config.h"
 #include "diff.h"
 #include "diffcore.h"
+#include "dir.h"
 #include "object-store.h"
 #include "hashmap.h"
 #include "progress.h"
 #include "promisor-remote.h"
+#include "string-list.h"
+#include "lockfile.h"
+#include "thread-utils.h"
 
 /* Table of rename/copy destinations */
 
@@ -165,11 +170,103 @@ static void prefetch(void *prefetch_options)
 	oid_array_clear(&to_fetch);
 }
 
+/*
+ * We would not consider edits that change the file size so
+ * drastically.  delta_size must be smaller than
+ * (MAX_SCORE-minimum_score)/MAX_SCORE * min(src->size, dst->size).
+ *
+ * Note that base_size == 0 case is handled here already
+ * and the final score computation in estimate_similarity()
+ * would not have a divide-by-zero issue.
+ */
+static int sizes_can_match(unsigned long a, unsigned long b, int minimum_score)
+{
+	unsigned long max_size, delta_size, base_size;
+
+	max_size = ((a > b) ? a : b);
+	base_size = ((a < b) ? a : b);
+	delta_size = max_size - base_size;
+
+	return max_size * (MAX_SCORE-minimum_score) >= delta_size * MAX_SCORE;
+}
+
+/*
+ * Is there a file in sizes[], sorted in increasing order, that is close
+ * enough in size to one of "size" bytes to be a rename of it?
+ */
+static int has_size_match(const unsigned long *sizes, int nr,
+			  unsigned long size, int minimum_score)
+{
+	int lo = 0, hi = nr;
+
+	/* find the smallest one that is not too small */
+	while (lo < hi) {
+		int mi = lo + (hi - lo) / 2;
+		if ((uint64_t)sizes[mi] * MAX_SCORE <
+		    (uint64_t)size * minimum_score)
+			lo = mi + 1;
+		else
+			hi = mi;
+	}
+	return lo < nr && sizes_can_match(sizes[lo], size, minimum_score);
+}
+
+static int ulong_cmp(const void *a_, const void *b_)
+{
+	const unsigned long *a = a_, *b = b_;
+
+	return *a < *b ? -1 : *a > *b;
+}
+
+/*
+ * Make sure the size of a rename source or destination is known.
+ * Returns -1 if the file cannot take part in inexact rename detection.
+ */
+static int prepare_similarity_size(struct repository *r,
+				   struct diff_filespec *one,
+				   struct diff_populate_filespec_options *dpf_options)
+{
+	/* We deal only with regular files.  Symlink renames are handled
+	 * only when they are exact matches --- in other words, no edits
+	 * after renaming.
+	 */
+	if (!S_ISREG(one->mode))
+		return -1;
+
+	/*
+	 * If we already have "cnt_data" filled in, we know the size
+	 * is good (avoid checking the size for zero, as that is a
+	 * possible size - we really should have a flag to say whether
+	 * the size is valid or not!)
+	 */
+	if (one->cnt_data)
+		return 0;
+	dpf_options->check_size_only = 1;
+	return diff_populate_filespec(r, one, dpf_options) ? -1 : 0;
+}
+
+/*
+ * Load the contents and compute the span hashes estimate_similarity()
+ * needs, dropping the contents again right away.
+ */
+static int prepare_similarity(struct repository *r,
+			      struct diff_filespec *one,
+			      struct diff_populate_filespec_options *dpf_options)
+{
+	if (one->cnt_data)
+		return 0;
+	dpf_options->check_size_only = 0;
+	if (diff_populate_filespec(r, one, dpf_options))
+		return -1;
+	diffcore_prepare_count(r, one);
+	diff_free_filespec_blob(one);
+	return 0;
+}
+
 static int estimate_similarity(struct repository *r,
 			       struct diff_filespec *src,
 			       struct diff_filespec *dst,
-			       int minimum_score,
-			       int skip_unmodified)
+			       int minimum_score)
 {
 	/* src points at a file that existed in the original tree (or
 	 * optionally a file in the destination tree) and dst points
@@ -183,63 +280,17 @@ static int estimate_similarity(struct repository *r,
 	 * When there is an exact match, it is considered a better
 	 * match than anything else; the destination does not even
 	 * call into this function in that case.
+	 *
+	 * Both must have gone through prepare_similarity() already, so
+	 * this only looks at their sizes and span hashes and is safe to
+	 * call from several threads at once.
 	 */
-	unsigned long max_size, delta_size, base_size, src_copied, literal_added;
+	unsigned long max_size, src_copied, literal_added;
 	int score;
-	struct diff_populate_filespec_options dpf_options = {
-		.check_size_only = 1
-	};
-	struct prefetch_options prefetch_options = {r, skip_unmodified};
 
-	if (r == the_repository && has_promisor_remote()) {
-		dpf_options.missing_object_cb = prefetch;
-		dpf_options.missing_object_data = &prefetch_options;
-	}
-
-	/* We deal only with regular files.  Symlink renames are handled
-	 * only when they are exact matches --- in other words, no edits
-	 * after renaming.
-	 */
-	if (!S_ISREG(src->mode) || !S_ISREG(dst->mode))
-		return 0;
-
-	/*
-	 * Need to check that source and destination sizes are
-	 * filled in before comparing them.
-	 *
-	 * If we already have "cnt_data" filled in, we know it's
-	 * all good (avoid checking the size for zero, as that
-	 * is a possible size - we really should have a flag to
-	 * say whether the size is valid or not!)
-	 */
-	if (!src->cnt_data &&
-	    diff_populate_filespec(r, src, &dpf_options))
+	if (!sizes_can_match(src->size, dst->size, minimum_score))
 		return 0;
-	if (!dst->cnt_data &&
-	    diff_populate_filespec(r, dst, &dpf_options))
-		return 0;
-
 	max_size = ((src->size > dst->size) ? src->size : dst->size);
-	base_size = ((src->size < dst->size) ? src->size : dst->size);
-	delta_size = max_size - base_size;
-
-	/* We would not consider edits that change the file size so
-	 * drastically.  delta_size must be smaller than
-	 * (MAX_SCORE-minimum_score)/MAX_SCORE * min(src->size, dst->size).
-	 *
-	 * Note that base_size == 0 case is handled here already
-	 * and the final score computation below would not have a
-	 * divide-by-zero issue.
-	 */
-	if (max_size * (MAX_SCORE-minimum_score) < delta_size * MAX_SCORE)
-		return 0;
-
-	dpf_options.check_size_only = 0;
-
-	if (!src->cnt_data && diff_populate_filespec(r, src, &dpf_options))
-		return 0;
-	if (!dst->cnt_data && diff_populate_filespec(r, dst, &dpf_options))
-		return 0;
 
 	if (diffcore_count_changes(r, src, dst,
 				   &src->cnt_data, &dst->cnt_data,
@@ -497,6 +548,770 @@ static int find_renames(struct diff_score *mx, int dst_cnt, int minimum_score, i
 	return count;
 }
 
+static const char *get_basename(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+
+	return slash ? slash + 1 : path;
+}
+
+/*
+ * Sort list and drop every basename that appears in it more than once.
+ */
+static void keep_unique_basenames(struct string_list *list)
+{
+	size_t i, j, nr = 0;
+
+	string_list_sort(list);
+	for (i = 0; i < list->nr; i = j) {
+		for (j = i + 1; j < list->nr; j++)
+			if (strcmp(list->items[i].string, list->items[j].string))
+				break;
+		if (j == i + 1)
+			list->items[nr++] = list->items[i];
+	}
+	list->nr = nr;
+}
+
+/*
+ * Most inexact renames in practice move a file to another directory
+ * and keep its name. Before scoring the remaining destinations against
+ * every source, pair up the files whose basename is unique among both
+ * the unmatched sources and the unmatched destinations, and check just
+ * that one pair.
+ *
+ * Accepting such a pair skips looking for a better source elsewhere, so
+ * it has to clear a higher bar than the usual minimum score.
+ */
+static int find_basename_matches(struct diff_options *options,
+				 int minimum_score,
+				 struct diff_populate_filespec_options *dpf_options,
+				 int *similarity_checks)
+{
+	struct repository *r = options->repo;
+	struct string_list srcs = STRING_LIST_INIT_NODUP;
+	struct string_list dsts = STRING_LIST_INIT_NODUP;
+	int basename_score = minimum_score + (MAX_SCORE - minimum_score) / 2;
+	int i, j, renames = 0;
+
+	for (i = 0; i < rename_src_nr; i++) {
+		struct diff_filespec *one = rename_src[i].p->one;
+		if (one->rename_used)
+			continue;
+		string_list_append(&srcs, get_basename(one->path))->util =
+			(void *)(intptr_t)i;
+	}
+	for (i = 0; i < rename_dst_nr; i++) {
+		if (rename_dst[i].pair)
+			continue;
+		string_list_append(&dsts, get_basename(rename_dst[i].two->path))->util =
+			(void *)(intptr_t)i;
+	}
+	keep_unique_basenames(&srcs);
+	keep_unique_basenames(&dsts);
+
+	for (i = j = 0; i < srcs.nr && j < dsts.nr; ) {
+		int cmp = strcmp(srcs.items[i].string, dsts.items[j].string);
+		int src_index, dst_index, score;
+		struct diff_filespec *one, *two;
+
+		if (cmp) {
+			if (cmp < 0)
+				i++;
+			else
+				j++;
+			continue;
+		}
+		src_index = (intptr_t)srcs.items[i++].util;
+		dst_index = (intptr_t)dsts.items[j++].util;
+		one = rename_src[src_index].p->one;
+		two = rename_dst[dst_index].two;
+
+		if (prepare_similarity_size(r, one, dpf_options) ||
+		    prepare_similarity_size(r, two, dpf_options) ||
+		    !sizes_can_match(one->size, two->size, basename_score) ||
+		    prepare_similarity(r, one, dpf_options) ||
+		    prepare_similarity(r, two, dpf_options))
+			continue;
+		score = estimate_similarity(r, one, two, basename_score);
+		(*similarity_checks)++;
+		if (score < basename_score)
+			continue;
+		record_rename_pair(dst_index, src_index, score);
+		renames++;
+	}
+
+	string_list_clear(&srcs, 0);
+	string_list_clear(&dsts, 0);
+	return renames;
+}
+
+/*
+ * Scoring every destination against every source does not scale to
+ * tens of thousands of files, and most of those pairs share no content
+ * at all. Instead, build an inverted index from the span hashes that
+ * diffcore_count_changes() works with to the sources they appear in,
+ * and only score the sources a destination shares a span with.
+ *
+ * Spans that appear in very many sources (blank lines, closing braces,
+ * license headers) would make the candidate lists quadratic again, so
+ * they are not followed. A source that shares nothing but such common
+ * spans with a destination has copied at most as many bytes as the
+ * destination has in common spans. When that is below the minimum
+ * score, leaving the pair out cannot change the outcome; otherwise the
+ * destination is scored against every source, like it used to be.
+ *
+ * The sources that pass the minimum score are the same either way, but
+ * when several of them tie for a destination, which one wins depends on
+ * which slot of record_if_better() each landed in, and that depends on
+ * every low-scoring source seen before it. A destination whose
+ * candidates tie is therefore scored against every source after all,
+ * so that it ends up with the same renames as without the index.
+ *
+ * Building the index does not pay for itself on small inputs, which
+ * keep scoring every pair.
+ */
+#define COMMON_SPAN_SOURCES 64
+#define INDEXED_RENAME_MIN_PAIRS (1 << 16)
+
+static uint64_t indexed_rename_min_pairs(void)
+{
+	return git_env_ulong("GIT_TEST_RENAME_INDEX_MIN_PAIRS",
+			     INDEXED_RENAME_MIN_PAIRS);
+}
+
+struct span_index {
+	unsigned int *hashval;	/* distinct span hashes, sorted */
+	size_t *start;		/* hashval[i] is in src[start[i]..start[i+1]) */
+	int *src;
+	size_t nr;
+};
+
+struct span_src {
+	unsigned int hashval;
+	int src;
+};
+
+struct span_src_list {
+	struct span_src *v;
+	size_t nr, alloc;
+	int src;
+};
+
+static void add_span_src(unsigned int hashval, unsigned int cnt, void *data)
+{
+	struct span_src_list *list = data;
+
+	ALLOC_GROW(list->v, list->nr + 1, list->alloc);
+	list->v[list->nr].hashval = hashval;
+	list->v[list->nr].src = list->src;
+	list->nr++;
+}
+
+static int span_src_cmp(const void *a_, const void *b_)
+{
+	const struct span_src *a = a_, *b = b_;
+
+	if (a->hashval != b->hashval)
+		return a->hashval < b->hashval ? -1 : 1;
+	return a->src - b->src;
+}
+
+static void build_span_index(struct span_index *index,
+			     const int *src_ok)
+{
+	struct span_src_list list = { NULL };
+	size_t i;
+	int j;
+
+	memset(index, 0, sizeof(*index));
+	for (j = 0; j < rename_src_nr; j++) {
+		if (!src_ok[j])
+			continue;
+		list.src = j;
+		diffcore_for_each_span(rename_src[j].p->one,
+				       add_span_src, &list);
+	}
+	QSORT(list.v, list.nr, span_src_cmp);
+
+	ALLOC_ARRAY(index->hashval, list.nr);
+	ALLOC_ARRAY(index->start, list.nr + 1);
+	ALLOC_ARRAY(index->src, list.nr);
+	for (i = 0; i < list.nr; i++) {
+		if (!i || list.v[i].hashval != list.v[i - 1].hashval) {
+			index->hashval[index->nr] = list.v[i].hashval;
+			index->start[index->nr++] = i;
+		}
+		index->src[i] = list.v[i].src;
+	}
+	index->start[index->nr] = list.nr;
+	free(list.v);
+}
+
+static void clear_span_index(struct span_index *index)
+{
+	free(index->hashval);
+	free(index->start);
+	free(index->src);
+}
+
+static int span_index_lookup(const struct span_index *index,
+			     unsigned int hashval)
+{
+	size_t lo = 0, hi = index->nr;
+
+	while (lo < hi) {
+		size_t mi = lo + (hi - lo) / 2;
+		if (index->hashval[mi] == hashval)
+			return mi;
+		if (index->hashval[mi] < hashval)
+			lo = mi + 1;
+		else
+			hi = mi;
+	}
+	return -1;
+}
+
+struct span_candidates {
+	const struct span_index *index;
+	int *seen;		/* rename_src_nr entries, last row that saw it */
+	int row;
+	int *v;
+	int nr, alloc;
+	uint64_t common_bytes;
+	int similarity_checks;
+
+	/* the scores of this row that pass the minimum score */
+	struct diff_score *good;
+	int good_nr, good_alloc;
+};
+
+static void add_span_candidates(unsigned int hashval, unsigned int cnt,
+				void *data)
+{
+	struct span_candidates *c = data;
+	const struct span_index *index = c->index;
+	int pos = span_index_lookup(index, hashval);
+	size_t i;
+
+	if (pos < 0)
+		return;
+	if (index->start[pos + 1] - index->start[pos] > COMMON_SPAN_SOURCES) {
+		c->common_bytes += cnt;
+		return;
+	}
+	for (i = index->start[pos]; i < index->start[pos + 1]; i++) {
+		int src = index->src[i];
+		if (c->seen[src] == c->row)
+			continue;
+		c->seen[src] = c->row;
+		ALLOC_GROW(c->v, c->nr + 1, c->alloc);
+		c->v[c->nr++] = src;
+	}
+}
+
+static int int_cmp(const void *a_, const void *b_)
+{
+	const int *a = a_, *b = b_;
+
+	return *a - *b;
+}
+
+struct inexact_rename_workers {
+	struct repository *repo;
+	const struct span_index *index;	/* NULL to score every pair */
+	const int *src_ok;
+	int minimum_score;
+	int skip_unmodified;
+
+	/* row r of mx holds the best candidates for rename_dst[dst[r]] */
+	struct diff_score *mx;
+	const int *dst;
+	const int *dst_ok;
+	int dst_nr, next_dst;
+
+	struct progress *progress;
+	int similarity_checks;
+	pthread_mutex_t mutex;
+};
+
+static void score_rename_source(struct inexact_rename_workers *w,
+				struct span_candidates *c,
+				struct diff_score *m, int row, int src)
+{
+	struct diff_filespec *one = rename_src[src].p->one;
+	struct diff_filespec *two = rename_dst[w->dst[row]].two;
+	struct diff_score this_src;
+
+	if (w->src_ok[src] && w->dst_ok[row]) {
+		this_src.score = estimate_similarity(w->repo, one, two,
+						     w->minimum_score);
+		c->similarity_checks++;
+	} else
+		this_src.score = 0;
+	this_src.name_score = basename_same(one, two);
+	this_src.dst = w->dst[row];
+	this_src.src = src;
+	record_if_better(m, &this_src);
+
+	if (this_src.score >= w->minimum_score) {
+		ALLOC_GROW(c->good, c->good_nr + 1, c->good_alloc);
+		c->good[c->good_nr++] = this_src;
+	}
+}
+
+/*
+ * Do any of the scores that can make a rename tie, so that which one
+ * wins depends on the slots they were recorded in?
+ */
+static int has_tied_scores(struct span_candidates *c)
+{
+	int i;
+
+	QSORT(c->good, c->good_nr, score_compare);
+	for (i = 1; i < c->good_nr; i++)
+		if (!score_compare(&c->good[i - 1], &c->good[i]))
+			return 1;
+	return 0;
+}
+
+static void score_rename_candidates(struct inexact_rename_workers *w,
+				    struct span_candidates *c, int row)
+{
+	struct diff_filespec *two = rename_dst[w->dst[row]].two;
+	struct diff_score *m = &w->mx[row * NUM_CANDIDATE_PER_DST];
+	int i;
+
+	for (i = 0; i < NUM_CANDIDATE_PER_DST; i++)
+		m[i].dst = -1;
+
+	if (!w->dst_ok[row] || !two->size)
+		return;
+
+	if (w->index) {
+		c->row = row;
+		c->nr = 0;
+		c->good_nr = 0;
+		c->common_bytes = 0;
+		diffcore_for_each_span(two, add_span_candidates, c);
+
+		if (c->common_bytes * MAX_SCORE <
+		    (uint64_t)w->minimum_score * two->size) {
+			QSORT(c->v, c->nr, int_cmp);
+			for (i = 0; i < c->nr; i++)
+				score_rename_source(w, c, m, row, c->v[i]);
+			if (!has_tied_scores(c))
+				return;
+			for (i = 0; i < NUM_CANDIDATE_PER_DST; i++)
+				m[i].dst = -1;
+		}
+	}
+
+	for (i = 0; i < rename_src_nr; i++) {
+		if (w->skip_unmodified &&
+		    diff_unmodified_pair(rename_src[i].p))
+			continue;
+		score_rename_source(w, c, m, row, i);
+	}
+}
+
+static void *inexact_rename_worker(void *arg)
+{
+	struct inexact_rename_workers *w = arg;
+	struct span_candidates c = { w->index };
+	int i;
+
+	ALLOC_ARRAY(c.seen, rename_src_nr);
+	for (i = 0; i < rename_src_nr; i++)
+		c.seen[i] = -1;
+
+	for (;;) {
+		int row;
+
+		pthread_mutex_lock(&w->mutex);
+		if (w->next_dst >= w->dst_nr) {
+			pthread_mutex_unlock(&w->mutex);
+			break;
+		}
+		row = w->next_dst++;
+		display_progress(w->progress, row + 1);
+		pthread_mutex_unlock(&w->mutex);
+
+		score_rename_candidates(w, &c, row);
+	}
+
+	pthread_mutex_lock(&w->mutex);
+	w->similarity_checks += c.similarity_checks;
+	pthread_mutex_unlock(&w->mutex);
+
+	free(c.seen);
+	free(c.v);
+	free(c.good);
+	return NULL;
+}
+
+static void run_inexact_rename_workers(struct inexact_rename_workers *w,
+				       int nr_threads)
+{
+	pthread_t *threads;
+	int i;
+
+	if (!HAVE_THREADS)
+		nr_threads = 1;
+	else if (nr_threads <= 0)
+		nr_threads = online_cpus();
+	if (nr_threads > w->dst_nr / 16)
+		nr_threads = w->dst_nr / 16;
+
+	pthread_mutex_init(&w->mutex, NULL);
+
+	if (nr_threads <= 1) {
+		inexact_rename_worker(w);
+		pthread_mutex_destroy(&w->mutex);
+		return;
+	}
+
+	trace2_data_intmax("diff", w->repo, "rename/threads", nr_threads);
+
+	ALLOC_ARRAY(threads, nr_threads);
+	for (i = 0; i < nr_threads; i++) {
+		int err = pthread_create(&threads[i], NULL,
+					 inexact_rename_worker, w);
+		if (err)
+			die(_("unable to create thread: %s"), strerror(err));
+	}
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_join(threads[i], NULL))
+			die("unable to join thread");
+
+	pthread_mutex_destroy(&w->mutex);
+	free(threads);
+}
+
+/*
+ * Optional cache of inexact rename results, in $GIT_DIR/rename-cache.
+ *
+ * What diffcore_rename() finds beyond the exact renames depends only on
+ * the sources and destinations it was given (their paths, modes and
+ * object names, and which ones are already used or matched) and on the
+ * rename options. A hash of all of that names a file holding the pairs
+ * that were found, so walks that keep diffing the same commits, like
+ * "log --follow" or blame, only have to score them once. Inputs taken
+ * from the working tree have no object name yet and are never cached.
+ */
+static int rename_cache_key(struct diff_options *options, int minimum_score,
+			    int broken_pairs, struct object_id *key)
+{
+	git_hash_ctx ctx;
+	struct strbuf buf = STRBUF_INIT;
+	int i;
+
+	the_hash_algo->init_fn(&ctx);
+	strbuf_addf(&buf, "rename-cache v1 %d %d %d %d %d\n",
+		    options->detect_rename, minimum_score,
+		    options->rename_limit, options->flags.find_copies_harder,
+		    broken_pairs);
+	for (i = 0; i < rename_src_nr; i++) {
+		struct diff_filepair *p = rename_src[i].p;
+
+		if (!p->one->oid_valid)
+			goto uncacheable;
+		strbuf_addf(&buf, "src %06o %s %d %d %u %s%c",
+			    p->one->mode, oid_to_hex(&p->one->oid),
+			    p->one->rename_used, diff_unmodified_pair(p),
+			    rename_src[i].score, p->one->path, '\0');
+	}
+	for (i = 0; i < rename_dst_nr; i++) {
+		struct diff_filespec *two = rename_dst[i].two;
+
+		if (!two->oid_valid)
+			goto uncacheable;
+		strbuf_addf(&buf, "dst %06o %s %d %s%c",
+			    two->mode, oid_to_hex(&two->oid),
+			    !!rename_dst[i].pair, two->path, '\0');
+	}
+	the_hash_algo->update_fn(&ctx, buf.buf, buf.len);
+	the_hash_algo->final_fn(key->hash, &ctx);
+	strbuf_release(&buf);
+	return 0;
+
+uncacheable:
+	strbuf_release(&buf);
+	return -1;
+}
+
+static char *rename_cache_path(struct repository *r, const struct object_id *key)
+{
+	const char *hex = oid_to_hex(key);
+
+	return repo_git_path(r, "rename-cache/%.2s/%s", hex, hex + 2);
+}
+
+/*
+ * Scoring fewer pairs than this is about as cheap as reading the
+ * result back, so such results are neither looked up nor stored.
+ */
+#define RENAME_CACHE_MIN_PAIRS 1000
+
+static uint64_t rename_cache_min_pairs(void)
+{
+	return git_env_ulong("GIT_TEST_RENAME_CACHE_MIN_PAIRS",
+			     RENAME_CACHE_MIN_PAIRS);
+}
+
+/*
+ * The cache keeps at most this many entries in each of its 256
+ * subdirectories. Entries are touched whenever they are used, and the
+ * least recently used ones make room for new ones.
+ */
+#define RENAME_CACHE_DIR_ENTRIES 64
+
+struct rename_cache_entry {
+	char *name;
+	timestamp_t mtime;
+};
+
+static int rename_cache_entry_cmp(const void *a_, const void *b_)
+{
+	const struct rename_cache_entry *a = a_, *b = b_;
+
+	if (a->mtime != b->mtime)
+		return a->mtime < b->mtime ? -1 : 1;
+	return strcmp(a->name, b->name);
+}
+
+/*
+ * Remove the entries in the cache directory `path` that were last used
+ * at or before `expire`, and then the least recently used ones beyond
+ * `keep`, stale lock files included.
+ */
+static void prune_rename_cache_dir(struct strbuf *path, timestamp_t expire,
+				   size_t keep)
+{
+	struct rename_cache_entry *entries = NULL;
+	size_t nr = 0, alloc = 0, i, baselen;
+	struct dirent *de;
+	DIR *dir = opendir(path->buf);
+
+	if (!dir)
+		return;
+	strbuf_addch(path, '/');
+	baselen = path->len;
+	while ((de = readdir(dir)) != NULL) {
+		struct stat st;
+
+		if (is_dot_or_dotdot(de->d_name))
+			continue;
+		strbuf_setlen(path, baselen);
+		strbuf_addstr(path, de->d_name);
+		if (lstat(path->buf, &st) || !S_ISREG(st.st_mode))
+			continue;
+		if (st.st_mtime <= expire) {
+			unlink(path->buf);
+			continue;
+		}
+		ALLOC_GROW(entries, nr + 1, alloc);
+		entries[nr].name = xstrdup(de->d_name);
+		entries[nr].mtime = st.st_mtime;
+		nr++;
+	}
+	closedir(dir);
+
+	if (nr > keep)
+		QSORT(entries, nr, rename_cache_entry_cmp);
+	for (i = 0; i < nr; i++) {
+		if (i + keep < nr) {
+			strbuf_setlen(path, baselen);
+			strbuf_addstr(path, entries[i].name);
+			unlink(path->buf);
+		}
+		free(entries[i].name);
+	}
+	free(entries);
+
+	strbuf_setlen(path, baselen - 1);
+	rmdir(path->buf); /* only succeeds if nothing is left */
+}
+
+void prune_rename_cache(struct repository *r, timestamp_t expire)
+{
+	struct strbuf path = STRBUF_INIT;
+	struct dirent *de;
+	size_t baselen;
+	DIR *dir;
+
+	strbuf_repo_git_path(&path, r, "rename-cache");
+	dir = opendir(path.buf);
+	if (!dir) {
+		strbuf_release(&path);
+		return;
+	}
+	strbuf_addch(&path, '/');
+	baselen = path.len;
+	while ((de = readdir(dir)) != NULL) {
+		if (strlen(de->d_name) != 2 ||
+		    !isxdigit(de->d_name[0]) || !isxdigit(de->d_name[1]))
+			continue;
+		strbuf_setlen(&path, baselen);
+		strbuf_addstr(&path, de->d_name);
+		prune_rename_cache_dir(&path, expire, RENAME_CACHE_DIR_ENTRIES);
+	}
+	closedir(dir);
+	strbuf_setlen(&path, baselen - 1);
+	rmdir(path.buf);
+	strbuf_release(&path);
+}
+
+/*
+ * The file holds a line with the needed_rename_limit and
+ * degraded_cc_to_c results of the rename limit check (or "-" when the
+ * limit was not checked), followed by one "<dst> <src> <score>" line
+ * for each pair found.
+ */
+static int rename_cache_read(struct diff_options *options,
+			     const struct object_id *key, int *renames)
+{
+	char *path = rename_cache_path(options->repo, key);
+	struct strbuf buf = STRBUF_INIT;
+	struct diff_score *pairs = NULL;
+	size_t pairs_nr = 0, pairs_alloc = 0, i;
+	int needed = -1, degraded = 0, ret = -1;
+	const char *p;
+	char *end;
+
+	if (strbuf_read_file(&buf, path, 0) < 0)
+		goto out;
+
+	p = buf.buf;
+	if (*p == '-') {
+		p++;
+	} else {
+		needed = strtol(p, &end, 10);
+		if (end == p || *end != ' ')
+			goto out;
+		degraded = strtol(end + 1, &end, 10);
+		p = end;
+	}
+	if (*p++ != '\n')
+		goto out;
+
+	while (*p) {
+		struct diff_score pair;
+
+		pair.dst = strtol(p, &end, 10);
+		if (end == p || *end != ' ')
+			goto out;
+		p = end + 1;
+		pair.src = strtol(p, &end, 10);
+		if (end == p || *end != ' ')
+			goto out;
+		p = end + 1;
+		pair.score = strtol(p, &end, 10);
+		if (end == p || *end != '\n')
+			goto out;
+		p = end + 1;
+
+		/* written in increasing order of destination */
+		if (pair.dst < 0 || pair.dst >= rename_dst_nr ||
+		    (pairs_nr && pair.dst <= pairs[pairs_nr - 1].dst) ||
+		    rename_dst[pair.dst].pair ||
+		    pair.src < 0 || pair.src >= rename_src_nr)
+			goto out;
+		ALLOC_GROW(pairs, pairs_nr + 1, pairs_alloc);
+		pairs[pairs_nr++] = pair;
+	}
+
+	if (needed >= 0) {
+		options->needed_rename_limit = needed;
+		if (degraded)
+			options->degraded_cc_to_c = 1;
+	}
+	for (i = 0; i < pairs_nr; i++)
+		record_rename_pair(pairs[i].dst, pairs[i].src, pairs[i].score);
+	*renames = pairs_nr;
+	ret = 0;
+
+	/* mark the entry as recently used */
+	utime(path, NULL);
+
+out:
+	free(pairs);
+	strbuf_release(&buf);
+	free(path);
+	return ret;
+}
+
+static int find_rename_src(struct diff_filespec *one)
+{
+	int first = 0, last = rename_src_nr;
+
+	while (last > first) {
+		int next = first + ((last - first) >> 1);
+		int cmp = strcmp(one->path, rename_src[next].p->one->path);
+		if (!cmp)
+			return next;
+		if (cmp < 0)
+			last = next;
+		else
+			first = next + 1;
+	}
+	return -1;
+}
+
+/*
+ * Record the pairs for destinations that were not matched yet when the
+ * key was computed. Failing to write the cache is not an error.
+ */
+static void rename_cache_write(struct diff_options *options,
+			       const struct object_id *key,
+			       const char *was_paired, int checked_limit)
+{
+	char *path = rename_cache_path(options->repo, key);
+	struct lock_file lock = LOCK_INIT;
+	struct strbuf buf = STRBUF_INIT;
+	char *slash;
+	int i, fd;
+
+	if (checked_limit)
+		strbuf_addf(&buf, "%d %d\n", options->needed_rename_limit,
+			    options->degraded_cc_to_c);
+	else
+		strbuf_addstr(&buf, "-\n");
+	for (i = 0; i < rename_dst_nr; i++) {
+		struct diff_filepair *dp = rename_dst[i].pair;
+		int src;
+
+		if (!dp || was_paired[i])
+			continue;
+		src = find_rename_src(dp->one);
+		if (src < 0)
+			goto out;
+		strbuf_addf(&buf, "%d %d %d\n", i, src, dp->score);
+	}
+
+	if (safe_create_leading_directories(path))
+		goto out;
+	fd = hold_lock_file_for_update(&lock, path, 0);
+	if (fd < 0)
+		goto out;
+	if (write_in_full(fd, buf.buf, buf.len) < 0) {
+		rollback_lock_file(&lock);
+		goto out;
+	}
+	if (commit_lock_file(&lock))
+		goto out;
+
+	/* make room in the directory of the new entry */
+	slash = strrchr(path, '/');
+	strbuf_reset(&buf);
+	strbuf_add(&buf, path, slash - path);
+	prune_rename_cache_dir(&buf, 0, RENAME_CACHE_DIR_ENTRIES);
+
+out:
+	strbuf_release(&buf);
+	free(path);
+}
+
 void diffcore_rename(struct diff_options *options)
 {
 	int detect_rename = options->detect_rename;
@@ -504,9 +1319,20 @@ void diffcore_rename(struct diff_options *options)
 	struct diff_queue_struct *q = &diff_queued_diff;
 	struct diff_queue_struct outq;
 	struct diff_score *mx;
-	int i, j, rename_count, skip_unmodified = 0;
-	int num_create, dst_cnt;
+	int i, rename_count, skip_unmodified = 0, broken_pairs = 0;
+	int num_create, dst_cnt, basename_count;
+	int similarity_checks = 0, checked_limit = 0;
+	struct object_id cache_key;
+	char *was_paired = NULL;
 	struct progress *progress = NULL;
+	struct repository *r = options->repo;
+	struct diff_populate_filespec_options dpf_options = { 0 };
+	struct prefetch_options prefetch_options = { r };
+	struct span_index index;
+	struct inexact_rename_workers workers;
+	int *src_ok, *dsts, *dst_ok, use_index;
+	unsigned long *src_sizes, *dst_sizes;
+	int src_sizes_nr, dst_sizes_nr;
 
 	if (!minimum_score)
 		minimum_score = DEFAULT_RENAME_SCORE;
@@ -542,6 +1368,8 @@ void diffcore_rename(struct diff_options *options)
 			 */
 			if (p->broken_pair && !p->score)
 				p->one->rename_used++;
+			if (p->broken_pair)
+				broken_pairs = 1;
 			register_rename_src(p);
 		}
 		else if (detect_rename == DIFF_DETECT_COPY) {
@@ -566,6 +1394,42 @@ void diffcore_rename(struct diff_options *options)
 	if (minimum_score == MAX_SCORE)
 		goto cleanup;
 
+	if (options->rename_cache && rename_count < rename_dst_nr &&
+	    (uint64_t)(rename_dst_nr - rename_count) * rename_src_nr >=
+	    rename_cache_min_pairs() &&
+	    !rename_cache_key(options, minimum_score, broken_pairs,
+			      &cache_key)) {
+		int cached;
+
+		if (!rename_cache_read(options, &cache_key, &cached)) {
+			trace2_data_intmax("diff", r, "rename/cache-hit", 1);
+			rename_count += cached;
+			goto cleanup;
+		}
+		CALLOC_ARRAY(was_paired, rename_dst_nr);
+		for (i = 0; i < rename_dst_nr; i++)
+			was_paired[i] = !!rename_dst[i].pair;
+	}
+
+	if (r == the_repository && has_promisor_remote()) {
+		dpf_options.missing_object_cb = prefetch;
+		dpf_options.missing_object_data = &prefetch_options;
+	}
+
+	/*
+	 * Pairing files up by their basename is only a shortcut for
+	 * renames; copies and broken pairs want every source considered.
+	 */
+	if (detect_rename != DIFF_DETECT_COPY && !broken_pairs &&
+	    rename_count < rename_dst_nr) {
+		basename_count = find_basename_matches(options, minimum_score,
+						       &dpf_options,
+						       &similarity_checks);
+		trace2_data_intmax("diff", r, "rename/basename-renames",
+				   basename_count);
+		rename_count += basename_count;
+	}
+
 	/*
 	 * Calculate how many renames are left (but all the source
 	 * files still remain as options for rename/copies!)
@@ -574,11 +1438,12 @@ void diffcore_rename(struct diff_options *options)
 
 	/* All done? */
 	if (!num_create)
-		goto cleanup;
+		goto report;
 
+	checked_limit = 1;
 	switch (too_many_rename_candidates(num_create, options)) {
 	case 1:
-		goto cleanup;
+		goto report;
 	case 2:
 		options->degraded_cc_to_c = 1;
 		skip_unmodified = 1;
@@ -587,52 +1452,94 @@ void diffcore_rename(struct diff_options *options)
 		break;
 	}
 
-	if (options->show_rename_progress) {
-		progress = start_delayed_progress(
-				_("Performing inexact rename detection"),
-				(uint64_t)rename_dst_nr * (uint64_t)rename_src_nr);
-	}
+	prefetch_options.skip_unmodified = skip_unmodified;
 
-	mx = xcalloc(st_mult(NUM_CANDIDATE_PER_DST, num_create), sizeof(*mx));
-	for (dst_cnt = i = 0; i < rename_dst_nr; i++) {
+	/*
+	 * Read every candidate that has a counterpart of a similar
+	 * enough size once up front; from here on the pairs are scored
+	 * from their span hashes alone.
+	 */
+	CALLOC_ARRAY(src_ok, rename_src_nr);
+	ALLOC_ARRAY(src_sizes, rename_src_nr);
+	for (src_sizes_nr = i = 0; i < rename_src_nr; i++) {
+		struct diff_filespec *one = rename_src[i].p->one;
+
+		if (skip_unmodified && diff_unmodified_pair(rename_src[i].p))
+			continue;
+		if (prepare_similarity_size(r, one, &dpf_options))
+			continue;
+		src_ok[i] = 1;
+		src_sizes[src_sizes_nr++] = one->size;
+	}
+	ALLOC_ARRAY(dsts, num_create);
+	CALLOC_ARRAY(dst_ok, num_create);
+	ALLOC_ARRAY(dst_sizes, num_create);
+	for (dst_cnt = dst_sizes_nr = i = 0; i < rename_dst_nr; i++) {
 		struct diff_filespec *two = rename_dst[i].two;
-		struct diff_score *m;
 
 		if (rename_dst[i].pair)
 			continue; /* dealt with exact match already. */
+		if (!prepare_similarity_size(r, two, &dpf_options)) {
+			dst_ok[dst_cnt] = 1;
+			dst_sizes[dst_sizes_nr++] = two->size;
+		}
+		dsts[dst_cnt++] = i;
+	}
+	QSORT(src_sizes, src_sizes_nr, ulong_cmp);
+	QSORT(dst_sizes, dst_sizes_nr, ulong_cmp);
+	use_index = (uint64_t)dst_cnt * rename_src_nr >=
+		    indexed_rename_min_pairs();
 
-		m = &mx[dst_cnt * NUM_CANDIDATE_PER_DST];
-		for (j = 0; j < NUM_CANDIDATE_PER_DST; j++)
-			m[j].dst = -1;
+	for (i = 0; i < rename_src_nr; i++) {
+		struct diff_filespec *one = rename_src[i].p->one;
 
-		for (j = 0; j < rename_src_nr; j++) {
-			struct diff_filespec *one = rename_src[j].p->one;
-			struct diff_score this_src;
+		if (src_ok[i])
+			src_ok[i] = has_size_match(dst_sizes, dst_sizes_nr,
+						   one->size, minimum_score) &&
+				    !prepare_similarity(r, one, &dpf_options);
+	}
+	for (i = 0; i < dst_cnt; i++) {
+		struct diff_filespec *two = rename_dst[dsts[i]].two;
 
-			if (skip_unmodified &&
-			    diff_unmodified_pair(rename_src[j].p))
-				continue;
+		if (dst_ok[i])
+			dst_ok[i] = has_size_match(src_sizes, src_sizes_nr,
+						   two->size, minimum_score) &&
+				    !prepare_similarity(r, two, &dpf_options);
+	}
+	free(src_sizes);
+	free(dst_sizes);
 
-			this_src.score = estimate_similarity(options->repo,
-							     one, two,
-							     minimum_score,
-							     skip_unmodified);
-			this_src.name_score = basename_same(one, two);
-			this_src.dst = i;
-			this_src.src = j;
-			record_if_better(m, &this_src);
-			/*
-			 * Once we run estimate_similarity,
-			 * We do not need the text anymore.
-			 */
-			diff_free_filespec_blob(one);
-			diff_free_filespec_blob(two);
-		}
-		dst_cnt++;
-		display_progress(progress, (uint64_t)(i+1)*(uint64_t)rename_src_nr);
+	if (use_index)
+		build_span_index(&index, src_ok);
+
+	if (options->show_rename_progress) {
+		progress = start_delayed_progress(
+				_("Performing inexact rename detection"),
+				dst_cnt);
 	}
+
+	mx = xcalloc(st_mult(NUM_CANDIDATE_PER_DST, num_create), sizeof(*mx));
+	memset(&workers, 0, sizeof(workers));
+	workers.repo = r;
+	if (use_index)
+		workers.index = &index;
+	workers.src_ok = src_ok;
+	workers.skip_unmodified = skip_unmodified;
+	workers.minimum_score = minimum_score;
+	workers.mx = mx;
+	workers.dst = dsts;
+	workers.dst_ok = dst_ok;
+	workers.dst_nr = dst_cnt;
+	workers.progress = progress;
+	run_inexact_rename_workers(&workers, options->rename_threads);
 	stop_progress(&progress);
 
+	if (use_index)
+		clear_span_index(&index);
+	free(src_ok);
+	free(dst_ok);
+	free(dsts);
+
 	/* cost matrix sorted by most to least similar pair */
 	STABLE_QSORT(mx, dst_cnt * NUM_CANDIDATE_PER_DST, score_compare);
 
@@ -640,6 +1547,17 @@ void diffcore_rename(struct diff_options *options)
 	if (detect_rename == DIFF_DETECT_COPY)
 		rename_count += find_renames(mx, dst_cnt, minimum_score, 1);
 	free(mx);
+	similarity_checks += workers.similarity_checks;
+
+ report:
+	trace2_data_intmax("diff", r, "rename/similarity-checks",
+			   similarity_checks);
+	if (was_paired) {
+		if ((uint64_t)similarity_checks >= rename_cache_min_pairs())
+			rename_cache_write(options, &cache_key, was_paired,
+					   checked_limit);
+		free(was_paired);
+	}
 
  cleanup:
 	/* At this point, we have found some renames and copies and they
@@ -190,6 +190,21 @@ void diff_debug_queue(const char *, struct diff_queue_struct *);
 #define diff_debug_queue(a,b) do { /* nothing */ } while (0)
 #endif
 
+/*
+ * Compute the span hash counts diffcore_count_changes() works with for
+ * "one", whose contents must already be populated, and keep them in
+ * one->cnt_data.
+ */
+void diffcore_prepare_count(struct repository *r, struct diff_filespec *one);
+
+/*
+ * Call fn() for each span hash in the counts prepared for "one", in
+ * increasing order of hash value, with the number of bytes hashed to it.
+ */
+typedef void (*each_span_fn)(unsigned int hashval, unsigned int cnt, void *data);
+void diffcore_for_each_span(struct diff_filespec *one,
+			    each_span_fn fn, void *data);
+
 int diffcore_count_changes(struct repository *r,
 			   struct diff_filespec *src,
 			   struct diff_filespec *dst,
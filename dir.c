@@ -18,6 +18,7 @@
 #include "ewah/ewok.h"
 #include "fsmonitor.h"
 #include "submodule-config.h"
+#include "thread-utils.h"
 
 /*
  * Tells read_directory_recursive how a file or directory should be treated.
@@ -913,6 +914,8 @@ static int read_skip_worktree_file_from_index(const struct index_state *istate,
  * Frees memory within pl which was allocated for exclude patterns and
  * the file buffer.  Does not free pl itself.
  */
+static void free_pattern_matcher(struct pattern_matcher *m);
+
 void clear_pattern_list(struct pattern_list *pl)
 {
 	int i;
@@ -923,6 +926,7 @@ void clear_pattern_list(struct pattern_list *pl)
 	free(pl->filebuf);
 	hashmap_free_entries(&pl->recursive_hashmap, struct pattern_entry, ent);
 	hashmap_free_entries(&pl->parent_hashmap, struct pattern_entry, ent);
+	free_pattern_matcher(pl->matcher);
 
 	memset(pl, 0, sizeof(*pl));
 }
@@ -1287,6 +1291,310 @@ int match_pathname(const char *pathname, int pathlen,
 				 WM_PATHNAME) == 0;
 }
 
+static int path_pattern_matches(struct path_pattern *pattern,
+				 const char *pathname, int pathlen,
+				 const char *basename, int *dtype,
+				 struct index_state *istate)
+{
+	const char *exclude = pattern->pattern;
+	int prefix = pattern->nowildcardlen;
+
+	if (pattern->flags & PATTERN_FLAG_MUSTBEDIR) {
+		*dtype = resolve_dtype(*dtype, istate, pathname, pathlen);
+		if (*dtype != DT_DIR)
+			return 0;
+	}
+
+	if (pattern->flags & PATTERN_FLAG_NODIR)
+		return match_basename(basename,
+				      pathlen - (basename - pathname),
+				      exclude, prefix, pattern->patternlen,
+				      pattern->flags);
+
+	assert(pattern->baselen == 0 ||
+	       pattern->base[pattern->baselen - 1] == '/');
+	return match_pathname(pathname, pathlen,
+			      pattern->base,
+			      pattern->baselen ? pattern->baselen - 1 : 0,
+			      exclude, prefix, pattern->patternlen,
+			      pattern->flags);
+}
+
+/*
+ * A long pattern list is split up so that a path is only tried against
+ * the patterns that can possibly match it:
+ *
+ *  - literal basenames ("foo", "!foo/") are looked up by the basename,
+ *  - "*suffix" basename patterns by the tail of the basename, one
+ *    lookup per suffix length in use,
+ *  - patterns with a directory part whose first component is literal
+ *    ("/build/", "doc/index.html") by the first component of the path
+ *    below the list's base.
+ *
+ * The remaining patterns are tried in order as before. Each bucket
+ * keeps the pattern indices in increasing order; the answer is the
+ * matching pattern with the highest index, so the last one still wins.
+ */
+#define PATTERN_MATCHER_MIN 8
+
+struct pattern_bucket {
+	struct hashmap_entry ent;
+	const char *key;
+	int keylen;
+	int *idx;
+	int nr, alloc;
+};
+
+struct pattern_matcher {
+	/* the number of patterns in the list when this was built */
+	int nr;
+	int icase;
+	struct hashmap basenames;
+	struct hashmap suffixes;
+	int *suffix_len;
+	int suffix_len_nr, suffix_len_alloc;
+	struct hashmap components;
+	const char *base;
+	int baselen;
+	int *other;
+	int other_nr, other_alloc;
+};
+
+static int pattern_bucket_cmp(const void *cmp_data,
+			      const struct hashmap_entry *eptr,
+			      const struct hashmap_entry *entry_or_key,
+			      const void *keydata)
+{
+	const int *icase = cmp_data;
+	const struct pattern_bucket *a, *b;
+
+	a = container_of(eptr, const struct pattern_bucket, ent);
+	b = container_of(entry_or_key, const struct pattern_bucket, ent);
+	if (a->keylen != b->keylen)
+		return 1;
+	return *icase ? strncasecmp(a->key, b->key, a->keylen) :
+			memcmp(a->key, b->key, a->keylen);
+}
+
+static struct pattern_bucket *get_pattern_bucket(struct hashmap *map,
+						 int icase,
+						 const char *key, int keylen)
+{
+	struct pattern_bucket k;
+
+	hashmap_entry_init(&k.ent, icase ? memihash(key, keylen) :
+					   memhash(key, keylen));
+	k.key = key;
+	k.keylen = keylen;
+	return hashmap_get_entry(map, &k, ent, NULL);
+}
+
+static void add_to_pattern_bucket(struct hashmap *map, int icase,
+				  const char *key, int keylen, int idx)
+{
+	struct pattern_bucket *b = get_pattern_bucket(map, icase, key, keylen);
+
+	if (!b) {
+		CALLOC_ARRAY(b, 1);
+		hashmap_entry_init(&b->ent, icase ? memihash(key, keylen) :
+						    memhash(key, keylen));
+		b->key = key;
+		b->keylen = keylen;
+		hashmap_add(map, &b->ent);
+	}
+	ALLOC_GROW(b->idx, b->nr + 1, b->alloc);
+	b->idx[b->nr++] = idx;
+}
+
+static void free_pattern_buckets(struct hashmap *map)
+{
+	struct hashmap_iter iter;
+	struct pattern_bucket *b;
+
+	hashmap_for_each_entry(map, &iter, b, ent)
+		free(b->idx);
+	hashmap_free_entries(map, struct pattern_bucket, ent);
+}
+
+static void free_pattern_matcher(struct pattern_matcher *m)
+{
+	if (!m)
+		return;
+	free_pattern_buckets(&m->basenames);
+	free_pattern_buckets(&m->suffixes);
+	free_pattern_buckets(&m->components);
+	free(m->suffix_len);
+	free(m->other);
+	free(m);
+}
+
+/*
+ * Return the length of the literal first path component of a pattern
+ * with a directory part, or 0 if it does not start with one.
+ */
+static int literal_first_component(const struct path_pattern *pattern,
+				   const char **start)
+{
+	const char *p = pattern->pattern;
+	int len = pattern->patternlen;
+	int prefix = pattern->nowildcardlen;
+	int i;
+
+	if (*p == '/') {
+		p++;
+		len--;
+		prefix--;
+	}
+	*start = p;
+	for (i = 0; i < prefix; i++)
+		if (p[i] == '/')
+			return i;
+	return prefix == len ? len : 0;
+}
+
+static void build_pattern_matcher(struct pattern_list *pl)
+{
+	struct pattern_matcher *m;
+	int i, j;
+
+	free_pattern_matcher(pl->matcher);
+	CALLOC_ARRAY(m, 1);
+	m->nr = pl->nr;
+	m->icase = ignore_case;
+	hashmap_init(&m->basenames, pattern_bucket_cmp, &m->icase, 0);
+	hashmap_init(&m->suffixes, pattern_bucket_cmp, &m->icase, 0);
+	hashmap_init(&m->components, pattern_bucket_cmp, &m->icase, 0);
+	m->baselen = -1;
+
+	for (i = 0; i < pl->nr; i++) {
+		struct path_pattern *pattern = pl->patterns[i];
+		const char *key;
+		int keylen;
+
+		if (pattern->flags & PATTERN_FLAG_NODIR) {
+			if (pattern->nowildcardlen == pattern->patternlen) {
+				add_to_pattern_bucket(&m->basenames, m->icase,
+						      pattern->pattern,
+						      pattern->patternlen, i);
+				continue;
+			}
+			if (pattern->flags & PATTERN_FLAG_ENDSWITH) {
+				keylen = pattern->patternlen - 1;
+				add_to_pattern_bucket(&m->suffixes, m->icase,
+						      pattern->pattern + 1,
+						      keylen, i);
+				for (j = 0; j < m->suffix_len_nr; j++)
+					if (m->suffix_len[j] == keylen)
+						break;
+				if (j == m->suffix_len_nr) {
+					ALLOC_GROW(m->suffix_len,
+						   m->suffix_len_nr + 1,
+						   m->suffix_len_alloc);
+					m->suffix_len[m->suffix_len_nr++] = keylen;
+				}
+				continue;
+			}
+		} else if ((keylen = literal_first_component(pattern, &key))) {
+			if (m->baselen < 0) {
+				m->base = pattern->base;
+				m->baselen = pattern->baselen;
+			}
+			if (m->baselen == pattern->baselen &&
+			    !memcmp(m->base, pattern->base, m->baselen)) {
+				add_to_pattern_bucket(&m->components, m->icase,
+						      key, keylen, i);
+				continue;
+			}
+		}
+
+		ALLOC_GROW(m->other, m->other_nr + 1, m->other_alloc);
+		m->other[m->other_nr++] = i;
+	}
+	pl->matcher = m;
+}
+
+static void prepare_pattern_matcher(struct pattern_list *pl)
+{
+	if (pl->nr < PATTERN_MATCHER_MIN)
+		return;
+	if (!pl->matcher || pl->matcher->nr != pl->nr ||
+	    pl->matcher->icase != ignore_case)
+		build_pattern_matcher(pl);
+}
+
+/*
+ * Return the highest index in the bucket that is above 'best' and whose
+ * pattern matches, or 'best' if there is none.
+ */
+static int best_match_in_bucket(const struct pattern_bucket *b, int best,
+				struct pattern_list *pl,
+				const char *pathname, int pathlen,
+				const char *basename, int *dtype,
+				struct index_state *istate)
+{
+	int i;
+
+	if (!b)
+		return best;
+	for (i = b->nr - 1; 0 <= i && best < b->idx[i]; i--)
+		if (path_pattern_matches(pl->patterns[b->idx[i]],
+					 pathname, pathlen, basename,
+					 dtype, istate))
+			return b->idx[i];
+	return best;
+}
+
+static struct path_pattern *last_matching_pattern_compiled(const char *pathname,
+							   int pathlen,
+							   const char *basename,
+							   int *dtype,
+							   struct pattern_list *pl,
+							   struct index_state *istate)
+{
+	struct pattern_matcher *m = pl->matcher;
+	int basenamelen = pathlen - (basename - pathname);
+	int best = -1;
+	int i;
+
+	best = best_match_in_bucket(get_pattern_bucket(&m->basenames, m->icase,
+						       basename, basenamelen),
+				    best, pl, pathname, pathlen, basename,
+				    dtype, istate);
+
+	for (i = 0; i < m->suffix_len_nr; i++) {
+		int len = m->suffix_len[i];
+
+		if (basenamelen < len)
+			continue;
+		best = best_match_in_bucket(
+			get_pattern_bucket(&m->suffixes, m->icase,
+					   basename + basenamelen - len, len),
+			best, pl, pathname, pathlen, basename, dtype, istate);
+	}
+
+	if (0 <= m->baselen && m->baselen <= pathlen &&
+	    !fspathncmp(pathname, m->base, m->baselen)) {
+		const char *name = pathname + m->baselen;
+		const char *slash = memchr(name, '/', pathlen - m->baselen);
+		int len = slash ? slash - name : pathlen - m->baselen;
+
+		best = best_match_in_bucket(
+			get_pattern_bucket(&m->components, m->icase, name, len),
+			best, pl, pathname, pathlen, basename, dtype, istate);
+	}
+
+	for (i = m->other_nr - 1; 0 <= i && best < m->other[i]; i--) {
+		if (path_pattern_matches(pl->patterns[m->other[i]],
+					 pathname, pathlen, basename,
+					 dtype, istate)) {
+			best = m->other[i];
+			break;
+		}
+	}
+
+	return best < 0 ? NULL : pl->patterns[best];
+}
+
 /*
  * Scan the given exclude list in reverse to see whether pathname
  * should be ignored.  The first match (i.e. the last on the list), if
@@ -1300,46 +1608,25 @@ static struct path_pattern *last_matching_pattern_from_list(const char *pathname
 						       struct pattern_list *pl,
 						       struct index_state *istate)
 {
-	struct path_pattern *res = NULL; /* undecided */
 	int i;
 
 	if (!pl->nr)
 		return NULL;	/* undefined */
 
+	prepare_pattern_matcher(pl);
+	if (pl->matcher && pl->matcher->nr == pl->nr)
+		return last_matching_pattern_compiled(pathname, pathlen,
+						      basename, dtype, pl,
+						      istate);
+
 	for (i = pl->nr - 1; 0 <= i; i--) {
 		struct path_pattern *pattern = pl->patterns[i];
-		const char *exclude = pattern->pattern;
-		int prefix = pattern->nowildcardlen;
 
-		if (pattern->flags & PATTERN_FLAG_MUSTBEDIR) {
-			*dtype = resolve_dtype(*dtype, istate, pathname, pathlen);
-			if (*dtype != DT_DIR)
-				continue;
-		}
-
-		if (pattern->flags & PATTERN_FLAG_NODIR) {
-			if (match_basename(basename,
-					   pathlen - (basename - pathname),
-					   exclude, prefix, pattern->patternlen,
-					   pattern->flags)) {
-				res = pattern;
-				break;
-			}
-			continue;
-		}
-
-		assert(pattern->baselen == 0 ||
-		       pattern->base[pattern->baselen - 1] == '/');
-		if (match_pathname(pathname, pathlen,
-				   pattern->base,
-				   pattern->baselen ? pattern->baselen - 1 : 0,
-				   exclude, prefix, pattern->patternlen,
-				   pattern->flags)) {
-			res = pattern;
-			break;
-		}
+		if (path_pattern_matches(pattern, pathname, pathlen,
+					 basename, dtype, istate))
+			return pattern;
 	}
-	return res;
+	return NULL;
 }
 
 /*
@@ -1796,7 +2083,10 @@ static enum path_treatment treat_directory(struct dir_struct *dir,
 		!(dir->flags & DIR_NO_GITLINKS)) {
 		struct strbuf sb = STRBUF_INIT;
 		strbuf_addstr(&sb, dirname);
+		/* read_gitfile() is not thread-safe, see read_directory_parallel() */
+		obj_read_lock();
 		nested_repo = is_nonbare_repository_dir(&sb);
+		obj_read_unlock();
 		strbuf_release(&sb);
 	}
 	if (nested_repo) {
@@ -2754,10 +3044,250 @@ static struct untracked_cache_dir *validate_untracked_cache(struct dir_struct *d
 	return root;
 }
 
+/*
+ * Without the untracked cache, the walk over a large working tree can be
+ * split over several threads. The top of the tree is read on the main
+ * thread, breadth first, until there are enough directories left to
+ * recurse into; each of those subtrees is then walked by one worker with
+ * a private copy of the dir_struct. Only the per-directory exclude lists
+ * differ between the copies, the command line and exclude file patterns
+ * are shared read-only. The entries collected by the workers are added
+ * to the main dir_struct, whose lists read_directory() sorts anyway, so
+ * the result does not depend on how the work was split.
+ */
+#define DIR_SCAN_THREAD_COST 500
+#define DIR_SCAN_MAX_THREADS 32
+#define DIR_SCAN_JOBS_PER_THREAD 4
+
+struct dir_scan_jobs {
+	struct index_state *istate;
+	const struct pathspec *pathspec;
+	struct string_list *subdirs;
+	int next;
+	pthread_mutex_t mutex;
+};
+
+struct dir_scan_worker {
+	pthread_t thread;
+	struct dir_struct dir;
+	struct dir_scan_jobs *jobs;
+};
+
+static int dir_scan_threads(struct index_state *istate,
+			    const struct pathspec *pathspec)
+{
+	int nr_threads;
+
+	if (!HAVE_THREADS)
+		return 1;
+	/* attribute lookups for pathspec magic are not thread-safe */
+	if (pathspec && (pathspec->magic & PATHSPEC_ATTR))
+		return 1;
+
+	prepare_repo_settings(the_repository);
+	nr_threads = the_repository->settings.core_untracked_scan_threads;
+	if (nr_threads <= 0) {
+		nr_threads = istate->cache_nr / DIR_SCAN_THREAD_COST;
+		if (nr_threads > online_cpus())
+			nr_threads = online_cpus();
+	}
+	if (nr_threads > DIR_SCAN_MAX_THREADS)
+		nr_threads = DIR_SCAN_MAX_THREADS;
+	return nr_threads;
+}
+
+/*
+ * Read one directory like read_directory_recursive() does, but instead
+ * of recursing append the subdirectories to 'subdirs'.
+ */
+static void read_directory_level(struct dir_struct *dir,
+				 struct index_state *istate,
+				 const char *base, int baselen,
+				 const struct pathspec *pathspec,
+				 struct string_list *subdirs)
+{
+	struct cached_dir cdir;
+	enum path_treatment state;
+	struct strbuf path = STRBUF_INIT;
+
+	strbuf_add(&path, base, baselen);
+
+	if (open_cached_dir(&cdir, dir, NULL, istate, &path, 0))
+		goto out;
+
+	while (!read_cached_dir(&cdir)) {
+		state = treat_path(dir, NULL, &cdir, istate, &path,
+				   baselen, pathspec);
+		if (state == path_recurse) {
+			string_list_append(subdirs, path.buf);
+			continue;
+		}
+		add_path_to_appropriate_result_list(dir, NULL, &cdir,
+						    istate, &path, baselen,
+						    pathspec, state);
+	}
+	close_cached_dir(&cdir);
+ out:
+	strbuf_release(&path);
+}
+
+static void *dir_scan_worker(void *data)
+{
+	struct dir_scan_worker *w = data;
+	struct dir_scan_jobs *jobs = w->jobs;
+
+	for (;;) {
+		const char *base;
+
+		pthread_mutex_lock(&jobs->mutex);
+		if (jobs->next >= jobs->subdirs->nr) {
+			pthread_mutex_unlock(&jobs->mutex);
+			break;
+		}
+		base = jobs->subdirs->items[jobs->next++].string;
+		pthread_mutex_unlock(&jobs->mutex);
+
+		read_directory_recursive(&w->dir, jobs->istate, base,
+					 strlen(base), NULL, 0, 0,
+					 jobs->pathspec);
+	}
+	return NULL;
+}
+
+static void init_dir_scan_worker(struct dir_scan_worker *w,
+				 struct dir_struct *dir,
+				 struct dir_scan_jobs *jobs)
+{
+	w->jobs = jobs;
+	w->dir = *dir;
+	w->dir.nr = w->dir.alloc = 0;
+	w->dir.ignored_nr = w->dir.ignored_alloc = 0;
+	w->dir.entries = w->dir.ignored = NULL;
+	memset(&w->dir.exclude_list_group[EXC_DIRS], 0,
+	       sizeof(w->dir.exclude_list_group[EXC_DIRS]));
+	w->dir.exclude_stack = NULL;
+	w->dir.pattern = NULL;
+	strbuf_init(&w->dir.basebuf, PATH_MAX);
+}
+
+/* Move the worker's results to 'dir' and free its exclude stack. */
+static void finish_dir_scan_worker(struct dir_scan_worker *w,
+				   struct dir_struct *dir)
+{
+	struct exclude_list_group *group = &w->dir.exclude_list_group[EXC_DIRS];
+	struct exclude_stack *stk;
+	int i;
+
+	ALLOC_GROW(dir->entries, dir->nr + w->dir.nr, dir->alloc);
+	COPY_ARRAY(dir->entries + dir->nr, w->dir.entries, w->dir.nr);
+	dir->nr += w->dir.nr;
+	ALLOC_GROW(dir->ignored, dir->ignored_nr + w->dir.ignored_nr,
+		   dir->ignored_alloc);
+	COPY_ARRAY(dir->ignored + dir->ignored_nr, w->dir.ignored,
+		   w->dir.ignored_nr);
+	dir->ignored_nr += w->dir.ignored_nr;
+	free(w->dir.entries);
+	free(w->dir.ignored);
+
+	for (i = 0; i < group->nr; i++) {
+		free((char *)group->pl[i].src);
+		clear_pattern_list(&group->pl[i]);
+	}
+	free(group->pl);
+	stk = w->dir.exclude_stack;
+	while (stk) {
+		struct exclude_stack *prev = stk->prev;
+		free(stk);
+		stk = prev;
+	}
+	strbuf_release(&w->dir.basebuf);
+}
+
+static void read_directory_parallel(struct dir_struct *dir,
+				    struct index_state *istate,
+				    const char *path, int len,
+				    const struct pathspec *pathspec,
+				    int nr_threads)
+{
+	struct string_list subdirs = STRING_LIST_INIT_DUP;
+	struct dir_scan_jobs jobs;
+	struct dir_scan_worker *workers;
+	int i;
+
+	string_list_append_nodup(&subdirs, xmemdupz(path, len));
+	for (i = 0; i < subdirs.nr; i++) {
+		const char *base = subdirs.items[i].string;
+
+		if (subdirs.nr - i >= nr_threads * DIR_SCAN_JOBS_PER_THREAD)
+			break;
+		read_directory_level(dir, istate, base, strlen(base),
+				     pathspec, &subdirs);
+	}
+	if (subdirs.nr - i < nr_threads)
+		nr_threads = subdirs.nr - i;
+
+	memset(&jobs, 0, sizeof(jobs));
+	jobs.istate = istate;
+	jobs.pathspec = pathspec;
+	jobs.subdirs = &subdirs;
+	jobs.next = i;
+
+	if (nr_threads > 1) {
+		int j;
+
+		/*
+		 * Lookups build the name hash and the pattern matchers on
+		 * demand; do it up front so that the workers only ever
+		 * read them. Per-directory exclude files may be read from
+		 * the index, so take the object read lock as well.
+		 */
+		lazy_init_name_hash(istate);
+		for (i = EXC_CMDL; i <= EXC_FILE; i++) {
+			struct exclude_list_group *group =
+				&dir->exclude_list_group[i];
+			if (i == EXC_DIRS)
+				continue;
+			for (j = 0; j < group->nr; j++)
+				prepare_pattern_matcher(&group->pl[j]);
+		}
+		enable_obj_read_lock();
+		trace2_data_intmax("dir", the_repository, "scan/threads",
+				   nr_threads);
+	}
+	pthread_mutex_init(&jobs.mutex, NULL);
+
+	CALLOC_ARRAY(workers, nr_threads > 1 ? nr_threads : 1);
+	for (i = 0; i < nr_threads; i++) {
+		int err;
+
+		init_dir_scan_worker(&workers[i], dir, &jobs);
+		if (nr_threads == 1) {
+			dir_scan_worker(&workers[i]);
+			continue;
+		}
+		err = pthread_create(&workers[i].thread, NULL,
+				     dir_scan_worker, &workers[i]);
+		if (err)
+			die(_("unable to create thread: %s"), strerror(err));
+	}
+	for (i = 0; i < nr_threads; i++) {
+		if (nr_threads > 1 && pthread_join(workers[i].thread, NULL))
+			die("unable to join thread");
+		finish_dir_scan_worker(&workers[i], dir);
+	}
+
+	if (nr_threads > 1)
+		disable_obj_read_lock();
+	pthread_mutex_destroy(&jobs.mutex);
+	free(workers);
+	string_list_clear(&subdirs, 0);
+}
+
 int read_directory(struct dir_struct *dir, struct index_state *istate,
 		   const char *path, int len, const struct pathspec *pathspec)
 {
 	struct untracked_cache_dir *untracked;
+	int nr_threads = 1;
 
 	trace_performance_enter();
 
@@ -2773,8 +3303,16 @@ int read_directory(struct dir_struct *dir, struct index_state *istate,
 		 * e.g. prep_exclude()
 		 */
 		dir->untracked = NULL;
-	if (!len || treat_leading_path(dir, istate, path, len, pathspec))
-		read_directory_recursive(dir, istate, path, len, untracked, 0, 0, pathspec);
+	if (!untracked)
+		nr_threads = dir_scan_threads(istate, pathspec);
+	if (!len || treat_leading_path(dir, istate, path, len, pathspec)) {
+		if (nr_threads > 1)
+			read_directory_parallel(dir, istate, path, len,
+						pathspec, nr_threads);
+		else
+			read_directory_recursive(dir, istate, path, len,
+						 untracked, 0, 0, pathspec);
+	}
 	QSORT(dir->entries, dir->nr, cmp_dir_entry);
 	QSORT(dir->ignored, dir->ignored_nr, cmp_dir_entry);
 
@@ -84,6 +84,8 @@ struct pattern_entry {
  * can also be used to represent the list of --exclude values passed
  * via CLI args.
  */
+struct pattern_matcher;
+
 struct pattern_list {
 	int nr;
 	int alloc;
@@ -115,6 +117,12 @@ struct pattern_list {
 	 * Used to check single-level parents of blobs.
 	 */
 	struct hashmap parent_hashmap;
+
+	/*
+	 * Lookup tables built from the patterns of a long list, so that
+	 * most patterns need not be tried one by one. Built on first use.
+	 */
+	struct pattern_matcher *matcher;
 };
 
 /*
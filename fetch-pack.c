@@ -869,6 +869,14 @@ static int get_pack(struct fetch_pack_args *args,
 			 * have this responsibility.
 			 */
 			args->check_self_contained_and_connected = 0;
+		if (only_packfile && do_keep && pack_lockfiles &&
+		    !args->check_self_contained_and_connected &&
+		    !args->from_promisor)
+			/*
+			 * But we can tell the caller's connectivity check
+			 * where this pack leaves off; see check_connected().
+			 */
+			strvec_push(&cmd.args, "--report-foreign");
 
 		if (args->from_promisor)
 			/*
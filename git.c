@@ -4,6 +4,7 @@
 #include "help.h"
 #include "run-command.h"
 #include "alias.h"
+#include "resident.h"
 #include "shallow.h"
 
 #define RUN_SETUP		(1<<0)
@@ -17,6 +18,7 @@
 #define SUPPORT_SUPER_PREFIX	(1<<4)
 #define DELAY_PAGER_CONFIG	(1<<5)
 #define NO_PARSEOPT		(1<<6) /* parse-options is not used */
+#define RESIDENT_OK		(1<<7) /* may be run by "git resident" */
 
 struct cmd_struct {
 	const char *cmd;
@@ -481,7 +483,7 @@ static struct cmd_struct commands[] = {
 	{ "branch", cmd_branch, RUN_SETUP | DELAY_PAGER_CONFIG },
 	{ "bugreport", cmd_bugreport, RUN_SETUP_GENTLY },
 	{ "bundle", cmd_bundle, RUN_SETUP_GENTLY | NO_PARSEOPT },
-	{ "cat-file", cmd_cat_file, RUN_SETUP },
+	{ "cat-file", cmd_cat_file, RUN_SETUP | RESIDENT_OK },
 	{ "check-attr", cmd_check_attr, RUN_SETUP },
 	{ "check-ignore", cmd_check_ignore, RUN_SETUP | NEED_WORK_TREE },
 	{ "check-mailmap", cmd_check_mailmap, RUN_SETUP },
@@ -515,7 +517,7 @@ static struct cmd_struct commands[] = {
 	{ "fetch", cmd_fetch, RUN_SETUP },
 	{ "fetch-pack", cmd_fetch_pack, RUN_SETUP | NO_PARSEOPT },
 	{ "fmt-merge-msg", cmd_fmt_merge_msg, RUN_SETUP },
-	{ "for-each-ref", cmd_for_each_ref, RUN_SETUP },
+	{ "for-each-ref", cmd_for_each_ref, RUN_SETUP | RESIDENT_OK },
 	{ "format-patch", cmd_format_patch, RUN_SETUP },
 	{ "fsck", cmd_fsck, RUN_SETUP },
 	{ "fsck-objects", cmd_fsck, RUN_SETUP },
@@ -531,12 +533,12 @@ static struct cmd_struct commands[] = {
 	{ "log", cmd_log, RUN_SETUP },
 	{ "ls-files", cmd_ls_files, RUN_SETUP },
 	{ "ls-remote", cmd_ls_remote, RUN_SETUP_GENTLY },
-	{ "ls-tree", cmd_ls_tree, RUN_SETUP },
+	{ "ls-tree", cmd_ls_tree, RUN_SETUP | RESIDENT_OK },
 	{ "mailinfo", cmd_mailinfo, RUN_SETUP_GENTLY | NO_PARSEOPT },
 	{ "mailsplit", cmd_mailsplit, NO_PARSEOPT },
 	{ "maintenance", cmd_maintenance, RUN_SETUP_GENTLY | NO_PARSEOPT },
 	{ "merge", cmd_merge, RUN_SETUP | NEED_WORK_TREE },
-	{ "merge-base", cmd_merge_base, RUN_SETUP },
+	{ "merge-base", cmd_merge_base, RUN_SETUP | RESIDENT_OK },
 	{ "merge-file", cmd_merge_file, RUN_SETUP_GENTLY },
 	{ "merge-index", cmd_merge_index, RUN_SETUP | NO_PARSEOPT },
 	{ "merge-ours", cmd_merge_ours, RUN_SETUP | NO_PARSEOPT },
@@ -573,9 +575,10 @@ static struct cmd_struct commands[] = {
 	{ "replace", cmd_replace, RUN_SETUP },
 	{ "rerere", cmd_rerere, RUN_SETUP },
 	{ "reset", cmd_reset, RUN_SETUP },
+	{ "resident", cmd_resident },
 	{ "restore", cmd_restore, RUN_SETUP | NEED_WORK_TREE },
 	{ "rev-list", cmd_rev_list, RUN_SETUP | NO_PARSEOPT },
-	{ "rev-parse", cmd_rev_parse, NO_PARSEOPT },
+	{ "rev-parse", cmd_rev_parse, NO_PARSEOPT | RESIDENT_OK },
 	{ "revert", cmd_revert, RUN_SETUP | NEED_WORK_TREE },
 	{ "rm", cmd_rm, RUN_SETUP },
 	{ "send-pack", cmd_send_pack, RUN_SETUP },
@@ -627,6 +630,27 @@ int is_builtin(const char *s)
 	return !!get_builtin(s);
 }
 
+int is_resident_builtin(const char *cmd)
+{
+	struct cmd_struct *p = get_builtin(cmd);
+
+	return p && (p->option & RESIDENT_OK);
+}
+
+int run_resident_builtin(int argc, const char **argv, const char *prefix,
+			 const char *cwd)
+{
+	struct cmd_struct *p = get_builtin(argv[0]);
+
+	if (!p || !(p->option & RESIDENT_OK))
+		BUG("'%s' cannot be run by git resident", argv[0]);
+
+	setup_git_directory_preset(prefix);
+	if (chdir(cwd))
+		die_errno(_("cannot change to '%s'"), cwd);
+	return run_builtin(p, argc, argv);
+}
+
 static void list_builtins(struct string_list *out, unsigned int exclude_option)
 {
 	int i;
@@ -696,8 +720,15 @@ static void handle_builtin(int argc, const char **argv)
 	}
 
 	builtin = get_builtin(cmd);
-	if (builtin)
+	if (builtin) {
+		/* --[no-]paginate is not passed on to the server */
+		if ((builtin->option & RESIDENT_OK) && use_pager == -1) {
+			int status = run_resident_command(argv);
+			if (status >= 0)
+				exit(status);
+		}
 		exit(run_builtin(builtin, argc, argv));
+	}
 	strvec_clear(&args);
 }
 
@@ -74,6 +74,36 @@ static int send_ref(const char *refname, const struct object_id *oid,
 	return 0;
 }
 
+/*
+ * Narrow the client's "ref-prefix" arguments down to prefixes that can
+ * match something below "refs/", which is all that the namespaced
+ * iteration in ls_refs() would have shown anyway. A prefix like "r"
+ * covers the whole of "refs/"; one like "HEAD" can never match and is
+ * dropped. Returns 0 if the prefixes could not possibly restrict the
+ * iteration (including the case that none were given), in which case
+ * "out" is left empty.
+ */
+static int collect_iteration_prefixes(const struct strvec *prefixes,
+				      struct strvec *out)
+{
+	int i;
+
+	if (!prefixes->nr)
+		return 0;
+
+	for (i = 0; i < prefixes->nr; i++) {
+		const char *prefix = prefixes->v[i];
+
+		if (starts_with(prefix, "refs/")) {
+			strvec_push(out, prefix);
+		} else if (starts_with("refs/", prefix)) {
+			strvec_clear(out);
+			return 0;
+		}
+	}
+	return 1;
+}
+
 static int ls_refs_config(const char *var, const char *value, void *data)
 {
 	/*
@@ -88,6 +118,7 @@ int ls_refs(struct repository *r, struct strvec *keys,
 	    struct packet_reader *request)
 {
 	struct ls_refs_data data;
+	struct strvec iter_prefixes = STRVEC_INIT;
 
 	memset(&data, 0, sizeof(data));
 
@@ -109,8 +140,16 @@ int ls_refs(struct repository *r, struct strvec *keys,
 		die(_("expected flush after ls-refs arguments"));
 
 	head_ref_namespaced(send_ref, &data);
-	for_each_namespaced_ref(send_ref, &data);
+	if (collect_iteration_prefixes(&data.prefixes, &iter_prefixes)) {
+		if (iter_prefixes.nr)
+			for_each_fullref_in_prefixes(get_git_namespace(),
+						     iter_prefixes.v,
+						     send_ref, &data, 0);
+	} else {
+		for_each_namespaced_ref(send_ref, &data);
+	}
 	packet_flush(1);
+	strvec_clear(&iter_prefixes);
 	strvec_clear(&data.prefixes);
 	return 0;
 }
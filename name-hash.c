@@ -571,7 +571,7 @@ static void threaded_lazy_init_name_hash(
 	free(lazy_entries);
 }
 
-static void lazy_init_name_hash(struct index_state *istate)
+void lazy_init_name_hash(struct index_state *istate)
 {
 
 	if (istate->name_hash_initialized)
@@ -619,6 +619,140 @@ int test_lazy_init_name_hash(struct index_state *istate, int try_threaded)
 	return lazy_nr_dir_threads;
 }
 
+/*
+ * Until the hash tables are built, look names up in the sorted index
+ * instead, so that a handful of lookups (e.g. by "git add <file>") do
+ * not have to hash every entry first.  As that costs O(log n) string
+ * comparisons per lookup, build the hash tables once there have been
+ * enough lookups to pay for it.
+ */
+#define NAME_HASH_LOOKUP_RATIO (32)
+
+static int use_name_hash(struct index_state *istate)
+{
+	if (istate->name_hash_initialized)
+		return 1;
+	if (++istate->name_hash_lookups <= istate->cache_nr / NAME_HASH_LOOKUP_RATIO)
+		return 0;
+	lazy_init_name_hash(istate);
+	return 1;
+}
+
+/*
+ * Compare the `n` bytes of the entry's name after the first `depth`
+ * bytes with `key`, where a name too short to have that many bytes
+ * sorts before any key it is a prefix of.
+ */
+static int cmp_name_at(const struct cache_entry *ce, int depth,
+		       const char *key, int n)
+{
+	int len = ce_namelen(ce) - depth;
+	int cmp = memcmp(ce->name + depth, key, len < n ? len : n);
+
+	if (cmp || len >= n)
+		return cmp;
+	return -1;
+}
+
+/*
+ * Narrow down [*lo, *hi), a range of entries whose names share the
+ * first `depth` bytes, to those that continue with the `n` bytes of
+ * `key`.
+ */
+static void narrow_name_range(struct index_state *istate, int *lo, int *hi,
+			      int depth, const char *key, int n)
+{
+	int first = *lo, last = *hi;
+
+	while (first < last) {
+		int mid = first + (last - first) / 2;
+		if (cmp_name_at(istate->cache[mid], depth, key, n) < 0)
+			first = mid + 1;
+		else
+			last = mid;
+	}
+	*lo = first;
+	last = *hi;
+	while (first < last) {
+		int mid = first + (last - first) / 2;
+		if (cmp_name_at(istate->cache[mid], depth, key, n) <= 0)
+			first = mid + 1;
+		else
+			last = mid;
+	}
+	*hi = first;
+}
+
+/*
+ * Find the entries named `name`, or below the directory `name` if `dir`
+ * is set, ignoring case if `icase` is set.  Names that differ only in
+ * case can sort far apart, so there may be several ranges of them;
+ * store the first one found, preferring the case given in `name`, in
+ * [*lo, *hi).  Returns 0 if there is none.
+ */
+static int find_name_range(struct index_state *istate, int *lo, int *hi,
+			   const char *name, int namelen, int depth,
+			   int dir, int icase)
+{
+	while (depth < namelen) {
+		int end = depth, l, h;
+		char c;
+
+		while (end < namelen && (!icase || !isalpha(name[end])))
+			end++;
+		if (end > depth) {
+			narrow_name_range(istate, lo, hi, depth, name + depth,
+					  end - depth);
+			if (*lo >= *hi)
+				return 0;
+			depth = end;
+			continue;
+		}
+
+		/* try the other case only if the one given is not there */
+		c = name[depth];
+		l = *lo;
+		h = *hi;
+		narrow_name_range(istate, &l, &h, depth, &c, 1);
+		if (l < h && find_name_range(istate, &l, &h, name, namelen,
+					     depth + 1, dir, icase)) {
+			*lo = l;
+			*hi = h;
+			return 1;
+		}
+		c = isupper(c) ? tolower(c) : toupper(c);
+		narrow_name_range(istate, lo, hi, depth, &c, 1);
+		if (*lo >= *hi)
+			return 0;
+		depth++;
+	}
+
+	if (dir) {
+		narrow_name_range(istate, lo, hi, namelen, "/", 1);
+	} else {
+		/* all stages of the name itself sort before longer names */
+		int i = *lo;
+		while (i < *hi && ce_namelen(istate->cache[i]) == namelen)
+			i++;
+		*hi = i;
+	}
+	return *lo < *hi;
+}
+
+static int find_in_index(struct index_state *istate, const char *name,
+			 int namelen, int dir, int icase, int *lo, int *hi)
+{
+	*lo = 0;
+	*hi = istate->cache_nr;
+	if (find_name_range(istate, lo, hi, name, namelen, 0, dir, 0))
+		return 1;
+	if (!icase)
+		return 0;
+	*lo = 0;
+	*hi = istate->cache_nr;
+	return find_name_range(istate, lo, hi, name, namelen, 0, dir, 1);
+}
+
 void add_name_hash(struct index_state *istate, struct cache_entry *ce)
 {
 	if (istate->name_hash_initialized)
@@ -676,7 +810,10 @@ int index_dir_exists(struct index_state *istate, const char *name, int namelen)
 {
 	struct dir_entry *dir;
 
-	lazy_init_name_hash(istate);
+	if (!use_name_hash(istate)) {
+		int lo, hi;
+		return find_in_index(istate, name, namelen, 1, 1, &lo, &hi);
+	}
 	dir = find_dir_entry(istate, name, namelen);
 	return dir && dir->nr;
 }
@@ -685,18 +822,27 @@ void adjust_dirname_case(struct index_state *istate, char *name)
 {
 	const char *startPtr = name;
 	const char *ptr = startPtr;
+	int hashed = use_name_hash(istate);
 
-	lazy_init_name_hash(istate);
 	while (*ptr) {
 		while (*ptr && *ptr != '/')
 			ptr++;
 
 		if (*ptr == '/') {
-			struct dir_entry *dir;
+			const char *found = NULL;
+			int lo, hi;
+
+			if (hashed) {
+				struct dir_entry *dir;
 
-			dir = find_dir_entry(istate, name, ptr - name);
-			if (dir) {
-				memcpy((void *)startPtr, dir->name + (startPtr - name), ptr - startPtr);
+				dir = find_dir_entry(istate, name, ptr - name);
+				if (dir)
+					found = dir->name;
+			} else if (find_in_index(istate, name, ptr - name, 1, 1, &lo, &hi)) {
+				found = istate->cache[lo]->name;
+			}
+			if (found) {
+				memcpy((void *)startPtr, found + (startPtr - name), ptr - startPtr);
 				startPtr = ptr + 1;
 			}
 			ptr++;
@@ -707,10 +853,16 @@ void adjust_dirname_case(struct index_state *istate, char *name)
 struct cache_entry *index_file_exists(struct index_state *istate, const char *name, int namelen, int icase)
 {
 	struct cache_entry *ce;
-	unsigned int hash = memihash(name, namelen);
+	unsigned int hash;
 
-	lazy_init_name_hash(istate);
+	if (!use_name_hash(istate)) {
+		int lo, hi;
+		if (!find_in_index(istate, name, namelen, 0, icase, &lo, &hi))
+			return NULL;
+		return istate->cache[lo];
+	}
 
+	hash = memihash(name, namelen);
 	ce = hashmap_get_entry_from_hash(&istate->name_hash, hash, NULL,
 					 struct cache_entry, ent);
 	hashmap_for_each_entry_from(&istate->name_hash, ce, ent) {
@@ -722,6 +874,7 @@ struct cache_entry *index_file_exists(struct index_state *istate, const char *na
 
 void free_name_hash(struct index_state *istate)
 {
+	istate->name_hash_lookups = 0;
 	if (!istate->name_hash_initialized)
 		return;
 	istate->name_hash_initialized = 0;
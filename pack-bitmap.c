@@ -13,6 +13,7 @@
 #include "repository.h"
 #include "object-store.h"
 #include "list-objects-filter-options.h"
+#include "commit-reach.h"
 
 /*
  * An entry on the bitmap index, representing the bitmap for a given
@@ -1233,6 +1234,87 @@ void count_bitmap_commit_list(struct bitmap_index *bitmap_git,
 		*tags = count_object_type(bitmap_git, OBJ_TAG);
 }
 
+static struct bitmap *find_commit_reach(struct repository *r,
+					struct bitmap_index *bitmap_git,
+					struct commit *commit)
+{
+	struct rev_info revs;
+	struct object_list *roots = NULL;
+	struct bitmap *reach;
+
+	repo_init_revisions(r, &revs, NULL);
+	object_list_insert(&commit->object, &roots);
+
+	reach = find_objects(bitmap_git, &revs, roots, NULL, NULL);
+	if (!reach)
+		reach = bitmap_new();
+
+	object_list_free(&roots);
+	clear_commit_marks(commit, ALL_REV_FLAGS);
+	return reach;
+}
+
+/*
+ * Count the commits that are set in "a" but not in "b".
+ */
+static uint32_t count_commits_and_not(struct bitmap_index *bitmap_git,
+				      struct bitmap *a, struct bitmap *b)
+{
+	struct eindex *eindex = &bitmap_git->ext_index;
+	uint32_t i = 0, count = 0;
+	struct ewah_iterator it;
+	eword_t filter;
+
+	init_type_iterator(&it, bitmap_git, OBJ_COMMIT);
+
+	while (i < a->word_alloc && ewah_iterator_next(&filter, &it)) {
+		eword_t word = a->words[i] & filter;
+		if (word && i < b->word_alloc)
+			word &= ~b->words[i];
+		count += ewah_bit_popcount64(word);
+		i++;
+	}
+
+	for (i = 0; i < eindex->count; i++) {
+		size_t pos = bitmap_git->pack->num_objects + i;
+		if (eindex->objects[i]->type == OBJ_COMMIT &&
+		    bitmap_get(a, pos) && !bitmap_get(b, pos))
+			count++;
+	}
+
+	return count;
+}
+
+void bitmap_ahead_behind(struct repository *r,
+			 struct bitmap_index *bitmap_git,
+			 struct commit *base,
+			 struct commit **tips, size_t tips_nr,
+			 struct ahead_behind_count *counts)
+{
+	struct bitmap *base_reach;
+	size_t i;
+
+	base_reach = find_commit_reach(r, bitmap_git, base);
+
+	for (i = 0; i < tips_nr; i++) {
+		struct bitmap *tip_reach;
+
+		if (tips[i] == base) {
+			counts[i].ahead = counts[i].behind = 0;
+			continue;
+		}
+
+		tip_reach = find_commit_reach(r, bitmap_git, tips[i]);
+		counts[i].ahead = count_commits_and_not(bitmap_git,
+							tip_reach, base_reach);
+		counts[i].behind = count_commits_and_not(bitmap_git,
+							 base_reach, tip_reach);
+		bitmap_free(tip_reach);
+	}
+
+	bitmap_free(base_reach);
+}
+
 struct bitmap_test_data {
 	struct bitmap_index *bitmap_git;
 	struct bitmap *base;
@@ -6,6 +6,7 @@
 #include "pack.h"
 #include "pack-objects.h"
 
+struct ahead_behind_count;
 struct commit;
 struct repository;
 struct rev_info;
@@ -61,6 +62,17 @@ void free_bitmap_index(struct bitmap_index *);
 int bitmap_walk_contains(struct bitmap_index *,
 			 struct bitmap *bitmap, const struct object_id *oid);
 
+/*
+ * Fill counts[i] with the number of commits reachable from tips[i] but
+ * not from base ("ahead"), and vice versa ("behind"). Reachability comes
+ * from the stored commit bitmaps; only commits that are newer than the
+ * bitmapped pack are walked.
+ */
+void bitmap_ahead_behind(struct repository *r, struct bitmap_index *,
+			 struct commit *base,
+			 struct commit **tips, size_t tips_nr,
+			 struct ahead_behind_count *counts);
+
 /*
  * After a traversal has been performed by prepare_bitmap_walk(), this can be
  * queried to see if a particular object was reachable from any of the
@@ -168,6 +168,9 @@ struct packing_data {
 	/* delta islands */
 	unsigned int *tree_depth;
 	unsigned char *layer;
+
+	/* hash of the full path, when grouping delta candidates by path */
+	uint32_t *path_hash;
 };
 
 void prepare_packing_data(struct repository *r, struct packing_data *pdata);
@@ -431,6 +434,23 @@ static inline void oe_set_tree_depth(struct packing_data *pack,
 	pack->tree_depth[e - pack->objects] = tree_depth;
 }
 
+static inline uint32_t oe_path_hash(struct packing_data *pack,
+				    const struct object_entry *e)
+{
+	if (!pack->path_hash)
+		return 0;
+	return pack->path_hash[e - pack->objects];
+}
+
+static inline void oe_set_path_hash(struct packing_data *pack,
+				    struct object_entry *e,
+				    uint32_t path_hash)
+{
+	if (!pack->path_hash)
+		CALLOC_ARRAY(pack->path_hash, pack->nr_alloc);
+	pack->path_hash[e - pack->objects] = path_hash;
+}
+
 static inline unsigned char oe_layer(struct packing_data *pack,
 				     struct object_entry *e)
 {
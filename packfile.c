@@ -597,6 +597,13 @@ static int open_packed_git(struct packed_git *p)
 	return -1;
 }
 
+int use_pack_fd(struct packed_git *p)
+{
+	if (p->pack_fd == -1 && open_packed_git(p))
+		return -1;
+	return p->pack_fd;
+}
+
 static int in_window(struct pack_window *win, off_t offset)
 {
 	/* We must promise at least one full hash after the
@@ -664,6 +671,7 @@ unsigned char *use_pack(struct packed_git *p,
 				close_pack_fd(p);
 			pack_mmap_calls++;
 			pack_open_windows++;
+			trace2_counter_add(TRACE2_COUNTER_ID_PACK_WINDOWS, 1);
 			if (pack_mapped > peak_pack_mapped)
 				peak_pack_mapped = pack_mapped;
 			if (pack_open_windows > peak_pack_open_windows)
@@ -1684,6 +1692,7 @@ void *unpack_entry(struct repository *r, struct packed_git *p, off_t obj_offset,
 	int delta_stack_nr = 0, delta_stack_alloc = UNPACK_ENTRY_STACK_PREALLOC;
 	int base_from_cache = 0;
 
+	trace2_timer_start(TRACE2_TIMER_ID_UNPACK_ENTRY);
 	write_pack_access_log(p, obj_offset);
 
 	/* PHASE 1: drill down to the innermost base object */
@@ -1863,6 +1872,7 @@ void *unpack_entry(struct repository *r, struct packed_git *p, off_t obj_offset,
 	if (delta_stack != small_delta_stack)
 		free(delta_stack);
 
+	trace2_timer_stop(TRACE2_TIMER_ID_UNPACK_ENTRY);
 	return data;
 }
 
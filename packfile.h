@@ -89,6 +89,15 @@ int close_pack_fd(struct packed_git *p);
 uint32_t get_pack_fanout(struct packed_git *p, uint32_t value);
 
 unsigned char *use_pack(struct packed_git *, struct pack_window **, off_t, unsigned long *);
+
+/*
+ * Return the descriptor of the packfile, to read from it other than
+ * through use_pack(), opening it again if it was closed (e.g. because
+ * the whole pack is mapped).  It counts against the limit of open
+ * packs like any other, so the next pack that is opened may close it;
+ * do not hold on to it.  Returns -1 if the pack cannot be opened.
+ */
+int use_pack_fd(struct packed_git *);
 void close_pack_windows(struct packed_git *);
 void close_pack(struct packed_git *);
 void close_object_store(struct raw_object_store *o);
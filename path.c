@@ -125,6 +125,7 @@ static struct common_dir common_list[] = {
 	{ 0, 1, 0, "refs/rewritten" },
 	{ 0, 1, 0, "refs/worktree" },
 	{ 0, 1, 1, "remotes" },
+	{ 0, 1, 1, "rename-cache" },
 	{ 0, 1, 1, "worktrees" },
 	{ 0, 1, 1, "rr-cache" },
 	{ 0, 1, 1, "svn" },
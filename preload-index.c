@@ -9,6 +9,7 @@
 #include "progress.h"
 #include "thread-utils.h"
 #include "repository.h"
+#include "batch-lstat.h"
 
 /*
  * Mostly randomly chosen maximum thread counts: we
@@ -19,6 +20,12 @@
 #define MAX_PARALLEL (20)
 #define THREAD_COST (500)
 
+/*
+ * Number of lstat's kept in flight at once when they can be batched,
+ * also mostly randomly chosen.
+ */
+#define BATCH_DEPTH (256)
+
 struct progress_data {
 	unsigned long n;
 	struct progress *progress;
@@ -33,6 +40,30 @@ struct thread_data {
 	int offset, nr;
 };
 
+static int needs_lstat(const struct cache_entry *ce)
+{
+	if (ce_stage(ce))
+		return 0;
+	if (S_ISGITLINK(ce->ce_mode))
+		return 0;
+	if (ce_uptodate(ce))
+		return 0;
+	if (ce_skip_worktree(ce))
+		return 0;
+	if (ce->ce_flags & CE_FSMONITOR_VALID)
+		return 0;
+	return 1;
+}
+
+static void mark_uptodate_if_clean(struct index_state *index,
+				   struct cache_entry *ce, struct stat *st)
+{
+	if (ie_match_stat(index, ce, st, CE_MATCH_RACY_IS_DIRTY|CE_MATCH_IGNORE_FSMONITOR))
+		return;
+	ce_mark_uptodate(ce);
+	mark_fsmonitor_valid(index, ce);
+}
+
 static void *preload_thread(void *_data)
 {
 	int nr, last_nr;
@@ -50,15 +81,7 @@ static void *preload_thread(void *_data)
 		struct cache_entry *ce = *cep++;
 		struct stat st;
 
-		if (ce_stage(ce))
-			continue;
-		if (S_ISGITLINK(ce->ce_mode))
-			continue;
-		if (ce_uptodate(ce))
-			continue;
-		if (ce_skip_worktree(ce))
-			continue;
-		if (ce->ce_flags & CE_FSMONITOR_VALID)
+		if (!needs_lstat(ce))
 			continue;
 		if (p->progress && !(nr & 31)) {
 			struct progress_data *pd = p->progress;
@@ -75,10 +98,7 @@ static void *preload_thread(void *_data)
 			continue;
 		if (lstat(ce->name, &st))
 			continue;
-		if (ie_match_stat(index, ce, &st, CE_MATCH_RACY_IS_DIRTY|CE_MATCH_IGNORE_FSMONITOR))
-			continue;
-		ce_mark_uptodate(ce);
-		mark_fsmonitor_valid(index, ce);
+		mark_uptodate_if_clean(index, ce, &st);
 	} while (--nr > 0);
 	if (p->progress) {
 		struct progress_data *pd = p->progress;
@@ -91,6 +111,61 @@ static void *preload_thread(void *_data)
 	return NULL;
 }
 
+/*
+ * Instead of spreading the lstat's over threads, keep many of them in
+ * flight from this thread, if the platform lets us.  Returns 0 if it
+ * does not.
+ */
+static int preload_batched(struct index_state *index,
+			   const struct pathspec *pathspec,
+			   unsigned int refresh_flags)
+{
+	struct batch_lstat *batch;
+	struct cache_def cache = CACHE_DEF_INIT;
+	struct progress *progress = NULL;
+	struct cache_entry *ce;
+	struct stat st;
+	void *data;
+	int i, err;
+
+	prepare_repo_settings(the_repository);
+	if (!the_repository->settings.core_io_uring)
+		return 0;
+	batch = batch_lstat_init(BATCH_DEPTH);
+	if (!batch)
+		return 0;
+
+	trace_performance_enter();
+	if (refresh_flags & REFRESH_PROGRESS && isatty(2))
+		progress = start_delayed_progress(_("Refreshing index"), index->cache_nr);
+
+	for (i = 0; i < index->cache_nr; i++) {
+		ce = index->cache[i];
+		if (!needs_lstat(ce))
+			continue;
+		display_progress(progress, i + 1);
+		if (pathspec && !ce_path_match(index, ce, pathspec, NULL))
+			continue;
+		if (threaded_has_symlink_leading_path(&cache, ce->name, ce_namelen(ce)))
+			continue;
+		while (batch_lstat_queue(batch, ce->name, ce) < 0) {
+			if (batch_lstat_next(batch, &data, &st, &err) && !err)
+				mark_uptodate_if_clean(index, data, &st);
+		}
+	}
+	while (batch_lstat_next(batch, &data, &st, &err)) {
+		if (!err)
+			mark_uptodate_if_clean(index, data, &st);
+	}
+
+	display_progress(progress, index->cache_nr);
+	stop_progress(&progress);
+	batch_lstat_release(batch);
+	cache_def_clear(&cache);
+	trace_performance_leave("preload index (batched)");
+	return 1;
+}
+
 void preload_index(struct index_state *index,
 		   const struct pathspec *pathspec,
 		   unsigned int refresh_flags)
@@ -99,7 +174,7 @@ void preload_index(struct index_state *index,
 	struct thread_data data[MAX_PARALLEL];
 	struct progress_data pd;
 
-	if (!HAVE_THREADS || !core_preload_index)
+	if (!core_preload_index)
 		return;
 
 	threads = index->cache_nr / THREAD_COST;
@@ -107,6 +182,10 @@ void preload_index(struct index_state *index,
 		threads = 2;
 	if (threads < 2)
 		return;
+	if (preload_batched(index, pathspec, refresh_flags))
+		return;
+	if (!HAVE_THREADS)
+		return;
 	trace_performance_enter();
 	if (threads > MAX_PARALLEL)
 		threads = MAX_PARALLEL;
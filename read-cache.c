@@ -47,12 +47,42 @@
 #define CACHE_EXT_FSMONITOR 0x46534D4E	  /* "FSMN" */
 #define CACHE_EXT_ENDOFINDEXENTRIES 0x454F4945	/* "EOIE" */
 #define CACHE_EXT_INDEXENTRYOFFSETTABLE 0x49454F54 /* "IEOT" */
+#define CACHE_EXT_DIRECTORYTABLE 0x44495253	  /* "DIRS" */
+#define CACHE_EXT_DELTALOG 0x646C6F67	  /* "dlog" */
 
 /* changes that can be kept in $GIT_DIR/index (basically all extensions) */
 #define EXTMASK (RESOLVE_UNDO_CHANGED | CACHE_TREE_CHANGED | \
 		 CE_ENTRY_ADDED | CE_ENTRY_REMOVED | CE_ENTRY_CHANGED | \
 		 SPLIT_INDEX_ORDERED | UNTRACKED_CHANGED | FSMONITOR_CHANGED)
 
+/* changes that can be appended to the delta log */
+#define DELTA_LOG_MASK (CE_ENTRY_ADDED | CE_ENTRY_REMOVED | CE_ENTRY_CHANGED | \
+			CACHE_TREE_CHANGED)
+
+/*
+ * With index.deltaLog, small changes are appended to the index file as
+ * checksummed records after its trailing hash, instead of rewriting the
+ * whole file.  This remembers where the records start and which entries
+ * are on disk, so that the next write only has to append what changed.
+ */
+struct index_delta_log {
+	size_t base_size;	/* up to and including the trailing hash */
+	size_t end;		/* end of the last valid record */
+	struct cache_time base_timestamp;
+	struct cache_entry **entries;
+	unsigned int nr;
+	struct cache_tree *cache_tree;
+};
+
+static void read_delta_log(struct index_state *istate, const char *mmap,
+			   size_t mmap_size, const struct stat *st);
+static int apply_delta_log(struct index_state *istate, const char *mmap,
+			   size_t mmap_size, size_t base_size,
+			   const char *prefix, int prefixlen,
+			   struct cache_time *timestamp, size_t *end);
+static void snapshot_delta_log(struct index_state *istate);
+static void free_delta_log(struct index_state *istate);
+
 
 /*
  * This is an estimate of the pathname length in the index.  We use
@@ -1695,10 +1725,8 @@ int verify_index_checksum;
 /* Allow fsck to force verification of the cache entry order. */
 int verify_ce_order;
 
-static int verify_hdr(const struct cache_header *hdr, unsigned long size)
+static int verify_hdr_version(const struct cache_header *hdr)
 {
-	git_hash_ctx c;
-	unsigned char hash[GIT_MAX_RAWSZ];
 	int hdr_version;
 
 	if (hdr->hdr_signature != htonl(CACHE_SIGNATURE))
@@ -1706,6 +1734,16 @@ static int verify_hdr(const struct cache_header *hdr, unsigned long size)
 	hdr_version = ntohl(hdr->hdr_version);
 	if (hdr_version < INDEX_FORMAT_LB || INDEX_FORMAT_UB < hdr_version)
 		return error(_("bad index version %d"), hdr_version);
+	return 0;
+}
+
+static int verify_hdr(const struct cache_header *hdr, unsigned long size)
+{
+	git_hash_ctx c;
+	unsigned char hash[GIT_MAX_RAWSZ];
+
+	if (verify_hdr_version(hdr) < 0)
+		return -1;
 
 	if (!verify_index_checksum)
 		return 0;
@@ -1742,6 +1780,18 @@ static int read_index_extension(struct index_state *istate,
 	case CACHE_EXT_INDEXENTRYOFFSETTABLE:
 		/* already handled in do_read_index() */
 		break;
+	case CACHE_EXT_DIRECTORYTABLE:
+		/* only used by read_index_subtree_from() */
+		break;
+	case CACHE_EXT_DELTALOG:
+		if (sz != 16)
+			return error(_("invalid dlog extension"));
+		free_delta_log(istate);
+		istate->delta_log = xcalloc(1, sizeof(*istate->delta_log));
+		istate->delta_log->base_size = get_be64(data);
+		istate->delta_log->base_timestamp.sec = get_be32(data + 8);
+		istate->delta_log->base_timestamp.nsec = get_be32(data + 12);
+		break;
 	default:
 		if (*ext < 'A' || 'Z' < *ext)
 			return error(_("index uses %.4s extension, which we do not understand"),
@@ -1939,8 +1989,33 @@ static struct index_entry_offset_table *read_ieot_extension(const char *mmap, si
 static void write_ieot_extension(struct strbuf *sb, struct index_entry_offset_table *ieot);
 
 static size_t read_eoie_extension(const char *mmap, size_t mmap_size);
+static size_t find_eoie_extension(const char *mmap, size_t mmap_size,
+				  size_t *base_size);
 static void write_eoie_extension(struct strbuf *sb, git_hash_ctx *eoie_context, size_t offset);
 
+/*
+ * The directory table lists the directories with many entries below
+ * them, so that those entries can be read without reading the rest.
+ */
+struct directory_table_entry {
+	const char *name;	/* including the trailing slash, not NUL-terminated */
+	int namelen;
+	uint32_t pos;		/* position of the first entry in the index */
+	uint32_t nr;		/* number of entries below the directory */
+	uint32_t offset;	/* file offset of the first entry */
+};
+
+struct directory_table {
+	int nr, alloc;
+	struct directory_table_entry *entries;
+};
+
+static int read_directory_table_extension(const char *mmap, size_t mmap_size,
+					  size_t offset, const char *prefix,
+					  int prefixlen,
+					  struct directory_table_entry *found);
+static void write_directory_table_extension(struct strbuf *sb, struct directory_table *dt);
+
 struct load_index_extensions
 {
 	pthread_t pthread;
@@ -1954,8 +2029,9 @@ static void *load_index_extensions(void *_data)
 {
 	struct load_index_extensions *p = _data;
 	unsigned long src_offset = p->src_offset;
+	size_t end = p->mmap_size;
 
-	while (src_offset <= p->mmap_size - the_hash_algo->rawsz - 8) {
+	while (src_offset <= end - the_hash_algo->rawsz - 8) {
 		/* After an array of active_nr index entries,
 		 * there can be arbitrary number of extended
 		 * sections, each of which is prefixed with
@@ -1972,6 +2048,16 @@ static void *load_index_extensions(void *_data)
 		}
 		src_offset += 8;
 		src_offset += extsize;
+
+		/* appended delta log records are not extensions */
+		if (p->istate->delta_log) {
+			end = p->istate->delta_log->base_size;
+			if (end > p->mmap_size ||
+			    end < src_offset + the_hash_algo->rawsz) {
+				munmap((void *)p->mmap, p->mmap_size);
+				die(_("index file corrupt"));
+			}
+		}
 	}
 
 	return NULL;
@@ -2143,7 +2229,7 @@ int do_read_index(struct index_state *istate, const char *path, int must_exist)
 	unsigned long src_offset;
 	const struct cache_header *hdr;
 	const char *mmap;
-	size_t mmap_size;
+	size_t mmap_size, base_size;
 	struct load_index_extensions p;
 	size_t extension_offset = 0;
 	int nr_threads, cpus;
@@ -2161,12 +2247,14 @@ int do_read_index(struct index_state *istate, const char *path, int must_exist)
 		die_errno(_("%s: index file open failed"), path);
 	}
 
+	trace2_timer_start(TRACE2_TIMER_ID_INDEX_READ);
 	if (fstat(fd, &st))
 		die_errno(_("%s: cannot stat the open index"), path);
 
 	mmap_size = xsize_t(st.st_size);
 	if (mmap_size < sizeof(struct cache_header) + the_hash_algo->rawsz)
 		die(_("%s: index file smaller than expected"), path);
+	base_size = mmap_size;
 
 	mmap = xmmap_gently(NULL, mmap_size, PROT_READ, MAP_PRIVATE, fd, 0);
 	if (mmap == MAP_FAILED)
@@ -2174,7 +2262,11 @@ int do_read_index(struct index_state *istate, const char *path, int must_exist)
 	close(fd);
 
 	hdr = (const struct cache_header *)mmap;
-	if (verify_hdr(hdr, mmap_size) < 0)
+	/*
+	 * The checksum is verified once we know where the index ends,
+	 * as a delta log may have been appended to it.
+	 */
+	if (verify_hdr_version(hdr) < 0)
 		goto unmap;
 
 	hashcpy(istate->oid.hash, (const unsigned char *)hdr + mmap_size - the_hash_algo->rawsz);
@@ -2205,7 +2297,7 @@ int do_read_index(struct index_state *istate, const char *path, int must_exist)
 		nr_threads = 1;
 
 	if (nr_threads > 1) {
-		extension_offset = read_eoie_extension(mmap, mmap_size);
+		extension_offset = find_eoie_extension(mmap, mmap_size, &base_size);
 		if (extension_offset) {
 			int err;
 
@@ -2223,7 +2315,7 @@ int do_read_index(struct index_state *istate, const char *path, int must_exist)
 	 * to multi-thread the reading of the cache entries.
 	 */
 	if (extension_offset && nr_threads > 1)
-		ieot = read_ieot_extension(mmap, mmap_size, extension_offset);
+		ieot = read_ieot_extension(mmap, base_size, extension_offset);
 
 	if (ieot) {
 		src_offset += load_cache_entries_threaded(istate, mmap, mmap_size, nr_threads, ieot);
@@ -2244,6 +2336,17 @@ int do_read_index(struct index_state *istate, const char *path, int must_exist)
 		p.src_offset = src_offset;
 		load_index_extensions(&p);
 	}
+
+	/* the EOIE extension must have been where the index says it ends */
+	if (extension_offset &&
+	    base_size != (istate->delta_log ?
+			  istate->delta_log->base_size : mmap_size))
+		goto unmap;
+	if (verify_hdr(hdr, istate->delta_log ?
+			    istate->delta_log->base_size : mmap_size) < 0)
+		goto unmap;
+	if (istate->delta_log)
+		read_delta_log(istate, mmap, mmap_size, &st);
 	munmap((void *)mmap, mmap_size);
 
 	/*
@@ -2255,8 +2358,107 @@ int do_read_index(struct index_state *istate, const char *path, int must_exist)
 	trace2_data_intmax("index", the_repository, "read/cache_nr",
 			   istate->cache_nr);
 
+	trace2_timer_stop(TRACE2_TIMER_ID_INDEX_READ);
+	return istate->cache_nr;
+
+unmap:
+	munmap((void *)mmap, mmap_size);
+	die(_("index file corrupt"));
+}
+
+/*
+ * Read only the entries below the deepest directory in the directory
+ * table that contains `prefix`.  Returns -1 without touching `istate`
+ * when that is not possible, in which case the caller should read the
+ * whole index instead (and report any errors doing so).
+ */
+static int do_read_index_subtree(struct index_state *istate, const char *path,
+				 const char *prefix, int prefixlen)
+{
+	int fd;
+	struct stat st;
+	const struct cache_header *hdr;
+	const char *mmap;
+	size_t mmap_size, base_size, extension_offset, end;
+	struct cache_time timestamp;
+	unsigned long consumed;
+	struct directory_table_entry dir = { 0 };
+	struct cache_entry *first, *last;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) ||
+	    xsize_t(st.st_size) < sizeof(struct cache_header) + the_hash_algo->rawsz) {
+		close(fd);
+		return -1;
+	}
+
+	mmap_size = xsize_t(st.st_size);
+	mmap = xmmap_gently(NULL, mmap_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mmap == MAP_FAILED)
+		return -1;
+
+	hdr = (const struct cache_header *)mmap;
+	extension_offset = find_eoie_extension(mmap, mmap_size, &base_size);
+	if (!extension_offset || verify_hdr(hdr, base_size) < 0 ||
+	    !read_directory_table_extension(mmap, base_size, extension_offset,
+					    prefix, prefixlen, &dir))
+		goto fallback;
+	if (!dir.nr || dir.pos + dir.nr > ntohl(hdr->hdr_entries) ||
+	    dir.offset < sizeof(*hdr) || dir.offset >= extension_offset)
+		goto unmap;
+
+	hashcpy(istate->oid.hash, (const unsigned char *)hdr + base_size - the_hash_algo->rawsz);
+	istate->version = ntohl(hdr->hdr_version);
+	istate->cache_nr = dir.nr;
+	istate->cache_alloc = alloc_nr(istate->cache_nr);
+	istate->cache = xcalloc(istate->cache_alloc, sizeof(*istate->cache));
+	istate->initialized = 1;
+	istate->partial_read = 1;
+
+	istate->ce_mem_pool = xmalloc(sizeof(*istate->ce_mem_pool));
+	mem_pool_init(istate->ce_mem_pool,
+		      estimate_cache_size_from_compressed(istate->cache_nr));
+	consumed = load_cache_entry_block(istate, istate->ce_mem_pool, 0,
+					  istate->cache_nr, mmap, dir.offset, NULL);
+
+	/* the table must have pointed us at the right entries */
+	first = istate->cache[0];
+	last = istate->cache[istate->cache_nr - 1];
+	if (dir.offset + consumed > extension_offset ||
+	    first->ce_namelen < dir.namelen ||
+	    memcmp(first->name, dir.name, dir.namelen) ||
+	    last->ce_namelen < dir.namelen ||
+	    memcmp(last->name, dir.name, dir.namelen))
+		goto unmap;
+
+	/* bring the entries up to date with the delta log, if any */
+	if (apply_delta_log(istate, mmap, mmap_size, base_size,
+			    dir.name, dir.namelen, &timestamp, &end) < 0)
+		goto unmap;
+	if (end != mmap_size) {
+		/* let a full read sort out the racy timestamp */
+		discard_index(istate);
+		goto fallback;
+	}
+
+	istate->timestamp.sec = st.st_mtime;
+	istate->timestamp.nsec = ST_MTIME_NSEC(st);
+	munmap((void *)mmap, mmap_size);
+
+	trace2_data_intmax("index", the_repository, "read/version",
+			   istate->version);
+	trace2_data_intmax("index", the_repository, "read/subtree_nr",
+			   istate->cache_nr);
+
 	return istate->cache_nr;
 
+fallback:
+	munmap((void *)mmap, mmap_size);
+	return -1;
+
 unmap:
 	munmap((void *)mmap, mmap_size);
 	die(_("index file corrupt"));
@@ -2330,6 +2532,33 @@ int read_index_from(struct index_state *istate, const char *path,
 	return ret;
 }
 
+int read_index_subtree_from(struct index_state *istate, const char *path,
+			    const char *gitdir,
+			    const char *prefix, int prefixlen)
+{
+	int ret;
+
+	if (istate->initialized)
+		return istate->cache_nr;
+
+	if (prefixlen) {
+		trace2_region_enter_printf("index", "do_read_index_subtree",
+					   the_repository, "%s", path);
+		trace_performance_enter();
+		ret = do_read_index_subtree(istate, path, prefix, prefixlen);
+		trace_performance_leave("read cache %s below %.*s", path,
+					prefixlen, prefix);
+		trace2_region_leave_printf("index", "do_read_index_subtree",
+					   the_repository, "%s", path);
+		if (ret >= 0) {
+			check_ce_order(istate);
+			return ret;
+		}
+	}
+
+	return read_index_from(istate, path, gitdir);
+}
+
 int is_index_unborn(struct index_state *istate)
 {
 	return (!istate->cache_nr && !istate->timestamp.sec);
@@ -2355,6 +2584,8 @@ int discard_index(struct index_state *istate)
 	cache_tree_free(&(istate->cache_tree));
 	istate->initialized = 0;
 	istate->fsmonitor_has_run_once = 0;
+	istate->partial_read = 0;
+	free_delta_log(istate);
 	FREE_AND_NULL(istate->cache);
 	istate->cache_alloc = 0;
 	discard_split_index(istate);
@@ -2664,6 +2895,7 @@ static int verify_index_from(const struct index_state *istate, const char *path)
 {
 	int fd;
 	ssize_t n;
+	off_t offset;
 	struct stat st;
 	unsigned char hash[GIT_MAX_RAWSZ];
 
@@ -2680,7 +2912,16 @@ static int verify_index_from(const struct index_state *istate, const char *path)
 	if (st.st_size < sizeof(struct cache_header) + the_hash_algo->rawsz)
 		goto out;
 
-	n = pread_in_full(fd, hash, the_hash_algo->rawsz, st.st_size - the_hash_algo->rawsz);
+	/* records appended to the delta log do not change the checksum */
+	if (istate->delta_log) {
+		if (st.st_size != istate->delta_log->end)
+			goto out;
+		offset = istate->delta_log->base_size - the_hash_algo->rawsz;
+	} else {
+		offset = st.st_size - the_hash_algo->rawsz;
+	}
+
+	n = pread_in_full(fd, hash, the_hash_algo->rawsz, offset);
 	if (n != the_hash_algo->rawsz)
 		goto out;
 
@@ -2754,6 +2995,113 @@ static int record_ieot(void)
 	return !git_config_get_index_threads(&val) && val != 1;
 }
 
+static int record_directory_table(void)
+{
+	int val;
+
+	if (!git_config_get_bool("index.recorddirectorytable", &val))
+		return val;
+	return 0;
+}
+
+static int record_delta_log(void)
+{
+	int val;
+
+	if (!git_config_get_bool("index.deltalog", &val))
+		return val;
+	return git_env_bool("GIT_TEST_INDEX_DELTA_LOG", 0);
+}
+
+static int delta_log_max_percent(void)
+{
+	int val;
+
+	if (!git_config_get_int("index.deltalogmaxpercent", &val) &&
+	    0 <= val && val <= 100)
+		return val;
+	return 10;
+}
+
+static void write_delta_log_extension(struct strbuf *sb, uint64_t base_size,
+				      const struct cache_time *timestamp)
+{
+	unsigned char buffer[8];
+
+	put_be64(buffer, base_size);
+	strbuf_add(sb, buffer, 8);
+	put_be32(buffer, timestamp->sec);
+	put_be32(buffer + 4, timestamp->nsec);
+	strbuf_add(sb, buffer, 8);
+}
+
+/*
+ * Directories with fewer entries than this below them are cheap enough
+ * to find by reading the whole index.
+ */
+#define DIRECTORY_TABLE_MIN_ENTRIES 64
+
+/*
+ * Collect the directories that have at least DIRECTORY_TABLE_MIN_ENTRIES
+ * entries below them, in index order.  The offsets are filled in while
+ * the entries are written.
+ */
+static void compute_directory_table(struct index_state *istate,
+				    struct directory_table *dt)
+{
+	int *stack = NULL, stack_alloc = 0, depth = 0;
+	int i, kept;
+	uint32_t pos = 0;
+
+	for (i = 0; i < istate->cache_nr; i++) {
+		const struct cache_entry *ce = istate->cache[i];
+		const char *slash;
+		int base;
+
+		if (ce->ce_flags & CE_REMOVE)
+			continue;
+
+		/* leave the directories that do not contain this entry */
+		while (depth) {
+			struct directory_table_entry *d = &dt->entries[stack[depth - 1]];
+
+			if (!strncmp(ce->name, d->name, d->namelen))
+				break;
+			d->nr = pos - d->pos;
+			depth--;
+		}
+
+		/* and enter the ones that lead to it */
+		base = depth ? dt->entries[stack[depth - 1]].namelen : 0;
+		while ((slash = strchr(ce->name + base, '/'))) {
+			struct directory_table_entry *d;
+
+			ALLOC_GROW(dt->entries, dt->nr + 1, dt->alloc);
+			d = &dt->entries[dt->nr];
+			d->name = ce->name;
+			d->namelen = slash - ce->name + 1;
+			d->pos = pos;
+			d->nr = 0;
+			d->offset = 0;
+
+			ALLOC_GROW(stack, depth + 1, stack_alloc);
+			stack[depth++] = dt->nr++;
+			base = d->namelen;
+		}
+		pos++;
+	}
+	while (depth) {
+		struct directory_table_entry *d = &dt->entries[stack[--depth]];
+		d->nr = pos - d->pos;
+	}
+	free(stack);
+
+	for (i = kept = 0; i < dt->nr; i++)
+		if (dt->entries[i].nr >= DIRECTORY_TABLE_MIN_ENTRIES)
+			dt->entries[kept++] = dt->entries[i];
+	dt->nr = kept;
+}
+
 /*
  * On success, `tempfile` is closed. If it is the temporary file
  * of a `struct lock_file`, we will therefore effectively perform
@@ -2778,7 +3126,13 @@ static int do_write_index(struct index_state *istate, struct tempfile *tempfile,
 	off_t offset;
 	int ieot_entries = 1;
 	struct index_entry_offset_table *ieot = NULL;
-	int nr, nr_threads;
+	struct directory_table dt = { 0 };
+	int dt_next = 0;
+	uint32_t pos = 0;
+	int nr, nr_threads, write_eoie;
+
+	if (istate->partial_read)
+		BUG("cannot write an index that was only partially read");
 
 	for (i = removed = extended = 0; i < entries; i++) {
 		if (cache[i]->ce_flags & CE_REMOVE)
@@ -2845,9 +3199,17 @@ static int do_write_index(struct index_state *istate, struct tempfile *tempfile,
 		}
 	}
 
+	/*
+	 * The entries of a split index do not make sense on their own,
+	 * so only record the directory table for a complete index.
+	 */
+	if (!strip_extensions && !istate->split_index && record_directory_table())
+		compute_directory_table(istate, &dt);
+
 	offset = lseek(newfd, 0, SEEK_CUR);
 	if (offset < 0) {
 		free(ieot);
+		free(dt.entries);
 		return -1;
 	}
 	offset += write_buffer_len;
@@ -2892,12 +3254,31 @@ static int do_write_index(struct index_state *istate, struct tempfile *tempfile,
 			}
 			offset += write_buffer_len;
 		}
+		if (dt_next < dt.nr && dt.entries[dt_next].pos == pos) {
+			off_t dir_offset = lseek(newfd, 0, SEEK_CUR);
+
+			if (dir_offset < 0) {
+				free(ieot);
+				free(dt.entries);
+				return -1;
+			}
+			dir_offset += write_buffer_len;
+			while (dt_next < dt.nr && dt.entries[dt_next].pos == pos)
+				dt.entries[dt_next++].offset = dir_offset;
+			/*
+			 * Like above, a V4 index must not share a prefix
+			 * with the entry before the directory.
+			 */
+			if (previous_name)
+				previous_name->buf[0] = 0;
+		}
 		if (ce_write_entry(&c, newfd, ce, previous_name, (struct ondisk_cache_entry *)&ondisk) < 0)
 			err = -1;
 
 		if (err)
 			break;
 		nr++;
+		pos++;
 	}
 	if (ieot && nr) {
 		ieot->entries[ieot->nr].nr = nr;
@@ -2908,6 +3289,7 @@ static int do_write_index(struct index_state *istate, struct tempfile *tempfile,
 
 	if (err) {
 		free(ieot);
+		free(dt.entries);
 		return err;
 	}
 
@@ -2915,6 +3297,7 @@ static int do_write_index(struct index_state *istate, struct tempfile *tempfile,
 	offset = lseek(newfd, 0, SEEK_CUR);
 	if (offset < 0) {
 		free(ieot);
+		free(dt.entries);
 		return -1;
 	}
 	offset += write_buffer_len;
@@ -2935,9 +3318,29 @@ static int do_write_index(struct index_state *istate, struct tempfile *tempfile,
 			|| ce_write(&c, newfd, sb.buf, sb.len) < 0;
 		strbuf_release(&sb);
 		free(ieot);
-		if (err)
+		if (err) {
+			free(dt.entries);
+			return -1;
+		}
+	}
+
+	/*
+	 * The directory table is found through the end of index entries
+	 * extension, so write it early, too.
+	 */
+	if (dt.nr) {
+		struct strbuf sb = STRBUF_INIT;
+
+		write_directory_table_extension(&sb, &dt);
+		err = write_index_ext_header(&c, &eoie_c, newfd, CACHE_EXT_DIRECTORYTABLE, sb.len) < 0
+			|| ce_write(&c, newfd, sb.buf, sb.len) < 0;
+		strbuf_release(&sb);
+		if (err) {
+			free(dt.entries);
 			return -1;
+		}
 	}
+	free(dt.entries);
 
 	if (!strip_extensions && istate->split_index &&
 	    !is_null_oid(&istate->split_index->base_oid)) {
@@ -2994,13 +3397,48 @@ static int do_write_index(struct index_state *istate, struct tempfile *tempfile,
 			return -1;
 	}
 
+	/*
+	 * The delta log extension records where the index ends, so that
+	 * readers can find the records appended after it.  It has to be
+	 * the last one before CACHE_EXT_ENDOFINDEXENTRIES to know that.
+	 */
+	write_eoie = offset && (record_eoie() || dt.nr);
+	if (!strip_extensions && !istate->split_index && record_delta_log()) {
+		struct strbuf sb = STRBUF_INIT;
+		off_t end = lseek(newfd, 0, SEEK_CUR);
+
+		if (end < 0)
+			return -1;
+		end += write_buffer_len + 8 + 16 + the_hash_algo->rawsz;
+		if (write_eoie)
+			end += 8 + 4 + the_hash_algo->rawsz;
+
+		write_delta_log_extension(&sb, end, &istate->timestamp);
+		err = write_index_ext_header(&c, &eoie_c, newfd, CACHE_EXT_DELTALOG,
+					     sb.len) < 0 ||
+			ce_write(&c, newfd, sb.buf, sb.len) < 0;
+		strbuf_release(&sb);
+		if (err)
+			return -1;
+
+		if (!istate->delta_log)
+			istate->delta_log = xcalloc(1, sizeof(*istate->delta_log));
+		istate->delta_log->base_size = end;
+		istate->delta_log->end = end;
+		istate->delta_log->base_timestamp = istate->timestamp;
+		FREE_AND_NULL(istate->delta_log->entries);
+	} else {
+		free_delta_log(istate);
+	}
+
 	/*
 	 * CACHE_EXT_ENDOFINDEXENTRIES must be written as the last entry before the SHA1
 	 * so that it can be found and processed before all the index entries are
 	 * read.  Write it out regardless of the strip_extensions parameter as we need it
-	 * when loading the shared index.
+	 * when loading the shared index.  The directory table cannot be found
+	 * without it.
 	 */
-	if (offset && record_eoie()) {
+	if (write_eoie) {
 		struct strbuf sb = STRBUF_INIT;
 
 		write_eoie_extension(&sb, &eoie_c, offset);
@@ -3048,6 +3486,387 @@ static int commit_locked_index(struct lock_file *lk)
 		return commit_lock_file(lk);
 }
 
+static void free_delta_log(struct index_state *istate)
+{
+	if (!istate->delta_log)
+		return;
+	free(istate->delta_log->entries);
+	FREE_AND_NULL(istate->delta_log);
+}
+
+/*
+ * Remember the entries that are now on disk, so that the next write can
+ * tell what changed.  Entries that are not allocated from a memory pool
+ * may be freed behind our back, in which case the next write has to
+ * rewrite the whole index.
+ */
+static void snapshot_delta_log(struct index_state *istate)
+{
+	struct index_delta_log *log = istate->delta_log;
+	unsigned int i;
+
+	FREE_AND_NULL(log->entries);
+	log->nr = 0;
+	log->cache_tree = istate->cache_tree;
+
+	ALLOC_ARRAY(log->entries, istate->cache_nr);
+	for (i = 0; i < istate->cache_nr; i++) {
+		struct cache_entry *ce = istate->cache[i];
+
+		if (ce->ce_flags & CE_REMOVE)
+			continue;
+		if (!ce->mem_pool_allocated) {
+			FREE_AND_NULL(log->entries);
+			log->nr = 0;
+			return;
+		}
+		ce->ce_flags &= ~CE_UPDATE_IN_BASE;
+		log->entries[log->nr++] = ce;
+	}
+}
+
+static void add_delta_log_entry(struct index_state *istate, struct cache_entry *ce)
+{
+	int pos = index_name_stage_pos(istate, ce->name, ce_namelen(ce), ce_stage(ce));
+
+	cache_tree_invalidate_path(istate, ce->name);
+	if (pos >= 0) {
+		replace_index_entry(istate, pos, ce);
+		return;
+	}
+	pos = -pos - 1;
+	untracked_cache_add_to_index(istate, ce->name);
+
+	ALLOC_GROW(istate->cache, istate->cache_nr + 1, istate->cache_alloc);
+	istate->cache_nr++;
+	if (istate->cache_nr > pos + 1)
+		MOVE_ARRAY(istate->cache + pos + 1, istate->cache + pos,
+			   istate->cache_nr - pos - 1);
+	set_index_entry(istate, pos, ce);
+}
+
+/*
+ * A record consists of the timestamp the writer used to smudge racily
+ * clean entries, the names and stages of the removed entries and the
+ * added or changed entries in the on-disk format.
+ */
+static int apply_delta_log_record(struct index_state *istate,
+				  const char *p, const char *end,
+				  const char *prefix, int prefixlen,
+				  struct cache_time *timestamp)
+{
+	const struct cache_entry *previous_ce = NULL;
+	uint32_t i, nr;
+	int removed = 0;
+
+	if (end - p < 12)
+		return -1;
+	timestamp->sec = get_be32(p);
+	timestamp->nsec = get_be32(p + 4);
+	nr = get_be32(p + 8);
+	p += 12;
+
+	for (i = 0; i < nr; i++) {
+		const char *eos;
+		int pos;
+
+		if (end - p < 2 || !(eos = memchr(p + 1, '\0', end - p - 1)))
+			return -1;
+		pos = index_name_stage_pos(istate, p + 1, eos - p - 1,
+					   (unsigned char)*p);
+		if (pos >= 0) {
+			istate->cache[pos]->ce_flags |= CE_REMOVE;
+			removed = 1;
+		}
+		p = eos + 1;
+	}
+	if (removed)
+		remove_marked_cache_entries(istate, 1);
+
+	if (end - p < 4)
+		return -1;
+	nr = get_be32(p);
+	p += 4;
+	for (i = 0; i < nr; i++) {
+		struct cache_entry *ce;
+		unsigned long consumed;
+
+		if (end - p < (ptrdiff_t)ondisk_cache_entry_size(ondisk_data_size(0, 1)))
+			return -1;
+		ce = create_from_disk(istate->ce_mem_pool, istate->version,
+				      (struct ondisk_cache_entry *)p,
+				      &consumed, previous_ce);
+		if (consumed > end - p)
+			return -1;
+		p += consumed;
+		previous_ce = ce;
+		/* a partial index only holds the entries below prefix */
+		if (prefix && (ce->ce_namelen < prefixlen ||
+			       memcmp(ce->name, prefix, prefixlen)))
+			continue;
+		add_delta_log_entry(istate, ce);
+	}
+
+	return p == end ? 0 : -1;
+}
+
+/*
+ * Apply the records appended to the index after `base_size`, leaving out
+ * the entries that are not below `prefix` if it is given, and store the
+ * end of the last valid record in `end`.  `timestamp` is set to the one
+ * stored in that record, and left alone if there is none.  Returns the
+ * number of records applied, or -1 if a valid record makes no sense.
+ */
+static int apply_delta_log(struct index_state *istate, const char *mmap,
+			   size_t mmap_size, size_t base_size,
+			   const char *prefix, int prefixlen,
+			   struct cache_time *timestamp, size_t *end)
+{
+	const unsigned rawsz = the_hash_algo->rawsz;
+	size_t offset = base_size;
+	int nr = 0;
+
+	while (mmap_size - offset >= 4 + rawsz + 8) {
+		const char *body = mmap + offset + 4;
+		uint32_t len = get_be32(mmap + offset);
+		unsigned char hash[GIT_MAX_RAWSZ];
+		git_hash_ctx c;
+
+		if (len > mmap_size - offset - 4 - rawsz - 8 ||
+		    get_be64(body + len + rawsz) != base_size)
+			break;
+		the_hash_algo->init_fn(&c);
+		the_hash_algo->update_fn(&c, body, len);
+		the_hash_algo->final_fn(hash, &c);
+		if (!hasheq(hash, (const unsigned char *)body + len))
+			break;
+
+		if (apply_delta_log_record(istate, body, body + len,
+					   prefix, prefixlen, timestamp) < 0)
+			return -1;
+		offset += 4 + len + rawsz + 8;
+		nr++;
+	}
+	*end = offset;
+	return nr;
+}
+
+static void read_delta_log(struct index_state *istate, const char *mmap,
+			   size_t mmap_size, const struct stat *st)
+{
+	struct index_delta_log *log = istate->delta_log;
+	const unsigned rawsz = the_hash_algo->rawsz;
+	struct cache_time timestamp = log->base_timestamp;
+	int nr;
+
+	hashcpy(istate->oid.hash, (const unsigned char *)mmap + log->base_size - rawsz);
+
+	nr = apply_delta_log(istate, mmap, mmap_size, log->base_size,
+			     NULL, 0, &timestamp, &log->end);
+	if (nr < 0) {
+		munmap((void *)mmap, mmap_size);
+		die(_("index file corrupt"));
+	}
+
+	/*
+	 * A record at the end that does not check out is either being
+	 * written right now or was left behind by a crash.  Either way the
+	 * mtime of the file no longer tells when the valid records were
+	 * written, so use the timestamp their writer smudged against.
+	 */
+	if (log->end != mmap_size) {
+		istate->timestamp = timestamp;
+		if (!istate->timestamp.sec)
+			istate->timestamp.sec = 1;
+	}
+
+	istate->cache_changed = 0;
+	snapshot_delta_log(istate);
+
+	trace2_data_intmax("index", the_repository, "read/delta_records", nr);
+}
+
+/*
+ * Append what changed since the index was read or last written to the
+ * delta log.  Returns 1 if the whole index has to be written instead.
+ */
+static int append_delta_log(struct index_state *istate, struct lock_file *lock)
+{
+	struct index_delta_log *log = istate->delta_log;
+	const unsigned rawsz = the_hash_algo->rawsz;
+	struct cache_entry **removed = NULL, **changed = NULL;
+	int removed_nr = 0, removed_alloc = 0, changed_nr = 0, changed_alloc = 0;
+	struct strbuf previous_name_buf = STRBUF_INIT, *previous_name;
+	struct ondisk_cache_entry ondisk;
+	unsigned char hash[GIT_MAX_RAWSZ];
+	unsigned char buffer[12];
+	unsigned int i, j, extended, added = 0;
+	git_hash_ctx c;
+	struct stat st;
+	char *path;
+	off_t end;
+	int fd, ret = 1;
+
+	if (!log || !log->entries || !record_delta_log() ||
+	    should_validate_cache_entries() ||
+	    (istate->cache_changed & ~DELTA_LOG_MASK) ||
+	    istate->drop_cache_tree || istate->cache_tree != log->cache_tree ||
+	    istate->fsmonitor_last_update ||
+	    ((istate->cache_changed & CACHE_TREE_CHANGED) &&
+	     istate->cache_tree && istate->cache_tree->entry_count >= 0) ||
+	    (uint64_t)(log->end - log->base_size) * 100 >
+	    (uint64_t)log->base_size * delta_log_max_percent())
+		return 1;
+
+	/* make sure nobody rewrote the index since we read it */
+	path = get_locked_file_path(lock);
+	fd = open(path, O_RDWR);
+	free(path);
+	if (fd < 0)
+		return 1;
+	if (fstat(fd, &st) || st.st_size != log->end ||
+	    pread_in_full(fd, hash, rawsz, log->base_size - rawsz) != rawsz ||
+	    !hasheq(hash, istate->oid.hash))
+		goto out;
+
+	for (i = extended = 0; i < istate->cache_nr; i++) {
+		struct cache_entry *ce = istate->cache[i];
+		unsigned int size = ce->ce_stat_data.sd_size;
+
+		if (ce->ce_flags & CE_REMOVE)
+			continue;
+		if (ce->ce_flags & CE_EXTENDED_FLAGS)
+			extended++;
+		if (!ce_uptodate(ce) && is_racy_timestamp(istate, ce)) {
+			ce_smudge_racily_clean_entry(istate, ce);
+			if (ce->ce_stat_data.sd_size != size)
+				ce->ce_flags |= CE_UPDATE_IN_BASE;
+		}
+	}
+	/* let a full write demote version 3 to version 2 */
+	if (istate->version == 3 && !extended)
+		goto out;
+
+	/* both arrays are sorted by name and stage */
+	for (i = j = 0; i < istate->cache_nr || j < log->nr; ) {
+		struct cache_entry *ce = i < istate->cache_nr ? istate->cache[i] : NULL;
+		struct cache_entry *old = j < log->nr ? log->entries[j] : NULL;
+		int cmp;
+
+		if (ce && (ce->ce_flags & CE_REMOVE)) {
+			i++;
+			continue;
+		}
+		if (ce == old)
+			cmp = 0;
+		else if (!ce)
+			cmp = 1;
+		else if (!old)
+			cmp = -1;
+		else
+			cmp = cache_name_stage_compare(ce->name, ce_namelen(ce), ce_stage(ce),
+						       old->name, ce_namelen(old), ce_stage(old));
+
+		if (cmp > 0) {
+			/*
+			 * Resolving conflicts updates the resolve undo
+			 * information behind our back.
+			 */
+			if (ce_stage(old))
+				goto out;
+			ALLOC_GROW(removed, removed_nr + 1, removed_alloc);
+			removed[removed_nr++] = old;
+			j++;
+			continue;
+		}
+		if (cmp < 0 || ce != old || (ce->ce_flags & CE_UPDATE_IN_BASE)) {
+			if (is_null_oid(&ce->oid) || ce_stage(ce))
+				goto out;
+			ce->ce_flags &= ~CE_EXTENDED;
+			if (ce->ce_flags & CE_EXTENDED_FLAGS) {
+				if (istate->version == 2)
+					goto out;
+				ce->ce_flags |= CE_EXTENDED;
+			}
+			ALLOC_GROW(changed, changed_nr + 1, changed_alloc);
+			changed[changed_nr++] = ce;
+		}
+		i++;
+		if (!cmp)
+			j++;
+		else
+			added++;
+	}
+
+	/* adding or removing paths invalidates the untracked cache */
+	if (istate->untracked && (added || removed_nr))
+		goto out;
+
+	/*
+	 * The length goes first, but is only known at the end.  Until it
+	 * is filled in, readers see a record that does not check out.
+	 */
+	ret = -1;
+	memset(buffer, 0, 4);
+	if (lseek(fd, log->end, SEEK_SET) < 0 ||
+	    write_in_full(fd, buffer, 4) < 0)
+		goto out;
+
+	the_hash_algo->init_fn(&c);
+	put_be32(buffer, istate->timestamp.sec);
+	put_be32(buffer + 4, istate->timestamp.nsec);
+	put_be32(buffer + 8, removed_nr);
+	if (ce_write(&c, fd, buffer, 12) < 0)
+		goto out;
+	for (i = 0; i < removed_nr; i++) {
+		unsigned char stage = ce_stage(removed[i]);
+
+		if (ce_write(&c, fd, &stage, 1) < 0 ||
+		    ce_write(&c, fd, removed[i]->name, ce_namelen(removed[i]) + 1) < 0)
+			goto out;
+	}
+	put_be32(buffer, changed_nr);
+	if (ce_write(&c, fd, buffer, 4) < 0)
+		goto out;
+	previous_name = (istate->version == 4) ? &previous_name_buf : NULL;
+	for (i = 0; i < changed_nr; i++)
+		if (ce_write_entry(&c, fd, changed[i], previous_name, &ondisk) < 0)
+			goto out;
+	if (ce_flush(&c, fd, hash))
+		goto out;
+
+	/* let readers find the end of the extensions from the end of the file */
+	put_be64(buffer, log->base_size);
+	if (write_in_full(fd, buffer, 8) < 0)
+		goto out;
+
+	end = lseek(fd, 0, SEEK_CUR);
+	if (end < 0)
+		goto out;
+	put_be32(buffer, end - log->end - 4 - rawsz - 8);
+	if (lseek(fd, log->end, SEEK_SET) < 0 ||
+	    write_in_full(fd, buffer, 4) < 0 || fstat(fd, &st))
+		goto out;
+
+	istate->timestamp.sec = (unsigned int)st.st_mtime;
+	istate->timestamp.nsec = ST_MTIME_NSEC(st);
+	log->end = end;
+	snapshot_delta_log(istate);
+	ret = 0;
+
+	trace2_data_intmax("index", the_repository, "write/delta_nr",
+			   removed_nr + changed_nr);
+
+out:
+	if (ret < 0)
+		error_errno(_("unable to append to the index"));
+	close(fd);
+	strbuf_release(&previous_name_buf);
+	free(removed);
+	free(changed);
+	return ret;
+}
+
 static int do_write_locked_index(struct index_state *istate, struct lock_file *lock,
 				 unsigned flags)
 {
@@ -3059,7 +3878,9 @@ static int do_write_locked_index(struct index_state *istate, struct lock_file *l
 	 */
 	trace2_region_enter_printf("index", "do_write_index", the_repository,
 				   "%s", lock->tempfile->filename.buf);
+	trace2_timer_start(TRACE2_TIMER_ID_INDEX_WRITE);
 	ret = do_write_index(istate, lock->tempfile, 0);
+	trace2_timer_stop(TRACE2_TIMER_ID_INDEX_WRITE);
 	trace2_region_leave_printf("index", "do_write_index", the_repository,
 				   "%s", lock->tempfile->filename.buf);
 
@@ -3070,6 +3891,14 @@ static int do_write_locked_index(struct index_state *istate, struct lock_file *l
 	else
 		ret = close_lock_file_gently(lock);
 
+	/* only an index we put in place ourselves can be appended to */
+	if (istate->delta_log) {
+		if (!ret && (flags & COMMIT_LOCK))
+			snapshot_delta_log(istate);
+		else
+			free_delta_log(istate);
+	}
+
 	run_hook_le(NULL, "post-index-change",
 			istate->updated_workdir ? "1" : "0",
 			istate->updated_skipworktree ? "1" : "0", NULL);
@@ -3159,7 +3988,9 @@ static int write_shared_index(struct index_state *istate,
 
 	trace2_region_enter_printf("index", "shared/do_write_index",
 				   the_repository, "%s", (*temp)->filename.buf);
+	trace2_timer_start(TRACE2_TIMER_ID_INDEX_WRITE);
 	ret = do_write_index(si->base, *temp, 1);
+	trace2_timer_stop(TRACE2_TIMER_ID_INDEX_WRITE);
 	trace2_region_leave_printf("index", "shared/do_write_index",
 				   the_repository, "%s", (*temp)->filename.buf);
 
@@ -3228,6 +4059,21 @@ int write_locked_index(struct index_state *istate, struct lock_file *lock,
 	if (istate->fsmonitor_last_update)
 		fill_fsmonitor_bitmap(istate);
 
+	if (!si && !alternate_index_output && (flags & COMMIT_LOCK)) {
+		ret = append_delta_log(istate, lock);
+		if (!ret) {
+			/* the index was updated in place; drop the unused lock */
+			rollback_lock_file(lock);
+			run_hook_le(NULL, "post-index-change",
+				    istate->updated_workdir ? "1" : "0",
+				    istate->updated_skipworktree ? "1" : "0", NULL);
+			istate->updated_workdir = 0;
+			istate->updated_skipworktree = 0;
+		}
+		if (ret <= 0)
+			goto out;
+	}
+
 	if (!si || alternate_index_output ||
 	    (istate->cache_changed & ~EXTMASK)) {
 		if (si)
@@ -3549,6 +4395,31 @@ static size_t read_eoie_extension(const char *mmap, size_t mmap_size)
 	return offset;
 }
 
+/*
+ * Like read_eoie_extension(), but also look for the EOIE extension at
+ * the end of the index proper when a delta log has been appended to it,
+ * using the size of the index that the last record ends with.  That size
+ * is stored in `base_size`.
+ */
+static size_t find_eoie_extension(const char *mmap, size_t mmap_size,
+				  size_t *base_size)
+{
+	size_t offset = read_eoie_extension(mmap, mmap_size);
+	uint64_t size;
+
+	if (offset || mmap_size < 8) {
+		*base_size = mmap_size;
+		return offset;
+	}
+	size = get_be64(mmap + mmap_size - 8);
+	if (size > mmap_size - 8 - 4 - the_hash_algo->rawsz)
+		return 0;
+	offset = read_eoie_extension(mmap, size);
+	if (offset)
+		*base_size = size;
+	return offset;
+}
+
 static void write_eoie_extension(struct strbuf *sb, git_hash_ctx *eoie_context, size_t offset)
 {
 	uint32_t buffer;
@@ -3635,3 +4506,101 @@ static void write_ieot_extension(struct strbuf *sb, struct index_entry_offset_ta
 		strbuf_add(sb, &buffer, sizeof(uint32_t));
 	}
 }
+
+#define DIRECTORY_TABLE_VERSION	(1)
+
+/*
+ * Find the deepest directory in the directory table that is a leading
+ * path of `prefix`.  Returns 0 if there is no such directory, or if the
+ * index cannot be read partially at all.
+ */
+static int read_directory_table_extension(const char *mmap, size_t mmap_size,
+					  size_t offset, const char *prefix,
+					  int prefixlen,
+					  struct directory_table_entry *found)
+{
+	const char *index = NULL, *end;
+	uint32_t extsize = 0;
+	int ret = 0;
+
+	/* find the DIRS extension */
+	while (offset <= mmap_size - the_hash_algo->rawsz - 8) {
+		extsize = get_be32(mmap + offset + 4);
+		/* the entries of a split index are not all in this file */
+		if (CACHE_EXT((mmap + offset)) == CACHE_EXT_LINK)
+			return 0;
+		if (CACHE_EXT((mmap + offset)) == CACHE_EXT_DIRECTORYTABLE) {
+			index = mmap + offset + 4 + 4;
+			break;
+		}
+		offset += 8;
+		offset += extsize;
+	}
+	if (!index || extsize < sizeof(uint32_t) ||
+	    extsize > mmap_size - the_hash_algo->rawsz - offset - 8)
+		return 0;
+	end = index + extsize;
+
+	/* validate the version is DIRECTORY_TABLE_VERSION */
+	if (get_be32(index) != DIRECTORY_TABLE_VERSION) {
+		error("invalid DIRS version %d", get_be32(index));
+		return 0;
+	}
+	index += sizeof(uint32_t);
+
+	while (index < end) {
+		const char *name = index;
+		const char *eos = memchr(name, '\0', end - name);
+		int namelen;
+
+		if (!eos || end - eos - 1 < 3 * sizeof(uint32_t)) {
+			error("invalid DIRS extension");
+			return 0;
+		}
+		namelen = eos - name;
+		index = eos + 1;
+
+		if (namelen <= prefixlen && !memcmp(name, prefix, namelen) &&
+		    (!ret || namelen > found->namelen)) {
+			found->name = name;
+			found->namelen = namelen;
+			found->pos = get_be32(index);
+			found->nr = get_be32(index + 4);
+			found->offset = get_be32(index + 8);
+			ret = 1;
+		}
+		index += 3 * sizeof(uint32_t);
+	}
+
+	return ret;
+}
+
+static void write_directory_table_extension(struct strbuf *sb, struct directory_table *dt)
+{
+	uint32_t buffer;
+	int i;
+
+	/* version */
+	put_be32(&buffer, DIRECTORY_TABLE_VERSION);
+	strbuf_add(sb, &buffer, sizeof(uint32_t));
+
+	for (i = 0; i < dt->nr; i++) {
+		struct directory_table_entry *d = &dt->entries[i];
+
+		/* name, including the trailing slash */
+		strbuf_add(sb, d->name, d->namelen);
+		strbuf_addch(sb, '\0');
+
+		/* position of the first entry */
+		put_be32(&buffer, d->pos);
+		strbuf_add(sb, &buffer, sizeof(uint32_t));
+
+		/* count */
+		put_be32(&buffer, d->nr);
+		strbuf_add(sb, &buffer, sizeof(uint32_t));
+
+		/* offset */
+		put_be32(&buffer, d->offset);
+		strbuf_add(sb, &buffer, sizeof(uint32_t));
+	}
+}
@@ -145,9 +145,14 @@ static struct used_atom {
 		} email_option;
 		struct refname_atom refname;
 		char *head;
+		struct {
+			const char *base;
+			unsigned int index;
+		} ahead_behind;
 	} u;
 } *used_atom;
 static int used_atom_cnt, need_tagged, need_symref;
+static unsigned int ahead_behind_atoms;
 
 /*
  * Expand string, append it to strbuf *sb, then return error code ret.
@@ -490,6 +495,16 @@ static int head_atom_parser(const struct ref_format *format, struct used_atom *a
 	return 0;
 }
 
+static int ahead_behind_atom_parser(const struct ref_format *format, struct used_atom *atom,
+				   const char *arg, struct strbuf *err)
+{
+	if (!arg)
+		return strbuf_addf_ret(err, -1, _("expected format: %%(ahead-behind:<committish>)"));
+	atom->u.ahead_behind.base = arg;
+	atom->u.ahead_behind.index = ahead_behind_atoms++;
+	return 0;
+}
+
 static struct {
 	const char *name;
 	info_source source;
@@ -538,6 +553,7 @@ static struct {
 	{ "if", SOURCE_NONE, FIELD_STR, if_atom_parser },
 	{ "then", SOURCE_NONE },
 	{ "else", SOURCE_NONE },
+	{ "ahead-behind", SOURCE_NONE, FIELD_ULONG, ahead_behind_atom_parser },
 	/*
 	 * Please update $__git_ref_fieldlist in git-completion.bash
 	 * when you add new atoms
@@ -1699,6 +1715,18 @@ static int populate_value(struct ref_array_item *ref, struct strbuf *err)
 				v->s = xstrdup("");
 			continue;
 		}
+		else if (starts_with(name, "ahead-behind:")) {
+			if (ref->counts) {
+				struct ahead_behind_count *count =
+					&ref->counts[atom->u.ahead_behind.index];
+				v->s = xstrfmt("%u %u", count->ahead, count->behind);
+				/* sort by the ahead count, then the behind count */
+				v->value = ((uintmax_t)count->ahead << 32) |
+					   count->behind;
+			} else
+				v->s = xstrdup("");
+			continue;
+		}
 		else if (starts_with(name, "symref"))
 			refname = get_symref(atom, ref);
 		else if (starts_with(name, "upstream")) {
@@ -1921,64 +1949,6 @@ static int filter_pattern_match(struct ref_filter *filter, const char *refname)
 	return match_pattern(filter, refname);
 }
 
-static int qsort_strcmp(const void *va, const void *vb)
-{
-	const char *a = *(const char **)va;
-	const char *b = *(const char **)vb;
-
-	return strcmp(a, b);
-}
-
-static void find_longest_prefixes_1(struct string_list *out,
-				  struct strbuf *prefix,
-				  const char **patterns, size_t nr)
-{
-	size_t i;
-
-	for (i = 0; i < nr; i++) {
-		char c = patterns[i][prefix->len];
-		if (!c || is_glob_special(c)) {
-			string_list_append(out, prefix->buf);
-			return;
-		}
-	}
-
-	i = 0;
-	while (i < nr) {
-		size_t end;
-
-		/*
-		* Set "end" to the index of the element _after_ the last one
-		* in our group.
-		*/
-		for (end = i + 1; end < nr; end++) {
-			if (patterns[i][prefix->len] != patterns[end][prefix->len])
-				break;
-		}
-
-		strbuf_addch(prefix, patterns[i][prefix->len]);
-		find_longest_prefixes_1(out, prefix, patterns + i, end - i);
-		strbuf_setlen(prefix, prefix->len - 1);
-
-		i = end;
-	}
-}
-
-static void find_longest_prefixes(struct string_list *out,
-				  const char **patterns)
-{
-	struct strvec sorted = STRVEC_INIT;
-	struct strbuf prefix = STRBUF_INIT;
-
-	strvec_pushv(&sorted, patterns);
-	QSORT(sorted.v, sorted.nr, qsort_strcmp);
-
-	find_longest_prefixes_1(out, &prefix, sorted.v, sorted.nr);
-
-	strvec_clear(&sorted);
-	strbuf_release(&prefix);
-}
-
 /*
  * This is the same as for_each_fullref_in(), but it tries to iterate
  * only over the patterns we'll care about. Note that it _doesn't_ do a full
@@ -1989,10 +1959,6 @@ static int for_each_fullref_in_pattern(struct ref_filter *filter,
 				       void *cb_data,
 				       int broken)
 {
-	struct string_list prefixes = STRING_LIST_INIT_DUP;
-	struct string_list_item *prefix;
-	int ret;
-
 	if (!filter->match_as_path) {
 		/*
 		 * in this case, the patterns are applied after
@@ -2016,16 +1982,8 @@ static int for_each_fullref_in_pattern(struct ref_filter *filter,
 		return for_each_fullref_in("", cb, cb_data, broken);
 	}
 
-	find_longest_prefixes(&prefixes, filter->name_patterns);
-
-	for_each_string_list_item(prefix, &prefixes) {
-		ret = for_each_fullref_in(prefix->string, cb, cb_data, broken);
-		if (ret)
-			break;
-	}
-
-	string_list_clear(&prefixes, 0);
-	return ret;
+	return for_each_fullref_in_prefixes(NULL, filter->name_patterns,
+					    cb, cb_data, broken);
 }
 
 /*
@@ -2197,6 +2155,7 @@ static int ref_filter_handler(const char *refname, const struct object_id *oid,
 static void free_array_item(struct ref_array_item *item)
 {
 	free((char *)item->symref);
+	free(item->counts);
 	if (item->value) {
 		int i;
 		for (i = 0; i < used_atom_cnt; i++)
@@ -2220,6 +2179,7 @@ void ref_array_clear(struct ref_array *array)
 		free((char *)used_atom[i].name);
 	FREE_AND_NULL(used_atom);
 	used_atom_cnt = 0;
+	ahead_behind_atoms = 0;
 
 	if (ref_to_worktree_map.worktrees) {
 		hashmap_free_entries(&(ref_to_worktree_map.map),
@@ -2342,6 +2302,53 @@ int filter_refs(struct ref_array *array, struct ref_filter *filter, unsigned int
 	return ret;
 }
 
+void filter_ahead_behind(struct ref_array *array)
+{
+	struct commit **tips;
+	struct ref_array_item **items;
+	struct ahead_behind_count *counts;
+	size_t i, j, nr = 0;
+
+	if (!ahead_behind_atoms || !array->nr)
+		return;
+
+	ALLOC_ARRAY(tips, array->nr);
+	ALLOC_ARRAY(items, array->nr);
+	for (i = 0; i < array->nr; i++) {
+		struct ref_array_item *item = array->items[i];
+		struct commit *commit;
+
+		commit = lookup_commit_reference_gently(the_repository,
+							&item->objectname, 1);
+		if (!commit)
+			continue;
+		CALLOC_ARRAY(item->counts, ahead_behind_atoms);
+		tips[nr] = commit;
+		items[nr] = item;
+		nr++;
+	}
+
+	ALLOC_ARRAY(counts, nr);
+	for (i = 0; i < used_atom_cnt; i++) {
+		struct used_atom *atom = &used_atom[i];
+		struct commit *base;
+
+		if (!starts_with(atom->name, "ahead-behind:"))
+			continue;
+		base = lookup_commit_reference_by_name(atom->u.ahead_behind.base);
+		if (!base)
+			die(_("failed to find '%s'"), atom->u.ahead_behind.base);
+
+		ahead_behind(the_repository, base, tips, nr, counts);
+		for (j = 0; j < nr; j++)
+			items[j]->counts[atom->u.ahead_behind.index] = counts[j];
+	}
+
+	free(counts);
+	free(items);
+	free(tips);
+}
+
 static int cmp_ref_sorting(struct ref_sorting *s, struct ref_array_item *a, struct ref_array_item *b)
 {
 	struct atom_value *va, *vb;
@@ -24,6 +24,7 @@
 #define FILTER_REFS_KIND_MASK      (FILTER_REFS_ALL | FILTER_REFS_DETACHED_HEAD)
 
 struct atom_value;
+struct ahead_behind_count;
 
 struct ref_sorting {
 	struct ref_sorting *next;
@@ -40,6 +41,7 @@ struct ref_array_item {
 	const char *symref;
 	struct commit *commit;
 	struct atom_value *value;
+	struct ahead_behind_count *counts;
 	char refname[FLEX_ARRAY];
 };
 
@@ -103,6 +105,11 @@ struct ref_format {
  * filtered refs in the ref_array structure.
  */
 int filter_refs(struct ref_array *array, struct ref_filter *filter, unsigned int type);
+/*
+ * Compute the values of all %(ahead-behind:<base>) atoms for the refs in
+ * the array in one batch per base; call after filter_refs().
+ */
+void filter_ahead_behind(struct ref_array *array);
 /*  Clear all memory allocated to ref_array */
 void ref_array_clear(struct ref_array *array);
 /*  Used to verify if the given format is correct and to parse out the used atoms */
@@ -347,6 +347,28 @@ int refs_for_each_fullref_in(struct ref_store *refs, const char *prefix,
 int for_each_fullref_in(const char *prefix, each_ref_fn fn, void *cb_data,
 			unsigned int broken);
 
+/**
+ * iterate all refs in "patterns" by partitioning patterns into disjoint sets
+ * and iterating the longest-common prefix of each set. Each prefix is
+ * looked up directly in the ref backends (a binary search in the
+ * packed-refs file), so refs outside of the requested prefixes are
+ * never visited.
+ *
+ * "namespace", if non-NULL, is prepended to each prefix before it is
+ * looked up; the refnames passed to "fn" still include it.
+ *
+ * callers should be prepared to ignore references that they did not ask for,
+ * as the patterns are matched only up to their first glob character.
+ */
+int refs_for_each_fullref_in_prefixes(struct ref_store *refs,
+				      const char *namespace,
+				      const char **patterns,
+				      each_ref_fn fn, void *cb_data,
+				      unsigned int broken);
+int for_each_fullref_in_prefixes(const char *namespace, const char **patterns,
+				 each_ref_fn fn, void *cb_data,
+				 unsigned int broken);
+
 /**
  * iterate refs from the respective area.
  */
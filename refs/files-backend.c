@@ -64,15 +64,47 @@ struct files_ref_store {
 
 	struct ref_cache *loose;
 
+	/*
+	 * The stat data of each loose reference directory at the time
+	 * it was read into `loose`, sorted by directory name. The
+	 * `util` of each item is a `struct loose_dir_stamp`.
+	 */
+	struct string_list loose_stamps;
+
+	/*
+	 * The symbolic references in `loose`. Their cached values
+	 * depend on other references, so they are resolved again
+	 * whenever we update references ourselves. Entries live in
+	 * the cache's arena, so pointers to entries that have since
+	 * been dropped from the tree are still safe to follow; such
+	 * entries are pruned before the others are resolved.
+	 */
+	struct ref_entry **loose_symrefs;
+	size_t loose_symrefs_nr, loose_symrefs_alloc;
+
 	struct ref_store *packed_ref_store;
 };
 
+struct loose_dir_stamp {
+	struct stat_data sd;
+	unsigned exists : 1;
+
+	/*
+	 * The directory was modified so recently when we read it that
+	 * a later modification might not change its stat data.
+	 */
+	unsigned racy : 1;
+};
+
 static void clear_loose_ref_cache(struct files_ref_store *refs)
 {
 	if (refs->loose) {
 		free_ref_cache(refs->loose);
 		refs->loose = NULL;
 	}
+	string_list_clear(&refs->loose_stamps, 1);
+	FREE_AND_NULL(refs->loose_symrefs);
+	refs->loose_symrefs_nr = refs->loose_symrefs_alloc = 0;
 }
 
 /*
@@ -89,6 +121,7 @@ static struct ref_store *files_ref_store_create(const char *gitdir,
 	ref_store->gitdir = xstrdup(gitdir);
 	base_ref_store_init(ref_store, &refs_be_files);
 	refs->store_flags = flags;
+	string_list_init(&refs->loose_stamps, 1);
 
 	get_common_dir_noenv(&sb, gitdir);
 	refs->gitcommondir = strbuf_detach(&sb, NULL);
@@ -232,6 +265,127 @@ static void add_per_worktree_entries_to_dir(struct ref_dir *dir, const char *dir
 	}
 }
 
+static void stamp_loose_dir(struct loose_dir_stamp *stamp,
+			    const char *path, int check_racy)
+{
+	struct stat st;
+	time_t now = time(NULL);
+
+	memset(stamp, 0, sizeof(*stamp));
+	if (lstat(path, &st))
+		return;
+	fill_stat_data(&stamp->sd, &st);
+	stamp->exists = 1;
+	stamp->racy = check_racy && st.st_mtime >= now;
+}
+
+/*
+ * Return true iff the directory at path looks different than when
+ * `stamp` was taken.
+ */
+static int loose_dir_changed(const struct loose_dir_stamp *stamp,
+			     const char *path)
+{
+	struct stat st;
+
+	if (lstat(path, &st))
+		return stamp->exists;
+	if (!stamp->exists || stamp->racy)
+		return 1;
+	return match_stat_data(&stamp->sd, &st);
+}
+
+static void record_loose_dir_stamp(struct files_ref_store *refs,
+				   const char *dirname, const char *path,
+				   int check_racy)
+{
+	struct string_list_item *item;
+
+	item = string_list_insert(&refs->loose_stamps, dirname);
+	if (!item->util)
+		item->util = xmalloc(sizeof(struct loose_dir_stamp));
+	stamp_loose_dir(item->util, path, check_racy);
+}
+
+/*
+ * Forget the stamps of dirname and of all directories below it.
+ */
+static void forget_loose_dir_stamps(struct files_ref_store *refs,
+				    const char *dirname)
+{
+	struct string_list *list = &refs->loose_stamps;
+	int first = string_list_find_insert_index(list, dirname, 1);
+	int end;
+
+	if (first < 0)
+		first = -1 - first;
+	for (end = first; end < list->nr; end++) {
+		if (!starts_with(list->items[end].string, dirname))
+			break;
+		free(list->items[end].util);
+		free(list->items[end].string);
+	}
+	if (end == first)
+		return;
+	MOVE_ARRAY(list->items + first, list->items + end, list->nr - end);
+	list->nr -= end - first;
+}
+
+/*
+ * Read the loose reference at refname the way it is stored in the
+ * loose ref cache, i.e., with symbolic references resolved. Return
+ * the flags for its `ref_entry`.
+ */
+static int read_loose_ref_for_cache(struct files_ref_store *refs,
+				    const char *refname,
+				    struct object_id *oid)
+{
+	int flag;
+
+	if (!refs_resolve_ref_unsafe(&refs->base, refname,
+				     RESOLVE_REF_READING, oid, &flag)) {
+		oidclr(oid);
+		flag |= REF_ISBROKEN;
+	} else if (is_null_oid(oid)) {
+		/*
+		 * It is so astronomically unlikely that null_oid is
+		 * the OID of an actual object that we consider its
+		 * appearance in a loose reference file to be repo
+		 * corruption (probably due to a software bug).
+		 */
+		flag |= REF_ISBROKEN;
+	}
+
+	if (check_refname_format(refname, REFNAME_ALLOW_ONELEVEL)) {
+		if (!refname_is_safe(refname))
+			die("loose refname is dangerous: %s", refname);
+		oidclr(oid);
+		flag |= REF_BAD_NAME | REF_ISBROKEN;
+	}
+	return flag;
+}
+
+static void remember_loose_symref(struct files_ref_store *refs,
+				  struct ref_entry *entry)
+{
+	ALLOC_GROW(refs->loose_symrefs, refs->loose_symrefs_nr + 1,
+		   refs->loose_symrefs_alloc);
+	refs->loose_symrefs[refs->loose_symrefs_nr++] = entry;
+}
+
+static void add_loose_ref_entry(struct files_ref_store *refs,
+				struct ref_dir *dir, const char *refname)
+{
+	struct object_id oid;
+	int flag = read_loose_ref_for_cache(refs, refname, &oid);
+	struct ref_entry *entry = create_ref_entry(dir->cache, refname,
+						   &oid, flag);
+
+	add_entry_to_dir(dir, entry);
+	if (flag & REF_ISSYMREF)
+		remember_loose_symref(refs, entry);
+}
+
 /*
  * Read the loose references from the namespace dirname into dir
  * (without recursing).  dirname must end with '/'.  dir must be the
@@ -252,6 +406,12 @@ static void loose_fill_ref_dir(struct ref_store *ref_store,
 	files_ref_path(refs, &path, dirname);
 	path_baselen = path.len;
 
+	/*
+	 * Take the stamp before reading, so that changes made while
+	 * we are reading are noticed later on:
+	 */
+	record_loose_dir_stamp(refs, dirname, path.buf, 1);
+
 	d = opendir(path.buf);
 	if (!d) {
 		strbuf_release(&path);
@@ -262,9 +422,8 @@ static void loose_fill_ref_dir(struct ref_store *ref_store,
 	strbuf_add(&refname, dirname, dirnamelen);
 
 	while ((de = readdir(d)) != NULL) {
-		struct object_id oid;
 		struct stat st;
-		int flag;
+		int dtype = DTYPE(de);
 
 		if (de->d_name[0] == '.')
 			continue;
@@ -272,41 +431,27 @@ static void loose_fill_ref_dir(struct ref_store *ref_store,
 			continue;
 		strbuf_addstr(&refname, de->d_name);
 		strbuf_addstr(&path, de->d_name);
-		if (stat(path.buf, &st) < 0) {
-			; /* silently ignore */
-		} else if (S_ISDIR(st.st_mode)) {
+
+		/*
+		 * Trust the type reported by readdir() where we can, to
+		 * avoid a stat() for every reference in the directory.
+		 */
+		if (dtype != DT_REG && dtype != DT_DIR) {
+			if (stat(path.buf, &st) < 0)
+				dtype = DT_UNKNOWN; /* silently ignore */
+			else if (S_ISDIR(st.st_mode))
+				dtype = DT_DIR;
+			else
+				dtype = DT_REG;
+		}
+
+		if (dtype == DT_DIR) {
 			strbuf_addch(&refname, '/');
 			add_entry_to_dir(dir,
 					 create_dir_entry(dir->cache, refname.buf,
 							  refname.len, 1));
-		} else {
-			if (!refs_resolve_ref_unsafe(&refs->base,
-						     refname.buf,
-						     RESOLVE_REF_READING,
-						     &oid, &flag)) {
-				oidclr(&oid);
-				flag |= REF_ISBROKEN;
-			} else if (is_null_oid(&oid)) {
-				/*
-				 * It is so astronomically unlikely
-				 * that null_oid is the OID of an
-				 * actual object that we consider its
-				 * appearance in a loose reference
-				 * file to be repo corruption
-				 * (probably due to a software bug).
-				 */
-				flag |= REF_ISBROKEN;
-			}
-
-			if (check_refname_format(refname.buf,
-						 REFNAME_ALLOW_ONELEVEL)) {
-				if (!refname_is_safe(refname.buf))
-					die("loose refname is dangerous: %s", refname.buf);
-				oidclr(&oid);
-				flag |= REF_BAD_NAME | REF_ISBROKEN;
-			}
-			add_entry_to_dir(dir,
-					 create_ref_entry(refname.buf, &oid, flag));
+		} else if (dtype == DT_REG) {
+			add_loose_ref_entry(refs, dir, refname.buf);
 		}
 		strbuf_setlen(&refname, dirnamelen);
 		strbuf_setlen(&path, path_baselen);
@@ -318,6 +463,106 @@ static void loose_fill_ref_dir(struct ref_store *ref_store,
 	add_per_worktree_entries_to_dir(dir, dirname);
 }
 
+/*
+ * Drop the cached contents of dirname, to be read again the next time
+ * they are needed.
+ */
+static void invalidate_loose_dir(struct files_ref_store *refs,
+				 const char *dirname)
+{
+	invalidate_ref_dir(refs->loose, dirname);
+	forget_loose_dir_stamps(refs, dirname);
+}
+
+/*
+ * Return true iff `entry` is still part of the loose ref cache, without
+ * reading any directories that are not cached.
+ */
+static int loose_ref_is_cached(struct files_ref_store *refs,
+			       struct ref_entry *entry)
+{
+	const char *slash = strrchr(entry->name, '/');
+	struct ref_dir *dir;
+	char *dirname;
+	int pos;
+
+	if (!slash)
+		return 0;
+	dirname = xmemdupz(entry->name, slash - entry->name + 1);
+	dir = find_complete_ref_dir(refs->loose, dirname);
+	free(dirname);
+	if (!dir)
+		return 0;
+	pos = search_ref_dir(dir, entry->name, strlen(entry->name));
+	return pos >= 0 && dir->entries[pos] == entry;
+}
+
+/*
+ * Resolve the cached symbolic references again, and forget those that
+ * have been dropped from the cache or are no longer symbolic.
+ */
+static void refresh_loose_symrefs(struct files_ref_store *refs)
+{
+	size_t i, nr = 0;
+
+	for (i = 0; i < refs->loose_symrefs_nr; i++) {
+		struct ref_entry *entry = refs->loose_symrefs[i];
+
+		if (!loose_ref_is_cached(refs, entry))
+			continue;
+		entry->flag = read_loose_ref_for_cache(refs, entry->name,
+						       &entry->u.value.oid);
+		if (entry->flag & REF_ISSYMREF)
+			refs->loose_symrefs[nr++] = entry;
+	}
+	refs->loose_symrefs_nr = nr;
+}
+
+/*
+ * Update the loose ref cache after this process has changed references.
+ * Rather than throwing the whole cache away, use the stat data of the
+ * cached directories to find those that changed, and read only these
+ * again.
+ *
+ * This includes the directories that we changed ourselves: we cannot
+ * tell our own changes from those that other processes made to the
+ * same directories at the same time, so we do not try to.
+ */
+static void update_loose_ref_cache(struct files_ref_store *refs)
+{
+	struct strbuf dirname = STRBUF_INIT;
+	struct strbuf path = STRBUF_INIT;
+	int j;
+
+	if (!refs->loose)
+		return;
+
+	for (j = 0; j < refs->loose_stamps.nr; j++) {
+		struct string_list_item *stamp = &refs->loose_stamps.items[j];
+
+		strbuf_reset(&path);
+		files_ref_path(refs, &path, stamp->string);
+		if (loose_dir_changed(stamp->util, path.buf)) {
+			strbuf_reset(&dirname);
+			strbuf_addstr(&dirname, stamp->string);
+			invalidate_loose_dir(refs, dirname.buf);
+			j--;
+		}
+	}
+
+	refresh_loose_symrefs(refs);
+
+	/*
+	 * Entries dropped from the cache stay in its arena; once they
+	 * outnumber the live ones, start over rather than keep them.
+	 */
+	if (ref_cache_is_wasteful(refs->loose))
+		clear_loose_ref_cache(refs);
+
+	strbuf_release(&dirname);
+	strbuf_release(&path);
+}
+
 static struct ref_cache *get_loose_ref_cache(struct files_ref_store *refs)
 {
 	if (!refs->loose) {
@@ -2798,7 +3043,6 @@ static int files_transaction_finish(struct ref_store *ref_store,
 			}
 		}
 		if (update->flags & REF_NEEDS_COMMIT) {
-			clear_loose_ref_cache(refs);
 			if (commit_ref(lock)) {
 				strbuf_addf(err, "couldn't set '%s'", lock->ref_name);
 				unlock_ref(lock);
@@ -2866,8 +3110,6 @@ static int files_transaction_finish(struct ref_store *ref_store,
 		}
 	}
 
-	clear_loose_ref_cache(refs);
-
 cleanup:
 	files_transaction_cleanup(refs, transaction);
 
@@ -2886,6 +3128,8 @@ static int files_transaction_finish(struct ref_store *ref_store,
 		}
 	}
 
+	update_loose_ref_cache(refs);
+
 	strbuf_release(&sb);
 	return ret;
 }
@@ -413,8 +413,10 @@ int do_for_each_repo_ref_iterator(struct repository *r, struct ref_iterator *ite
 	int retval = 0, ok;
 	struct ref_iterator *old_ref_iter = current_ref_iter;
 
+	trace2_timer_start(TRACE2_TIMER_ID_REFS_ITERATE);
 	current_ref_iter = iter;
 	while ((ok = ref_iterator_advance(iter)) == ITER_OK) {
+		trace2_counter_add(TRACE2_COUNTER_ID_REFS_ITERATED, 1);
 		retval = fn(r, iter->refname, iter->oid, iter->flags, cb_data);
 		if (retval) {
 			/*
@@ -429,6 +431,7 @@ int do_for_each_repo_ref_iterator(struct repository *r, struct ref_iterator *ite
 
 out:
 	current_ref_iter = old_ref_iter;
+	trace2_timer_stop(TRACE2_TIMER_ID_REFS_ITERATE);
 	if (ok == ITER_ERROR)
 		return -1;
 	return retval;
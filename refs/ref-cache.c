@@ -31,12 +31,29 @@ struct ref_dir *get_ref_dir(struct ref_entry *entry)
 	return dir;
 }
 
-struct ref_entry *create_ref_entry(const char *refname,
+/*
+ * Allocate a zeroed `ref_entry` with room for a `len`-byte name from
+ * the cache's arena and copy the name into it.
+ */
+static struct ref_entry *alloc_ref_entry(struct ref_cache *cache,
+					 const char *name, size_t len)
+{
+	struct ref_entry *entry;
+
+	entry = mem_pool_calloc(&cache->pool, 1,
+				st_add3(sizeof(*entry), len, 1));
+	memcpy(entry->name, name, len);
+	cache->nr_entries++;
+	return entry;
+}
+
+struct ref_entry *create_ref_entry(struct ref_cache *cache,
+				   const char *refname,
 				   const struct object_id *oid, int flag)
 {
 	struct ref_entry *ref;
 
-	FLEX_ALLOC_STR(ref, name, refname);
+	ref = alloc_ref_entry(cache, refname, strlen(refname));
 	oidcpy(&ref->u.value.oid, oid);
 	ref->flag = flag;
 	return ref;
@@ -49,13 +66,14 @@ struct ref_cache *create_ref_cache(struct ref_store *refs,
 
 	ret->ref_store = refs;
 	ret->fill_ref_dir = fill_ref_dir;
+	mem_pool_init(&ret->pool, 0);
 	ret->root = create_dir_entry(ret, "", 0, 1);
 	return ret;
 }
 
 static void clear_ref_dir(struct ref_dir *dir);
 
-static void free_ref_entry(struct ref_entry *entry)
+static void free_ref_entry(struct ref_cache *cache, struct ref_entry *entry)
 {
 	if (entry->flag & REF_DIR) {
 		/*
@@ -64,15 +82,22 @@ static void free_ref_entry(struct ref_entry *entry)
 		 */
 		clear_ref_dir(&entry->u.subdir);
 	}
-	free(entry);
+	/* The entry itself lives in the cache's arena. */
+	cache->nr_dead++;
 }
 
 void free_ref_cache(struct ref_cache *cache)
 {
-	free_ref_entry(cache->root);
+	free_ref_entry(cache, cache->root);
+	mem_pool_discard(&cache->pool, 0);
 	free(cache);
 }
 
+int ref_cache_is_wasteful(struct ref_cache *cache)
+{
+	return cache->nr_dead > cache->nr_entries - cache->nr_dead;
+}
+
 /*
  * Clear and free all entries in dir, recursively.
  */
@@ -80,7 +105,7 @@ static void clear_ref_dir(struct ref_dir *dir)
 {
 	int i;
 	for (i = 0; i < dir->nr; i++)
-		free_ref_entry(dir->entries[i]);
+		free_ref_entry(dir->cache, dir->entries[i]);
 	FREE_AND_NULL(dir->entries);
 	dir->sorted = dir->nr = dir->alloc = 0;
 }
@@ -91,12 +116,69 @@ struct ref_entry *create_dir_entry(struct ref_cache *cache,
 {
 	struct ref_entry *direntry;
 
-	FLEX_ALLOC_MEM(direntry, name, dirname, len);
+	direntry = alloc_ref_entry(cache, dirname, len);
 	direntry->u.subdir.cache = cache;
 	direntry->flag = REF_DIR | (incomplete ? REF_INCOMPLETE : 0);
 	return direntry;
 }
 
+int invalidate_ref_dir(struct ref_cache *cache, const char *dirname)
+{
+	struct ref_entry *entry = cache->root;
+	const char *slash;
+
+	for (slash = strchr(dirname, '/'); slash; slash = strchr(slash + 1, '/')) {
+		size_t len = slash - dirname + 1;
+		struct ref_dir *dir;
+		int pos;
+
+		/* Whatever lies below an unread directory is read afresh: */
+		if (entry->flag & REF_INCOMPLETE)
+			return 0;
+		dir = &entry->u.subdir;
+
+		pos = search_ref_dir(dir, dirname, len);
+		if (pos < 0) {
+			add_entry_to_dir(dir, create_dir_entry(cache, dirname,
+							       len, 1));
+			return 0;
+		}
+		entry = dir->entries[pos];
+		if (!(entry->flag & REF_DIR))
+			return 0;
+	}
+
+	if (entry->flag & REF_INCOMPLETE)
+		return 0;
+	clear_ref_dir(&entry->u.subdir);
+	entry->flag |= REF_INCOMPLETE;
+	return 1;
+}
+
+struct ref_dir *find_complete_ref_dir(struct ref_cache *cache,
+				      const char *dirname)
+{
+	struct ref_entry *entry = cache->root;
+	const char *slash;
+
+	for (slash = strchr(dirname, '/'); slash; slash = strchr(slash + 1, '/')) {
+		int pos;
+
+		if (entry->flag & REF_INCOMPLETE)
+			return NULL;
+		pos = search_ref_dir(&entry->u.subdir, dirname,
+				     slash - dirname + 1);
+		if (pos < 0)
+			return NULL;
+		entry = entry->u.subdir.entries[pos];
+		if (!(entry->flag & REF_DIR))
+			return NULL;
+	}
+	if (entry->flag & REF_INCOMPLETE)
+		return NULL;
+	return &entry->u.subdir;
+}
+
 static int ref_entry_cmp(const void *a, const void *b)
 {
 	struct ref_entry *one = *(struct ref_entry **)a;
@@ -243,7 +325,7 @@ int remove_entry_from_dir(struct ref_dir *dir, const char *refname)
 	dir->nr--;
 	if (dir->sorted > entry_index)
 		dir->sorted--;
-	free_ref_entry(entry);
+	free_ref_entry(dir->cache, entry);
 	return dir->nr;
 }
 
@@ -301,7 +383,7 @@ static void sort_ref_dir(struct ref_dir *dir)
 	for (i = 0, j = 0; j < dir->nr; j++) {
 		struct ref_entry *entry = dir->entries[j];
 		if (last && is_dup_ref(last, entry))
-			free_ref_entry(entry);
+			free_ref_entry(dir->cache, entry);
 		else
 			last = dir->entries[i++] = entry;
 	}
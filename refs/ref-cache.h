@@ -2,6 +2,7 @@
 #define REFS_REF_CACHE_H
 
 #include "cache.h"
+#include "mem-pool.h"
 
 struct ref_dir;
 struct ref_store;
@@ -25,6 +26,19 @@ struct ref_cache {
 	 * NULL.
 	 */
 	fill_ref_dir_fn *fill_ref_dir;
+
+	/*
+	 * Arena from which all of the `ref_entry`s in this cache are
+	 * allocated. Entries are never freed individually; the memory
+	 * is released all at once by `free_ref_cache()`.
+	 */
+	struct mem_pool pool;
+
+	/*
+	 * The number of entries allocated from `pool`, and how many of
+	 * them have since been dropped from the cache.
+	 */
+	size_t nr_entries, nr_dead;
 };
 
 /*
@@ -172,7 +186,8 @@ struct ref_entry *create_dir_entry(struct ref_cache *cache,
 				   const char *dirname, size_t len,
 				   int incomplete);
 
-struct ref_entry *create_ref_entry(const char *refname,
+struct ref_entry *create_ref_entry(struct ref_cache *cache,
+				   const char *refname,
 				   const struct object_id *oid, int flag);
 
 /*
@@ -192,6 +207,31 @@ struct ref_cache *create_ref_cache(struct ref_store *refs,
  */
 void free_ref_cache(struct ref_cache *cache);
 
+/*
+ * Return true iff most of the entries allocated for `cache` have been
+ * dropped from it, so that it would take less memory to read it anew.
+ */
+int ref_cache_is_wasteful(struct ref_cache *cache);
+
+/*
+ * Forget what is known about the directory `dirname` (which must end
+ * with a slash), so that it is filled again the next time it is
+ * accessed. If some of the directories leading up to `dirname` are
+ * complete but do not know about the next level yet, an incomplete
+ * entry is added for it instead. Nothing is done if `dirname` lies
+ * below a directory that has not been read yet. Return 1 if an
+ * existing directory was reset, 0 otherwise.
+ */
+int invalidate_ref_dir(struct ref_cache *cache, const char *dirname);
+
+/*
+ * Return the directory `dirname` (which must end with a slash) if it
+ * and all of the directories leading up to it have been read already,
+ * or NULL otherwise. Never reads anything.
+ */
+struct ref_dir *find_complete_ref_dir(struct ref_cache *cache,
+				      const char *dirname);
+
 /*
  * Add a ref_entry to the end of dir (unsorted).  Entry is always
  * stored directly in dir; no recursion into subdirectories is
@@ -39,6 +39,14 @@ void prepare_repo_settings(struct repository *r)
 		free(strval);
 	}
 
+	if (!repo_config_get_int(r, "core.untrackedscanthreads", &value))
+		r->settings.core_untracked_scan_threads = value;
+	UPDATE_DEFAULT_BOOL(r->settings.core_untracked_scan_threads, 0);
+
+	if (!repo_config_get_bool(r, "core.iouring", &value))
+		r->settings.core_io_uring = value;
+	UPDATE_DEFAULT_BOOL(r->settings.core_io_uring, 1);
+
 	if (!repo_config_get_string(r, "fetch.negotiationalgorithm", &strval)) {
 		if (!strcasecmp(strval, "skipping"))
 			r->settings.fetch_negotiation_algorithm = FETCH_NEGOTIATION_SKIPPING;
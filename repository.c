@@ -267,6 +267,16 @@ int repo_read_index(struct repository *repo)
 	return read_index_from(repo->index, repo->index_file, repo->gitdir);
 }
 
+int repo_read_index_subtree(struct repository *repo,
+			    const char *prefix, int prefixlen)
+{
+	if (!repo->index)
+		repo->index = xcalloc(1, sizeof(*repo->index));
+
+	return read_index_subtree_from(repo->index, repo->index_file,
+				       repo->gitdir, prefix, prefixlen);
+}
+
 int repo_hold_locked_index(struct repository *repo,
 			   struct lock_file *lf,
 			   int flags)
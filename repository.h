@@ -36,6 +36,8 @@ struct repo_settings {
 
 	int index_version;
 	enum untracked_cache_setting core_untracked_cache;
+	int core_untracked_scan_threads;
+	int core_io_uring;
 
 	int pack_use_sparse;
 	enum fetch_negotiation_setting fetch_negotiation_algorithm;
@@ -182,6 +184,14 @@ void repo_clear(struct repository *repo);
  * populated then the number of entries will simply be returned.
  */
 int repo_read_index(struct repository *repo);
+
+/*
+ * Like repo_read_index(), but allows reading only the part of the index
+ * below `prefix`; see read_index_subtree_from().  Only meant for read-only
+ * commands that do not look at entries outside of `prefix`.
+ */
+int repo_read_index_subtree(struct repository *repo,
+			    const char *prefix, int prefixlen);
 int repo_hold_locked_index(struct repository *repo,
 			   struct lock_file *lf,
 			   int flags);
@@ -0,0 +1,209 @@
+#include "cache.h"
+#include "pkt-line.h"
+#include "resident.h"
+#include "sigchain.h"
+#include "unix-socket.h"
+
+#ifndef NO_UNIX_SOCKETS
+
+int resident_send_verb(int fd, char verb, const int *fds, int nr)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(3 * sizeof(int))];
+	} control;
+	ssize_t ret;
+
+	if (nr > 3)
+		BUG("cannot send %d file descriptors", nr);
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &verb;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if (nr) {
+		struct cmsghdr *cmsg;
+
+		memset(&control, 0, sizeof(control));
+		msg.msg_control = control.buf;
+		msg.msg_controllen = CMSG_SPACE(nr * sizeof(int));
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(nr * sizeof(int));
+		memcpy(CMSG_DATA(cmsg), fds, nr * sizeof(int));
+	}
+
+	do {
+		ret = sendmsg(fd, &msg, 0);
+	} while (ret < 0 && errno == EINTR);
+	return ret == 1 ? 0 : -1;
+}
+
+int resident_receive_verb(int fd, int *fds, int nr, int *nr_received)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(3 * sizeof(int))];
+	} control;
+	char verb;
+	ssize_t ret;
+
+	if (nr > 3)
+		BUG("cannot receive %d file descriptors", nr);
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &verb;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	do {
+		ret = recvmsg(fd, &msg, 0);
+	} while (ret < 0 && errno == EINTR);
+	if (ret != 1)
+		return -1;
+
+	*nr_received = 0;
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		int *received = (int *)CMSG_DATA(cmsg);
+		int i, n;
+
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+		    cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+		n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (i = 0; i < n; i++) {
+			if (*nr_received < nr)
+				fds[(*nr_received)++] = received[i];
+			else
+				close(received[i]);
+		}
+	}
+	if (msg.msg_flags & MSG_CTRUNC) {
+		while (*nr_received)
+			close(fds[--(*nr_received)]);
+		return -1;
+	}
+	return (unsigned char)verb;
+}
+
+static int fits_in_packet(const char *prefix, const char *s)
+{
+	return strlen(prefix) + strlen(s) <= LARGE_PACKET_DATA_MAX;
+}
+
+static int send_request(int fd, const char *cwd, const char **argv)
+{
+	extern char **environ;
+	static const int std_fds[] = { 0, 1, 2 };
+	struct strbuf buf = STRBUF_INIT;
+	char **e;
+	int ret;
+
+	packet_buf_write(&buf, "cwd %s", cwd);
+	for (e = environ; *e; e++)
+		packet_buf_write(&buf, "env %s", *e);
+	for (; *argv; argv++)
+		packet_buf_write(&buf, "arg %s", *argv);
+	packet_buf_flush(&buf);
+
+	ret = resident_send_verb(fd, RESIDENT_RUN, std_fds, 3) < 0 ||
+	      write_in_full(fd, buf.buf, buf.len) < 0 ||
+	      shutdown(fd, SHUT_WR) < 0 ? -1 : 0;
+	strbuf_release(&buf);
+	return ret;
+}
+
+int run_resident_command(const char **argv)
+{
+	extern char **environ;
+	const char *path = getenv(RESIDENT_SOCKET_ENVIRONMENT);
+	struct strbuf cwd = STRBUF_INIT;
+	char *line;
+	const char *p;
+	char **e;
+	int i, fd, len, ret = -1;
+
+	if (!path || !*path)
+		return -1;
+
+	/* the request has to fit into pkt-lines */
+	if (strbuf_getcwd(&cwd) || !fits_in_packet("cwd ", cwd.buf))
+		goto out;
+	for (e = environ; *e; e++)
+		if (!fits_in_packet("env ", *e))
+			goto out;
+	for (i = 0; argv[i]; i++)
+		if (!fits_in_packet("arg ", argv[i]))
+			goto out;
+
+	fd = unix_stream_connect(path);
+	if (fd < 0)
+		goto out;
+
+	sigchain_push(SIGPIPE, SIG_IGN);
+	if (send_request(fd, cwd.buf, argv) < 0) {
+		sigchain_pop(SIGPIPE);
+		close(fd);
+		goto out;
+	}
+	sigchain_pop(SIGPIPE);
+
+	/*
+	 * Once the request is sent, the command may have run; we
+	 * cannot fall back to running it again.
+	 */
+	len = packet_read_line_gently(fd, NULL, &line);
+	close(fd);
+	if (len < 0 || !line)
+		die(_("resident server at '%s' hung up"), path);
+
+	if (skip_prefix(line, "exit ", &p)) {
+		ret = atoi(p);
+	} else if (skip_prefix(line, "signal ", &p)) {
+		int sig = atoi(p);
+
+		signal(sig, SIG_DFL);
+		raise(sig);
+		ret = 128 + sig;
+	} else if (skip_prefix(line, "fallback ", &p)) {
+		trace2_data_string("resident", NULL, "fallback", p);
+	} else {
+		die(_("resident server sent unexpected response '%s'"), line);
+	}
+
+out:
+	strbuf_release(&cwd);
+	return ret;
+}
+
+#else
+
+int resident_send_verb(int fd, char verb, const int *fds, int nr)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int resident_receive_verb(int fd, int *fds, int nr, int *nr_received)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int run_resident_command(const char **argv)
+{
+	return -1;
+}
+
+#endif /* NO_UNIX_SOCKETS */
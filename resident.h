@@ -0,0 +1,56 @@
+#ifndef RESIDENT_H
+#define RESIDENT_H
+
+/*
+ * Client side of "git resident", a per-repository server that keeps
+ * the configuration, pack indexes and commit-graph of the repository
+ * loaded, and runs read-only plumbing commands for its clients.
+ *
+ * A client connects to the socket named by $GIT_RESIDENT_SOCKET and
+ * sends a one-byte verb, with its stdin, stdout and stderr attached
+ * for RESIDENT_RUN.  A run request continues with pkt-lines:
+ *
+ *	cwd <directory>
+ *	env <name>=<value>	(the whole environment of the client)
+ *	arg <argument>		(argv, starting with the command name)
+ *	flush
+ *
+ * after which the client shuts down its side of the connection for
+ * writing.
+ * The server answers with a single pkt-line:
+ *
+ *	exit <code>		the command ran and exited with <code>
+ *	signal <number>		the command ran and was killed by <signal>
+ *	fallback <reason>	the client has to run the command itself
+ *	ok			answer to RESIDENT_PING and RESIDENT_STOP
+ */
+
+#define RESIDENT_SOCKET_ENVIRONMENT "GIT_RESIDENT_SOCKET"
+
+#define RESIDENT_RUN 'r'
+#define RESIDENT_PING 'p'
+#define RESIDENT_STOP 's'
+
+/*
+ * Send `verb` over the unix socket `fd`, along with `nr` (at most 3)
+ * file descriptors.  Returns 0 on success, -1 on error with errno set.
+ */
+int resident_send_verb(int fd, char verb, const int *fds, int nr);
+
+/*
+ * Receive a verb sent by resident_send_verb().  Up to `nr` file
+ * descriptors are stored in `fds`, and their number in `*nr_received`.
+ * Returns the verb, or -1 on error.
+ */
+int resident_receive_verb(int fd, int *fds, int nr, int *nr_received);
+
+/*
+ * Have the server named by $GIT_RESIDENT_SOCKET run the command in
+ * `argv`, if there is one and it agrees to.  Returns -1 if the caller
+ * has to run the command itself.  Otherwise returns the exit code of
+ * the command; if the command was killed by a signal, the calling
+ * process is killed by the same signal.
+ */
+int run_resident_command(const char **argv);
+
+#endif /* RESIDENT_H */
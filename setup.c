@@ -1197,6 +1197,21 @@ int discover_git_directory(struct strbuf *commondir,
 	return 0;
 }
 
+static int setup_preset;
+static struct strbuf preset_cwd = STRBUF_INIT;
+
+void setup_git_directory_preset(const char *prefix)
+{
+	if (!startup_info->have_repository)
+		BUG("setup_git_directory_preset() without a repository");
+
+	setup_preset = 1;
+	if (strbuf_getcwd(&preset_cwd))
+		die_errno(_("Unable to read current working directory"));
+	startup_info->prefix = prefix;
+	setenv(GIT_PREFIX_ENVIRONMENT, prefix ? prefix : "", 1);
+}
+
 const char *setup_git_directory_gently(int *nongit_ok)
 {
 	static struct strbuf cwd = STRBUF_INIT;
@@ -1204,6 +1219,15 @@ const char *setup_git_directory_gently(int *nongit_ok)
 	const char *prefix = NULL;
 	struct repository_format repo_fmt = REPOSITORY_FORMAT_INIT;
 
+	if (setup_preset) {
+		/* go where setting up would have taken us */
+		if (chdir(preset_cwd.buf))
+			die_errno(_("cannot come back to cwd"));
+		if (nongit_ok)
+			*nongit_ok = 0;
+		return startup_info->prefix;
+	}
+
 	/*
 	 * We may have read an incomplete configuration before
 	 * setting-up the git directory. If so, clear the cache so
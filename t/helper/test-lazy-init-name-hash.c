@@ -9,6 +9,7 @@ static int dump;
 static int perf;
 static int analyze;
 static int analyze_step;
+static int lookup;
 
 /*
  * Dump the contents of the "dir" and "name" hash tables to stdout.
@@ -52,6 +53,37 @@ static void dump_run(void)
 	discard_cache();
 }
 
+/*
+ * Look up each name read from stdin as a file and as a directory,
+ * and print what was found, and whether the hash tables were used.
+ * With "single", they are built first; otherwise only if there are
+ * many lookups.
+ */
+static void lookup_run(void)
+{
+	struct strbuf buf = STRBUF_INIT;
+
+	read_cache();
+	if (single)
+		test_lazy_init_name_hash(&the_index, 0);
+
+	while (strbuf_getline(&buf, stdin) != EOF) {
+		const struct cache_entry *exact, *icase;
+		int dir = index_dir_exists(&the_index, buf.buf, buf.len);
+
+		exact = index_file_exists(&the_index, buf.buf, buf.len, 0);
+		icase = index_file_exists(&the_index, buf.buf, buf.len, 1);
+		printf("%s file=%s icase=%s dir=%d", buf.buf,
+		       exact ? exact->name : "-", icase ? icase->name : "-", dir);
+		adjust_dirname_case(&the_index, buf.buf);
+		printf(" adjusted=%s\n", buf.buf);
+	}
+
+	printf("hashed=%d\n", the_index.name_hash_initialized);
+	strbuf_release(&buf);
+	discard_cache();
+}
+
 /*
  * Run the single or multi threaded version "count" times and
  * report on the time taken.
@@ -189,6 +221,7 @@ int cmd__lazy_init_name_hash(int argc, const char **argv)
 		"test-tool lazy-init-name-hash -a a [--step s] [-c c]",
 		"test-tool lazy-init-name-hash (-s | -m) [-c c]",
 		"test-tool lazy-init-name-hash -s -m [-c c]",
+		"test-tool lazy-init-name-hash -l [-s] <names",
 		NULL
 	};
 	struct option options[] = {
@@ -199,6 +232,7 @@ int cmd__lazy_init_name_hash(int argc, const char **argv)
 		OPT_BOOL('p', "perf", &perf, "compare single vs multi"),
 		OPT_INTEGER('a', "analyze", &analyze, "analyze different multi sizes"),
 		OPT_INTEGER(0, "step", &analyze_step, "analyze step factor"),
+		OPT_BOOL('l', "lookup", &lookup, "look up names from stdin"),
 		OPT_END(),
 	};
 	const char *prefix;
@@ -213,6 +247,13 @@ int cmd__lazy_init_name_hash(int argc, const char **argv)
 	 */
 	ignore_case = 1;
 
+	if (lookup) {
+		if (dump || perf || analyze > 0 || multi)
+			die("cannot combine lookup with dump, perf, analyze or multi");
+		lookup_run();
+		return 0;
+	}
+
 	if (dump) {
 		if (perf || analyze > 0)
 			die("cannot combine dump, perf, or analyze");
@@ -4,6 +4,7 @@
 #include "run-command.h"
 #include "exec-cmd.h"
 #include "config.h"
+#include "thread-utils.h"
 
 typedef int(fn_unit_test)(int argc, const char **argv);
 
@@ -198,6 +199,135 @@ static int ut_006data(int argc, const char **argv)
 	return 0;
 }
 
+/*
+ * Run the "test1" timer for <count> intervals of <ms_delay> each,
+ * nesting a second start and stop inside each interval.
+ *
+ * Test harness can confirm:
+ * [] a single "timer" event with the interval count of the process,
+ *    unaffected by the nested starts.
+ */
+static int ut_007timer(int argc, const char **argv)
+{
+	const char *usage_error = "expect <count> <ms_delay>";
+	int count = 0;
+	int delay = 0;
+	int k;
+
+	if (argc != 2 || get_i(&count, argv[0]) || get_i(&delay, argv[1]))
+		die("%s", usage_error);
+
+	for (k = 0; k < count; k++) {
+		trace2_timer_start(TRACE2_TIMER_ID_TEST1);
+		trace2_timer_start(TRACE2_TIMER_ID_TEST1);
+		sleep_millisec(delay);
+		trace2_timer_stop(TRACE2_TIMER_ID_TEST1);
+		trace2_timer_stop(TRACE2_TIMER_ID_TEST1);
+	}
+
+	return 0;
+}
+
+/*
+ * Add each of the given values to the "test1" counter.
+ *
+ * Test harness can confirm:
+ * [] a single "counter" event with the sum of the values.
+ */
+static int ut_008counter(int argc, const char **argv)
+{
+	const char *usage_error = "expect <value>+";
+	int value;
+
+	if (!argc)
+		die("%s", usage_error);
+
+	for (; argc; argc--, argv++) {
+		if (get_i(&value, argv[0]))
+			die("%s", usage_error);
+		trace2_counter_add(TRACE2_COUNTER_ID_TEST1, value);
+	}
+
+	return 0;
+}
+
+struct ut_009_data {
+	int count;
+	int delay;
+	int announce;
+};
+
+static void *ut_009thread_proc(void *_data)
+{
+	struct ut_009_data *data = _data;
+	int k;
+
+	if (data->announce)
+		trace2_thread_start("ut_009");
+
+	for (k = 0; k < data->count; k++) {
+		trace2_timer_start(TRACE2_TIMER_ID_TEST2);
+		sleep_millisec(data->delay);
+		trace2_timer_stop(TRACE2_TIMER_ID_TEST2);
+		trace2_counter_add(TRACE2_COUNTER_ID_TEST2, 1);
+	}
+
+	if (data->announce)
+		trace2_thread_exit();
+	return NULL;
+}
+
+static int run_ut_009_threads(int argc, const char **argv, int announce)
+{
+	const char *usage_error = "expect <threads> <count> <ms_delay>";
+	struct ut_009_data data;
+	pthread_t *pids;
+	int nr_threads = 0;
+	int k;
+
+	if (argc != 3 || get_i(&nr_threads, argv[0]) || nr_threads < 1 ||
+	    get_i(&data.count, argv[1]) || get_i(&data.delay, argv[2]))
+		die("%s", usage_error);
+	data.announce = announce;
+
+	CALLOC_ARRAY(pids, nr_threads);
+	for (k = 0; k < nr_threads; k++)
+		if (pthread_create(&pids[k], NULL, ut_009thread_proc, &data))
+			die("failed to create thread[%d]", k);
+	for (k = 0; k < nr_threads; k++)
+		if (pthread_join(pids[k], NULL))
+			die("failed to join thread[%d]", k);
+	free(pids);
+
+	return 0;
+}
+
+/*
+ * Run <threads> threads that each run the "test2" timer for <count>
+ * intervals of <ms_delay> each, and add <count> to the "test2" counter.
+ *
+ * Test harness can confirm:
+ * [] a "th_timer" and a "th_counter" event for each thread.
+ * [] a "timer" and a "counter" event with the totals of all threads.
+ */
+static int ut_009threads(int argc, const char **argv)
+{
+	return run_ut_009_threads(argc, argv, 1);
+}
+
+/*
+ * Like 009threads, but the threads do not call trace2_thread_start()
+ * and trace2_thread_exit(), as most thread-procs in git do not.
+ *
+ * Test harness can confirm:
+ * [] no "th_timer" and "th_counter" events.
+ * [] a "timer" and a "counter" event with the totals of all threads.
+ */
+static int ut_010quiet_threads(int argc, const char **argv)
+{
+	return run_ut_009_threads(argc, argv, 0);
+}
+
 /*
  * Usage:
  *     test-tool trace2 <ut_name_1> <ut_usage_1>
@@ -214,6 +344,10 @@ static struct unit_test ut_table[] = {
 	{ ut_004child,    "004child",  "[<child_command_line>]" },
 	{ ut_005exec,     "005exec",   "<git_command_args>" },
 	{ ut_006data,     "006data",   "[<category> <key> <value>]+" },
+	{ ut_007timer,    "007timer",  "<count> <ms_delay>" },
+	{ ut_008counter,  "008counter", "<value>+" },
+	{ ut_009threads,  "009threads", "<threads> <count> <ms_delay>" },
+	{ ut_010quiet_threads, "010quiet_threads", "<threads> <count> <ms_delay>" },
 };
 /* clang-format on */
 
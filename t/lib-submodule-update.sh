@@ -175,6 +175,8 @@ test_git_directory_is_unchanged () {
 		# "$1/.git/config" lacks it...
 		git config --unset core.worktree
 	) &&
+	# snapshots of the configuration are taken where each is read
+	rm -f ".git/modules/$1/config.snapshot" "$1/.git/config.snapshot" &&
 	diff -r ".git/modules/$1" "$1/.git" &&
 	(
 		# ... and then restore.
@@ -11,4 +11,23 @@ test_perf "read_cache/discard_cache $count times" "
 	test-tool read-cache $count
 "
 
+test_expect_success 'find a directory to list' '
+	dir=$(git ls-files | sed -n "s,/[^/]*\$,/,p" | sort | uniq -c |
+		sort -n | tail -n 1 | sed "s/^ *[0-9]* //") &&
+	test -n "$dir" &&
+	echo "$dir" >dir
+'
+
+test_perf "ls-files <dir>" "
+	git ls-files \"\$(cat dir)\" >/dev/null
+"
+
+test_expect_success 'write a directory table' '
+	git -c index.recordDirectoryTable=true update-index --force-write-index
+'
+
+test_perf "ls-files <dir> with a directory table" "
+	git ls-files \"\$(cat dir)\" >/dev/null
+"
+
 test_done
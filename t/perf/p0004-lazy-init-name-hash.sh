@@ -53,4 +53,21 @@ test_perf REPO_BIG_ENOUGH_FOR_MULTI "multi-threaded, $desc" "
 	test-tool lazy-init-name-hash --multi --count=$count
 "
 
+test_expect_success 'pick a few names to look up' '
+	git ls-files >all &&
+	nr=$(wc -l <all) &&
+	for n in 1 2 3 4 5 6 7 8 9 10
+	do
+		sed -n "$(($n * $nr / 11 + 1))p" all || return 1
+	done >names
+'
+
+test_perf "look up a few names, building the hash tables" "
+	test-tool lazy-init-name-hash --lookup --single <names
+"
+
+test_perf "look up a few names on demand" "
+	test-tool lazy-init-name-hash --lookup <names
+"
+
 test_done
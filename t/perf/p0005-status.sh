@@ -46,4 +46,22 @@ test_perf "read-tree status br_ballast ($nr_files)" '
 	git status
 '
 
+test_perf "status -uall, single-threaded scan ($nr_files)" '
+	git -c core.untrackedScanThreads=1 -c core.untrackedCache=false \
+		status -uall
+'
+
+test_perf "status -uall, threaded scan ($nr_files)" '
+	git -c core.untrackedScanThreads=0 -c core.untrackedCache=false \
+		status -uall
+'
+
+test_perf "status, preload with io_uring ($nr_files)" '
+	git -c core.ioUring=true status -uno
+'
+
+test_perf "status, preload with threads ($nr_files)" '
+	git -c core.ioUring=false status -uno
+'
+
 test_done
@@ -26,4 +26,23 @@ test_perf "write_locked_index $count times ($nr_files files)" "
 	test-tool write-cache $count
 "
 
+test_expect_success "pick a file to update" '
+	git ls-files | head -n 1 >file
+'
+
+test_perf "update-index of one changed file" "
+	test-tool chmtime +1 \"\$(cat file)\" &&
+	git update-index \"\$(cat file)\"
+"
+
+test_expect_success "enable index.deltaLog" '
+	git config index.deltaLog true &&
+	git update-index --force-write-index
+'
+
+test_perf "update-index of one changed file with index.deltaLog" "
+	test-tool chmtime +1 \"\$(cat file)\" &&
+	git update-index \"\$(cat file)\"
+"
+
 test_done
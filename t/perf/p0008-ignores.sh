@@ -0,0 +1,43 @@
+#!/bin/sh
+
+test_description="Tests performance of matching paths against long ignore lists"
+
+. ./perf-lib.sh
+
+test_perf_fresh_repo
+
+test_expect_success 'setup' '
+	for i in $(test_seq 1 100)
+	do
+		mkdir dir$i &&
+		for j in $(test_seq 1 50)
+		do
+			>dir$i/file$j.c &&
+			>dir$i/file$j.ext$j || return 1
+		done || return 1
+	done &&
+	for i in $(test_seq 1 200)
+	do
+		echo "name$i" &&
+		echo "*.ext$i" &&
+		echo "/top$i/" &&
+		echo "gen$i/*.tmp" || return 1
+	done >.gitignore &&
+	echo "[Bb]uild*" >>.gitignore &&
+	git add .gitignore &&
+	git ls-files -o --exclude-standard >/dev/null
+'
+
+test_perf 'ls-files -o with a long .gitignore' '
+	git ls-files -o --exclude-standard
+'
+
+test_perf 'status with a long .gitignore' '
+	git -c core.untrackedCache=false status -uall
+'
+
+test_perf 'check-ignore with a long .gitignore' '
+	git ls-files -o | git check-ignore --stdin -n -v
+'
+
+test_done
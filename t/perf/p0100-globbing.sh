@@ -40,4 +40,11 @@ do
 	'
 done
 
+for i in $test_globs_small
+do
+	test_perf "ignore glob((a*)^nb) against file (a^100).t; n = $i" '
+		git ls-files -o -x "$(cat refglob.'$i')b"
+	'
+done
+
 test_done
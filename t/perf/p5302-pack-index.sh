@@ -50,4 +50,17 @@ test_perf 'index-pack default number of threads' '
 	GIT_DIR=repo.git git index-pack --stdin < $PACK
 '
 
+test_expect_success 'repack with pack.fullPathHash' '
+	git -c pack.fullPathHash=true repack -adf &&
+	PACK=$(ls .git/objects/pack/*.pack | head -n1) &&
+	test -f "$PACK" &&
+	export PACK
+'
+
+test_perf 'index-pack default number of threads (pack.fullPathHash)' '
+	rm -rf repo.git &&
+	git init --bare repo.git &&
+	GIT_DIR=repo.git git index-pack --stdin < $PACK
+'
+
 test_done
@@ -19,6 +19,22 @@ test_perf 'repack to disk' '
 	git repack -ad
 '
 
+test_perf 'repack to disk from scratch (pack.fullPathHash)' '
+	git -c pack.fullPathHash=true repack -adf
+'
+
+test_size 'pack size (pack.fullPathHash)' '
+	cat .git/objects/pack/pack-*.pack | wc -c
+'
+
+test_perf 'repack to disk from scratch' '
+	git repack -adf
+'
+
+test_size 'pack size' '
+	cat .git/objects/pack/pack-*.pack | wc -c
+'
+
 test_perf 'simulated clone' '
 	git pack-objects --stdout --all </dev/null >/dev/null
 '
@@ -32,4 +32,12 @@ test_perf 'ls-files -o' '
 	git ls-files -o
 '
 
+test_perf 'ls-files -o, single-threaded scan' '
+	git -c core.untrackedScanThreads=1 ls-files -o
+'
+
+test_perf 'clean many untracked sub dirs, single-threaded scan' '
+	git -c core.untrackedScanThreads=1 clean -n -q -f -f -d 100000_sub_dirs/
+'
+
 test_done
@@ -107,6 +107,23 @@ test_expect_success 'attribute test' '
 	attr_check a/b/d/yes unspecified
 '
 
+test_expect_success 'checking many paths at once gives the same answers' '
+	paths="f a/f a/c/f a/g a/i a/b/g a/b/h a/b/d/g a/b/d/no a/b/d/yes" &&
+	paths="$paths b/g onoff offon no A/e/F" &&
+	for p in $paths
+	do
+		git check-attr test notest -- $p || return 1
+	done >expect &&
+	git check-attr test notest -- $paths >actual &&
+	test_cmp expect actual &&
+	for p in $paths
+	do
+		git check-attr -a -- $p || return 1
+	done >expect &&
+	git check-attr -a -- $paths >actual &&
+	test_cmp expect actual
+'
+
 test_expect_success 'attribute matching is case sensitive when core.ignorecase=0' '
 
 	attr_check F unspecified "-c core.ignorecase=0" &&
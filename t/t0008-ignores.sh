@@ -865,4 +865,45 @@ test_expect_success 'info/exclude trumps core.excludesfile' '
 	test_cmp expect actual
 '
 
+test_expect_success 'long ignore lists still honor the last match' '
+	mkdir -p long/build long/doc long/src &&
+	cat >long/.gitignore <<-\EOF &&
+	*.o
+	!keep.o
+	build/
+	/doc/*.html
+	!/doc/index.html
+	core
+	*.tmp
+	!important.tmp
+	src/*.c
+	!src/main.c
+	*~
+	keep.o
+	doc/a*
+	[Tt]ags
+	EOF
+	cat >expect <<-\EOF &&
+	long/.gitignore:1:*.o	long/a.o
+	long/.gitignore:12:keep.o	long/keep.o
+	long/.gitignore:3:build/	long/build
+	long/.gitignore:1:*.o	long/doc/build.o
+	long/.gitignore:13:doc/a*	long/doc/a.html
+	long/.gitignore:4:/doc/*.html	long/doc/b.html
+	long/.gitignore:5:!/doc/index.html	long/doc/index.html
+	long/.gitignore:9:src/*.c	long/src/x.c
+	long/.gitignore:10:!src/main.c	long/src/main.c
+	::	long/src/doc/b.html
+	long/.gitignore:6:core	long/src/core
+	long/.gitignore:7:*.tmp	long/x.tmp
+	long/.gitignore:8:!important.tmp	long/important.tmp
+	long/.gitignore:14:[Tt]ags	long/Tags
+	long/.gitignore:11:*~	long/file~
+	::	long/other.txt
+	EOF
+	sed -e "s/^[^	]*	//" expect >paths &&
+	git check-ignore -v -n --stdin <paths >actual &&
+	test_cmp expect actual
+'
+
 test_done
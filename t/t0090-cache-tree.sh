@@ -132,6 +132,24 @@ test_expect_success 'second commit has cache-tree' '
 	test_cache_tree
 '
 
+test_expect_success 'diff-index --cached uses a valid cache-tree' '
+	test_when_finished "git reset --hard" &&
+	test_cache_tree &&
+	GIT_TRACE_PERFORMANCE="$(pwd)/perf.log" \
+		git diff-index --cached --exit-code HEAD &&
+	! grep traverse_trees perf.log &&
+	echo "I changed this file" >foo &&
+	git add foo &&
+	git diff-index --cached --name-only HEAD >actual &&
+	echo foo >expect &&
+	test_cmp expect actual &&
+	git diff-index --cached --name-only HEAD^ >actual &&
+	git diff-tree --name-only HEAD^ HEAD >expect &&
+	echo foo >>expect &&
+	sort -u expect >expect.sorted &&
+	test_cmp expect.sorted actual
+'
+
 test_expect_success PERL 'commit --interactive gives cache-tree on partial commit' '
 	cat <<-\EOT >foo.c &&
 	int foo()
@@ -150,6 +150,48 @@ test_expect_success 'perf stream, child processes' '
 	test_cmp expect actual
 '
 
+test_expect_success TRACE2_TIMERS 'perf stream, timer' '
+	test_when_finished "rm trace.perf actual" &&
+	GIT_TRACE2_PERF="$(pwd)/trace.perf" test-tool trace2 007timer 5 1 &&
+	perl "$TEST_DIRECTORY/t0211/scrub_perf.perl" <trace.perf >actual &&
+	grep "^d0|main|timer|||_T_REL_|test|name:test1 intervals:5 min:" actual &&
+	! grep th_timer actual
+'
+
+test_expect_success TRACE2_TIMERS 'perf stream, counter' '
+	test_when_finished "rm trace.perf actual" &&
+	GIT_TRACE2_PERF="$(pwd)/trace.perf" test-tool trace2 008counter 5 15 &&
+	perl "$TEST_DIRECTORY/t0211/scrub_perf.perl" <trace.perf >actual &&
+	grep "^d0|main|counter||||test|name:test1 value:20$" actual
+'
+
+test_expect_success TRACE2_TIMERS,PTHREADS 'perf stream, per-thread timer and counter' '
+	test_when_finished "rm trace.perf actual" &&
+	GIT_TRACE2_PERF="$(pwd)/trace.perf" test-tool trace2 009threads 3 2 1 &&
+	perl "$TEST_DIRECTORY/t0211/scrub_perf.perl" <trace.perf >actual &&
+	test $(grep -c "|th_timer|||_T_REL_|test|name:test2 intervals:2 " actual) = 3 &&
+	test $(grep -c "|th_counter||||test|name:test2 value:2$" actual) = 3 &&
+	grep "^d0|main|timer|||_T_REL_|test|name:test2 intervals:6 " actual &&
+	grep "^d0|main|counter||||test|name:test2 value:6$" actual
+'
+
+test_expect_success TRACE2_TIMERS,PTHREADS 'perf stream, timers of threads that do not announce themselves' '
+	test_when_finished "rm trace.perf actual" &&
+	GIT_TRACE2_PERF="$(pwd)/trace.perf" test-tool trace2 010quiet_threads 3 2 1 &&
+	perl "$TEST_DIRECTORY/t0211/scrub_perf.perl" <trace.perf >actual &&
+	! grep "th_timer\|th_counter" actual &&
+	grep "^d0|main|timer|||_T_REL_|test|name:test2 intervals:6 " actual &&
+	grep "^d0|main|counter||||test|name:test2 value:6$" actual
+'
+
+test_expect_success TRACE2_TIMERS 'perf stream, index timers' '
+	test_when_finished "rm trace.perf actual" &&
+	echo content >file &&
+	GIT_TRACE2_PERF="$(pwd)/trace.perf" git add file &&
+	perl "$TEST_DIRECTORY/t0211/scrub_perf.perl" <trace.perf >actual &&
+	grep "^d0|main|timer|||_T_REL_|index|name:write intervals:1 " actual
+'
+
 sane_unset GIT_TRACE2_PERF_BRIEF
 
 # Now test without environment variables and get all Trace2 settings
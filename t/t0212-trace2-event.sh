@@ -302,6 +302,23 @@ test_expect_success JSON_PP 'using global config, event stream, error event' '
 	test_cmp expect actual
 '
 
+test_expect_success TRACE2_TIMERS 'event stream, timer and counter' '
+	test_when_finished "rm trace.event" &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.event" test-tool trace2 007timer 5 1 &&
+	grep "\"event\":\"timer\",.*\"category\":\"test\",\"name\":\"test1\",\"intervals\":5,\"t_total\":" trace.event &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.event" test-tool trace2 008counter 5 15 &&
+	grep "\"event\":\"counter\",.*\"category\":\"test\",\"name\":\"test1\",\"count\":20}" trace.event
+'
+
+test_expect_success TRACE2_TIMERS,PTHREADS 'event stream, per-thread timer and counter' '
+	test_when_finished "rm trace.event" &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.event" test-tool trace2 009threads 3 2 1 &&
+	test $(grep -c "\"event\":\"th_timer\",.*\"thread\":\"th0[1-3]:ut_009\",.*\"name\":\"test2\",\"intervals\":2," trace.event) = 3 &&
+	test $(grep -c "\"event\":\"th_counter\",.*\"name\":\"test2\",\"count\":2}" trace.event) = 3 &&
+	grep "\"event\":\"timer\",.*\"thread\":\"main\",.*\"name\":\"test2\",\"intervals\":6," trace.event &&
+	grep "\"event\":\"counter\",.*\"thread\":\"main\",.*\"name\":\"test2\",\"count\":6}" trace.event
+'
+
 test_expect_success 'discard traces when there are too many files' '
 	mkdir trace_target_dir &&
 	test_when_finished "rm -r trace_target_dir" &&
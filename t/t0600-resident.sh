@@ -0,0 +1,159 @@
+#!/bin/sh
+
+test_description='git resident runs read-only commands for its clients'
+
+. ./test-lib.sh
+
+test -z "$NO_UNIX_SOCKETS" || {
+	skip_all='skipping resident tests, unix sockets not available'
+	test_done
+}
+
+# don't leave a stale server running
+test_atexit 'git resident stop'
+
+# the commands run by the server trace where the server does
+served () {
+	grep "\"event\":\"cmd_name\",.*\"name\":\"$1\"" "$TRASH_DIRECTORY/server.trace" |
+	wc -l
+}
+
+test_expect_success 'setup' '
+	test_commit one &&
+	mkdir -p dir/sub &&
+	test_commit dir/sub/two &&
+	GIT_TRACE2_EVENT="$TRASH_DIRECTORY/server.trace" git resident start &&
+	git resident status &&
+	GIT_RESIDENT_SOCKET="$TRASH_DIRECTORY/.git/resident.sock" &&
+	export GIT_RESIDENT_SOCKET
+'
+
+test_expect_success 'starting a second server fails' '
+	test_must_fail git resident run 2>err &&
+	test_i18ngrep "already running" err
+'
+
+test_expect_success 'server runs rev-parse' '
+	git rev-parse HEAD >actual &&
+	echo $(git log -1 --format=%H) >expect &&
+	test_cmp expect actual &&
+	test $(served rev-parse) = 1
+'
+
+test_expect_success 'server runs commands in a subdirectory' '
+	(
+		cd dir/sub &&
+		git rev-parse --show-prefix --show-toplevel >../../actual
+	) &&
+	cat >expect <<-EOF &&
+	dir/sub/
+	$TRASH_DIRECTORY
+	EOF
+	test_cmp expect actual &&
+	test $(served rev-parse) = 2
+'
+
+test_expect_success 'commands start out in the directory of the client' '
+	(
+		cd dir &&
+		git rev-parse --resolve-git-dir ../.git >../actual
+	) &&
+	echo ../.git >expect &&
+	test_cmp expect actual &&
+	test $(served rev-parse) = 3
+'
+
+test_expect_success 'server passes on stdin and the exit code' '
+	printf "%s\n" HEAD:one.t HEAD:missing >in &&
+	git cat-file --batch-check <in >actual &&
+	cat >expect <<-EOF &&
+	$(git rev-parse HEAD:one.t) blob 4
+	HEAD:missing missing
+	EOF
+	test_cmp expect actual &&
+	test_expect_code 1 git merge-base --is-ancestor HEAD HEAD^ &&
+	test $(served rev-parse) = 4 &&
+	test $(served cat-file) = 1 &&
+	test $(served merge-base) = 1
+'
+
+test_expect_success 'other environments fall back' '
+	GIT_TRACE2_EVENT="$TRASH_DIRECTORY/client.trace" \
+	GIT_AUTHOR_NAME=someone git rev-parse HEAD &&
+	grep "\"key\":\"fallback\",\"value\":\"different environment\"" client.trace &&
+	(
+		cd .git &&
+		git rev-parse --git-dir >../actual
+	) &&
+	echo . >expect &&
+	test_cmp expect actual &&
+	test $(served rev-parse) = 4
+'
+
+test_expect_success 'nested repositories fall back' '
+	git init dir/nested &&
+	(
+		cd dir/nested &&
+		git rev-parse --show-toplevel >../../actual
+	) &&
+	echo "$TRASH_DIRECTORY/dir/nested" >expect &&
+	test_cmp expect actual &&
+	test $(served rev-parse) = 4
+'
+
+test_expect_success 'other commands are not handed over' '
+	git log -1 >/dev/null &&
+	test $(served log) = 0
+'
+
+test_expect_success 'server picks up configuration changes' '
+	git rev-parse --short HEAD >actual &&
+	test_line_count = 1 actual &&
+	test $(wc -c <actual) = 8 &&
+	git config core.abbrev 12 &&
+	git rev-parse --short HEAD >actual &&
+	test $(wc -c <actual) = 13 &&
+	test $(served rev-parse) = 6
+'
+
+test_expect_success 'server picks up new packs' '
+	test_commit --notick three &&
+	git repack -ad &&
+	git cat-file -t three >actual &&
+	echo commit >expect &&
+	test_cmp expect actual &&
+	test $(served cat-file) = 2
+'
+
+test_expect_success PIPE 'command is killed when its client goes away' '
+	mkfifo stdin stdout &&
+	# sees the end of "stdout" once the command is gone, too
+	{ cat stdout >/dev/null && echo gone >gone & } &&
+	{ git cat-file --batch <stdin >stdout & } &&
+	client=$! &&
+	exec 9>stdin &&
+	test_when_finished "exec 9>&-" &&
+	for i in $(test_seq 30)
+	do
+		test $(served cat-file) = 3 && break
+		sleep 1
+	done &&
+	test $(served cat-file) = 3 &&
+	test_path_is_missing gone &&
+	kill $client &&
+	for i in $(test_seq 30)
+	do
+		test -f gone && break
+		sleep 1
+	done &&
+	test_path_is_file gone
+'
+
+test_expect_success 'stop the server' '
+	git resident stop &&
+	test_expect_code 1 git resident status &&
+	test_path_is_missing .git/resident.sock &&
+	git rev-parse HEAD
+'
+
+test_done
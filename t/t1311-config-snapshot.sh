@@ -0,0 +1,156 @@
+#!/bin/sh
+
+test_description='snapshots of the configuration of a repository'
+
+. ./test-lib.sh
+
+sane_unset GIT_TEST_CONFIG_SNAPSHOT
+
+# Run a command, and print what it did with the snapshot.
+snapshot () {
+	rm -f trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" "$@" >output &&
+	sed -n "s/.*\"key\":\"snapshot\",\"value\":\"\([a-z]*\)\".*/\1/p" trace
+}
+
+# Make the files the configuration is read from look old enough for a
+# snapshot to be taken of them.
+age_config () {
+	for f in .git/config .git/HEAD "$HOME/.gitconfig" "$HOME"/*.cfg
+	do
+		if test -f "$f"
+		then
+			test-tool chmtime =-10 "$f" || return 1
+		fi
+	done
+}
+
+test_expect_success 'setup' '
+	test_commit one &&
+	git symbolic-ref HEAD refs/heads/snap &&
+	cat >"$HOME/inc.cfg" <<-\EOF &&
+	[snap]
+		inc = 1
+	EOF
+	cat >"$HOME/branch.cfg" <<-\EOF &&
+	[snap]
+		branch = snap
+	EOF
+	cat >>.git/config <<-EOF &&
+	[include]
+		path = $HOME/inc.cfg
+	[includeIf "onbranch:snap"]
+		path = $HOME/branch.cfg
+	[snap]
+		novalue
+	EOF
+	test-tool config iterate >expect.iterate
+'
+
+test_expect_success 'no snapshot unless asked for' '
+	age_config &&
+	test "$(snapshot test-tool config iterate)" = "" &&
+	test_path_is_missing .git/config.snapshot
+'
+
+test_expect_success 'no snapshot of files that just changed' '
+	git config core.configSnapshot true &&
+	test "$(snapshot test-tool config iterate)" = "" &&
+	test_path_is_missing .git/config.snapshot
+'
+
+test_expect_success 'snapshot is written, and then used' '
+	age_config &&
+	test-tool config iterate >expect.iterate &&
+	test_path_is_file .git/config.snapshot &&
+	test "$(snapshot test-tool config iterate)" = used &&
+	test_cmp expect.iterate output
+'
+
+test_expect_success 'command line comes on top of the snapshot' '
+	test "$(snapshot env GIT_CONFIG_PARAMETERS="'\''snap.inc=2'\''" \
+		test-tool config get_value_multi snap.inc)" = used &&
+	test_write_lines 1 2 >expect &&
+	test_cmp expect output
+'
+
+test_expect_success 'changed include invalidates the snapshot' '
+	cat >"$HOME/inc.cfg" <<-\EOF &&
+	[snap]
+		inc = 3
+	EOF
+	test "$(snapshot test-tool config get_value snap.inc)" = "" &&
+	echo 3 >expect &&
+	test_cmp expect output &&
+	age_config &&
+	test "$(snapshot test-tool config get_value snap.inc)" = written &&
+	test_cmp expect output
+'
+
+test_expect_success 'global config is read afresh on top of the snapshot' '
+	test_when_finished "rm -f \"$HOME/.gitconfig\"; age_config" &&
+	test_config_global snap.global yes &&
+	test "$(snapshot test-tool config get_value snap.global)" = used &&
+	echo yes >expect &&
+	test_cmp expect output
+'
+
+test_expect_success 'porcelain and upload-pack share one snapshot' '
+	rm -f .git/config.snapshot &&
+	age_config &&
+	test "$(snapshot git rev-parse --git-dir)" = written &&
+	test "$(snapshot git upload-pack --advertise-refs .git/.)" = used &&
+	test "$(snapshot git rev-parse --git-dir)" = used
+'
+
+test_expect_success 'switching branches re-evaluates onbranch includes' '
+	rm -f .git/config.snapshot &&
+	age_config &&
+	test "$(snapshot test-tool config get_value snap.branch)" = written &&
+	git symbolic-ref HEAD refs/heads/other &&
+	test "$(snapshot test-tool config get_value snap.branch)" = "" &&
+	echo "Value not found for \"snap.branch\"" >expect &&
+	test_cmp expect output &&
+	git symbolic-ref HEAD refs/heads/snap
+'
+
+test_expect_success 'snapshot is not used with another HOME' '
+	age_config &&
+	test "$(snapshot test-tool config iterate)" = written &&
+	test "$(snapshot env HOME="$HOME/.." test-tool config iterate)" = written &&
+	test "$(snapshot test-tool config iterate)" = written &&
+	test "$(snapshot test-tool config iterate)" = used
+'
+
+test_expect_success 'corrupt snapshot is not used' '
+	printf "CSNP" >.git/config.snapshot &&
+	test "$(snapshot test-tool config get_value snap.inc)" = written &&
+	echo 3 >expect &&
+	test_cmp expect output
+'
+
+test_expect_success 'snapshot entries never claim another scope' '
+	test_when_finished "git config --unset uploadpack.packObjectsHook" &&
+	git config uploadpack.packObjectsHook "touch \"$(pwd)/hook-ran\";" &&
+	rm -f .git/config.snapshot &&
+	age_config &&
+	test "$(snapshot test-tool config iterate)" = written &&
+	# turn the entry from repository config into global config
+	offset=$(grep -obUa uploadpack.packobjectshook .git/config.snapshot |
+		 sed -n "1s/:.*//p") &&
+	printf "\\002" |
+	dd of=.git/config.snapshot bs=1 seek=$(($offset - 11)) conv=notrunc &&
+	test "$(snapshot test-tool config iterate)" = written &&
+	grep -A5 "^key=uploadpack.packobjectshook" output >actual &&
+	grep "^scope=local" actual &&
+	git clone --no-local . forged &&
+	test_path_is_missing hook-ran
+'
+
+test_expect_success 'turning snapshots off removes the snapshot' '
+	git config core.configSnapshot false &&
+	snapshot test-tool config iterate &&
+	test_path_is_missing .git/config.snapshot
+'
+
+test_done
@@ -59,6 +59,123 @@ test_expect_success 'out of bounds index.version issues warning' '
 	)
 '
 
+test_expect_success 'ls-files reads only a directory from the directory table' '
+	git init dirtable &&
+	(
+		cd dirtable &&
+		for d in a a/sub b
+		do
+			mkdir -p $d &&
+			for i in $(test_seq 70)
+			do
+				echo $i >$d/file$i || return 1
+			done
+		done &&
+		mkdir b-c &&
+		echo 1 >b-c/file &&
+		echo 1 >top &&
+		git add . &&
+		for v in 2 4
+		do
+			git update-index --index-version $v &&
+			git ls-files -s >full &&
+			git -c index.recordDirectoryTable=true \
+				update-index --force-write-index &&
+			for p in a/ a/sub/ b/ b-c/
+			do
+				grep -F "	$p" full >expect &&
+				GIT_TRACE2_EVENT="$(pwd)/trace" \
+					git ls-files -s "$p" >actual &&
+				test_cmp expect actual || return 1
+			done &&
+			grep -e "	a/sub/file7\$" -e "	a/sub/.*6\$" full >expect &&
+			GIT_TRACE2_EVENT="$(pwd)/trace" \
+				git ls-files -s a/sub/file7 "a/sub/*6" >actual &&
+			test_cmp expect actual &&
+			test $(grep -c "\"read/subtree_nr\",\"value\":\"140\"" trace) = 1 &&
+			test $(grep -c "\"read/subtree_nr\",\"value\":\"70\"" trace) = 3 &&
+			grep "\"read/cache_nr\",\"value\":\"212\"" trace &&
+			(
+				cd a &&
+				git ls-files -m >actual &&
+				test_must_be_empty actual &&
+				git ls-files >actual &&
+				test_line_count = 140 actual
+			) &&
+			rm trace || return 1
+		done
+	)
+'
+
+test_expect_success 'directory table and offset table survive a delta log' '
+	(
+		cd dirtable &&
+		git -c index.recordDirectoryTable=true -c index.threads=2 \
+			-c index.deltaLog=true update-index --force-write-index &&
+		echo changed >a/sub/file1 &&
+		echo new >a/new &&
+		echo changed >b/file1 &&
+		GIT_TRACE2_EVENT="$(pwd)/trace" \
+			git -c index.deltaLog=true add a b &&
+		grep "\"write/delta_nr\"" trace &&
+		git ls-files -s >full &&
+		grep -F "	a/" full >expect &&
+		GIT_TRACE2_EVENT="$(pwd)/trace" git ls-files -s a/ >actual &&
+		test_cmp expect actual &&
+		nr=$(wc -l <expect) &&
+		grep "\"read/subtree_nr\",\"value\":\"$((nr))\"" trace &&
+		git -c index.threads=2 ls-files -s >actual &&
+		test_cmp full actual &&
+		rm trace
+	)
+'
+
+test_expect_success 'index.deltaLog appends small changes to the index' '
+	git init deltalog &&
+	(
+		cd deltalog &&
+		git config index.deltaLogMaxPercent 100 &&
+		for i in 1 2 3 4 5 6 7 8
+		do
+			echo $i >file$i || return 1
+		done &&
+		git add . &&
+		for v in 2 4
+		do
+			git update-index --index-version $v &&
+			git -c index.deltaLog=true update-index --force-write-index &&
+			echo changed >file1 &&
+			echo new >new &&
+			GIT_TRACE2_EVENT="$(pwd)/trace" \
+				git -c index.deltaLog=true add file1 new &&
+			GIT_TRACE2_EVENT="$(pwd)/trace" \
+				git -c index.deltaLog=true rm -q --cached file2 &&
+			test $(grep -c "\"write/delta_nr\",\"value\":\"2\"" trace) = 1 &&
+			test $(grep -c "\"write/delta_nr\",\"value\":\"1\"" trace) = 1 &&
+			cp .git/index index.good &&
+			git ls-files -s --debug >expect &&
+			git -c index.deltaLog=false update-index --force-write-index &&
+			git ls-files -s --debug >actual &&
+			test_cmp expect actual &&
+			test $(wc -c <.git/index) -lt $(wc -c <index.good) &&
+
+			: a torn record is ignored &&
+			git -c index.deltaLog=true update-index --force-write-index &&
+			git ls-files -s >expect &&
+			git -c index.deltaLog=true update-index --add --cacheinfo \
+				100644,$EMPTY_BLOB,empty &&
+			size=$(wc -c <.git/index) &&
+			test_copy_bytes $(($size - 1)) <.git/index >index.torn &&
+			mv index.torn .git/index &&
+			git ls-files -s >actual &&
+			test_cmp expect actual &&
+			git rm -q --cached new &&
+			git add file2 &&
+			rm new trace || return 1
+		done
+	)
+'
+
 test_index_version () {
 	INDEX_VERSION_CONFIG=$1 &&
 	FEATURE_MANY_FILES=$2 &&
@@ -298,4 +298,43 @@ test_expect_success 'ls-files with "**" patterns and no slashes' '
 	test_must_be_empty actual
 '
 
+test_expect_success 'untracked scan gives the same result with threads' '
+	test_when_finished "rm -rf threads" &&
+	git init threads &&
+	(
+		cd threads &&
+		for d in a b c d e f g
+		do
+			mkdir -p $d/sub/deeper $d/sub2 $d/ign &&
+			>$d/tracked &&
+			>$d/file &&
+			>$d/sub/file &&
+			>$d/sub/deeper/file &&
+			>$d/sub2/file &&
+			>$d/ign/file &&
+			>$d/file.o &&
+			echo "ign/" >$d/.gitignore || return 1
+		done &&
+		echo "*.o" >.gitignore &&
+		>top &&
+		git add */tracked &&
+		for args in "-o" "-o --directory" "-o -i --exclude-standard" \
+			    "-o --exclude-standard -- c d/sub"
+		do
+			git -c core.untrackedScanThreads=1 ls-files $args \
+				>../expect &&
+			git -c core.untrackedScanThreads=2 ls-files $args \
+				>../actual &&
+			test_cmp ../expect ../actual || return 1
+		done &&
+		git -c core.untrackedScanThreads=1 status --porcelain -uall \
+			--ignored >../expect &&
+		GIT_TRACE2_EVENT="$(pwd)/../trace" \
+		git -c core.untrackedScanThreads=2 status --porcelain -uall \
+			--ignored >../actual &&
+		test_cmp ../expect ../actual &&
+		grep "scan/threads" ../trace
+	)
+'
+
 test_done
@@ -4,6 +4,54 @@ test_description='Test the lazy init name hash with various folder structures'
 
 . ./test-lib.sh
 
+test_expect_success 'few lookups do not build the hash tables' '
+	git init lookup &&
+	(
+		cd lookup &&
+		(
+			test_seq 200 | sed "s/^/pad\//" &&
+			echo Dir/File &&
+			echo Dir/file.bak &&
+			echo Foo.txt &&
+			echo foo.txt.bak &&
+			echo top &&
+			echo A/B/C/d
+		) |
+		sed "s/^/100644 $EMPTY_BLOB	/" |
+		git update-index --index-info &&
+		cat >names <<-\EOF &&
+		Dir/File
+		DIR/file
+		dir/FILE.BAK
+		foo.txt
+		FOO.TXT
+		Foo.txt.bak
+		TOP
+		dir
+		a/b/c
+		a/B/c/D
+		a/b/C/d/e
+		PAD/100
+		nothere
+		Dir/nothere
+		EOF
+		test-tool lazy-init-name-hash -l -s <names >expect &&
+		grep "^hashed=1\$" expect &&
+		grep "^DIR/file file=- icase=Dir/File dir=0 adjusted=Dir/file\$" expect &&
+		grep "^a/b/C/d/e file=- icase=- dir=0 adjusted=A/B/C/d/e\$" expect &&
+		while read name
+		do
+			echo "$name" | test-tool lazy-init-name-hash -l >out &&
+			tail -n 1 out >hashed &&
+			echo hashed=0 >expect.hashed &&
+			test_cmp expect.hashed hashed &&
+			sed -n 1p out || return 1
+		done <names >actual &&
+		grep -v "^hashed=" expect >expect.names &&
+		test_cmp expect.names actual
+	)
+'
+
 if test 1 -eq $(test-tool online-cpus)
 then
 	skip_all='skipping lazy-init tests, single cpu'
@@ -262,4 +262,144 @@ test_expect_success 'diff-tree -l0 defaults to a big rename limit, not zero' '
 	grep "myotherfile.*myfile" actual
 '
 
+test_expect_success 'inexact renames among many similar files' '
+	git checkout --orphan many-renames &&
+	git rm -rfq . &&
+	mkdir old &&
+	for i in $(test_seq 300)
+	do
+		if test $i -le 200
+		then
+			# mostly made of lines that every file shares
+			test_write_lines common1 common2 common3 common4 \
+				common5 common6 "unique $i" "edit $i"
+		else
+			test_write_lines "line one of $i" "line two of $i" \
+				"line three of $i" "edit $i"
+		fi >old/$i || return 1
+	done &&
+	git add old &&
+	git commit -m "many files" &&
+	git mv old new &&
+	for i in $(test_seq 300)
+	do
+		sed -e "s/^edit .*/edited/" new/$i >new/$i.tmp &&
+		mv new/$i.tmp new/$i || return 1
+	done &&
+	git commit -am "move and edit many files" &&
+	for i in $(test_seq 300)
+	do
+		printf "R\told/$i\tnew/$i\n" || return 1
+	done | sort >expect &&
+	git -c diff.renameThreads=1 diff -M --name-status HEAD^ HEAD >out1 &&
+	sed -e "s/^R[0-9]*/R/" out1 | sort >actual &&
+	test_cmp expect actual &&
+	git -c diff.renameThreads=4 diff -M --name-status HEAD^ HEAD >out4 &&
+	test_cmp out1 out4
+'
+
+test_expect_success 'span index breaks ties like scoring every pair' '
+	git checkout --orphan ties &&
+	git rm -rfq . &&
+	mkdir -p a t &&
+	# the fillers only share lines that too many files have to be
+	# indexed, and fill the candidate slots before the tied sources
+	for i in $(test_seq 70)
+	do
+		{
+			test_write_lines c1 c2 c3 c4 c5 c6 c7 c8 c9 c10 &&
+			printf "%0$((36 + $i / 2))d\\n" $i
+		} >a/$(printf "%02d" $i) || return 1
+	done &&
+	for i in $(test_seq 6)
+	do
+		{
+			test_write_lines c1 c2 c3 c4 c5 c6 c7 c8 c9 c10 &&
+			test_write_lines t1 t2 t3 t4 t5 t6 t7 t8 t9 t10
+		} >t/tie$i || return 1
+	done &&
+	git add a t &&
+	git commit -m "fillers and ties" &&
+	git rm -rq a t &&
+	{
+		test_write_lines c1 c2 c3 c4 c5 c6 c7 c8 c9 c10 &&
+		test_write_lines t1 t2 t3 t4 t5 t6 t7 t8 t9 edited
+	} >new &&
+	git add new &&
+	git commit -m "replace them with one file" &&
+	git diff -M --name-status HEAD^ HEAD >expect &&
+	grep "^R[0-9]*	t/tie[0-9]	new\$" expect &&
+	GIT_TEST_RENAME_INDEX_MIN_PAIRS=0 \
+		git diff -M --name-status HEAD^ HEAD >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'renames that keep their basename are paired first' '
+	git checkout --orphan basenames &&
+	git rm -rfq . &&
+	mkdir old &&
+	test_write_lines 1 2 3 4 5 6 7 8 9 10 >old/moved &&
+	test_write_lines a b c d e f g h i j >old/other &&
+	git add old &&
+	git commit -m "before move" &&
+	git rm -q old/moved old/other &&
+	mkdir new &&
+	test_write_lines 1 2 3 4 5 6 7 8 9 ten >new/moved &&
+	test_write_lines a b c d e f g x y z >new/renamed &&
+	git add new &&
+	git commit -m "move" &&
+	GIT_TRACE2_EVENT="$(pwd)/trace2.txt" \
+		git diff -M --name-status HEAD^ HEAD >out &&
+	sed -e "s/^R[0-9]*/R/" out >actual &&
+	cat >expect <<-\EOF &&
+	R	old/moved	new/moved
+	R	old/other	new/renamed
+	EOF
+	test_cmp expect actual &&
+	grep "\"key\":\"rename/basename-renames\",\"value\":\"1\"" trace2.txt &&
+	grep "\"key\":\"rename/similarity-checks\"" trace2.txt
+'
+
+test_expect_success 'diff.renameCache skips small comparisons' '
+	git -c diff.renameCache=true diff -M --name-status HEAD^ HEAD >actual &&
+	test_path_is_missing .git/rename-cache
+'
+
+test_expect_success 'diff.renameCache stores and reuses inexact renames' '
+	GIT_TEST_RENAME_CACHE_MIN_PAIRS=0 &&
+	export GIT_TEST_RENAME_CACHE_MIN_PAIRS &&
+	git diff -M --name-status HEAD^ HEAD >expect &&
+	git -c diff.renameCache=true diff -M --name-status HEAD^ HEAD >actual &&
+	test_cmp expect actual &&
+	find .git/rename-cache -type f >cache-files &&
+	test_line_count = 1 cache-files &&
+	git -c diff.renameCache=true diff -M --name-status HEAD^ HEAD >actual &&
+	test_cmp expect actual &&
+
+	# a cache entry with no renames in it must be believed
+	echo - >$(cat cache-files) &&
+	git -c diff.renameCache=true diff -M --name-status HEAD^ HEAD >actual &&
+	cat >expect <<-\EOF &&
+	A	new/moved
+	A	new/renamed
+	D	old/moved
+	D	old/other
+	EOF
+	test_cmp expect actual &&
+	git -c diff.renameCache=true diff -M30 --name-status HEAD^ HEAD >actual &&
+	grep "^R" actual
+'
+
+test_expect_success 'gc removes rename cache entries not used for a while' '
+	find .git/rename-cache -type f >cache-files &&
+	test_line_count = 2 cache-files &&
+	test-tool chmtime =-3000000 $(cat cache-files) &&
+	git -c diff.renameCache=true diff -M30 --name-status HEAD^ HEAD &&
+	git gc &&
+	find .git/rename-cache -type f >cache-files &&
+	test_line_count = 1 cache-files &&
+	git -c gc.renameCacheExpire=now gc &&
+	test_path_is_missing .git/rename-cache
+'
+
 test_done
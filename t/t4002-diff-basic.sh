@@ -410,4 +410,26 @@ test_expect_success \
         grep -v "^index" >.test-b &&
     test_cmp .test-a .test-b'
 
+test_expect_success 'diff-tree skips runs of identical entries' '
+	one=$(echo one | git hash-object -w --stdin) &&
+	two=$(echo two | git hash-object -w --stdin) &&
+	for i in 1 2 3 4 5 6 7 8 9
+	do
+		printf "100644 blob $one\tfile$i\n" || return 1
+	done >entries &&
+	git mktree <entries >tree1 &&
+	sed -e "s/file3$/file3x/" \
+	    -e "s/^100644 \(.*file5\)$/100755 \1/" \
+	    -e "/file7$/s/$one/$two/" <entries >entries2 &&
+	git mktree <entries2 >tree2 &&
+	git diff-tree --name-status $(cat tree1) $(cat tree2) >actual &&
+	cat >expect <<-\EOF &&
+	D	file3
+	A	file3x
+	M	file5
+	M	file7
+	EOF
+	test_cmp expect actual
+'
+
 test_done
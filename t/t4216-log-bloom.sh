@@ -402,4 +402,27 @@ test_expect_success 'Bloom generation backfills empty commits' '
 	)
 '
 
+test_expect_success 'Bloom filters computed in parallel match serial ones' '
+	git init parallel &&
+	test_when_finished "rm -fr parallel" &&
+	(
+		cd parallel &&
+		for i in $(test_seq 1 20)
+		do
+			mkdir -p dir$((i % 3))/sub &&
+			echo $i >dir$((i % 3))/sub/file$i &&
+			git add . &&
+			git commit -q -m "$i" || return 1
+		done &&
+
+		git commit-graph write --reachable --changed-paths --threads=1 &&
+		mv .git/objects/info/commit-graph expect &&
+		rm -f trace.event &&
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+			git commit-graph write --reachable --changed-paths --threads=4 &&
+		test_filter_computed 20 trace.event &&
+		test_cmp_bin expect .git/objects/info/commit-graph
+	)
+'
+
 test_done
@@ -468,6 +468,101 @@ test_expect_success 'pack-objects in too-many-packs mode' '
 	git fsck
 '
 
+test_expect_success 'objects reused from several packs are copied unchanged' '
+	git init multi-pack-reuse &&
+	(
+		cd multi-pack-reuse &&
+		for i in 1 2 3 4
+		do
+			test-tool genrandom "base" 8192 >file &&
+			echo "$i" >>file &&
+			cp file copy &&
+			echo copy >>copy &&
+			git add file copy &&
+			test_commit "small-$i" &&
+			git repack -d || return 1
+		done &&
+		ls .git/objects/pack/*.pack >packs &&
+		test_line_count = 4 packs &&
+		git rev-list --objects --all >objects &&
+		git pack-objects --stdout --revs --delta-base-offset --all \
+			</dev/null >stdout.pack &&
+		git pack-objects --revs --delta-base-offset --all \
+			file </dev/null >hash &&
+		cmp stdout.pack file-$(cat hash).pack &&
+		git index-pack --strict -o stdout.idx stdout.pack &&
+		git show-index <stdout.idx >index &&
+		test_line_count = $(wc -l <objects) index
+	)
+'
+
+test_expect_success 'large reused objects are written to stdout unchanged' '
+	git init large-reuse &&
+	(
+		cd large-reuse &&
+		test-tool genrandom "large" 300000 >large &&
+		git add large &&
+		test_commit large &&
+		git repack -ad &&
+		git pack-objects --stdout --revs --all </dev/null >stdout.pack &&
+		cmp stdout.pack .git/objects/pack/pack-*.pack &&
+		git pack-objects --stdout --revs --all </dev/null | cat >piped.pack &&
+		cmp piped.pack stdout.pack
+	)
+'
+
+test_expect_success SPLICE 'upload-pack without a sideband splices the pack' '
+	git init --bare spliced.git &&
+	(
+		cd large-reuse &&
+		hexsz=$(test_oid hexsz) &&
+		printf "%04xwant %s\n00000009done\n0000" \
+			$(($hexsz + 10)) $(git rev-parse HEAD) >input &&
+		GIT_TRACE2_EVENT="$(pwd)/trace" \
+			git upload-pack . <input >output &&
+		grep "\"key\":\"spliced-bytes\"" trace &&
+
+		# skip the ref advertisement and the NAK
+		git upload-pack --advertise-refs . >advertisement &&
+		tail -c +$(($(wc -c <advertisement) + 9)) output >spliced.pack &&
+		git -C ../spliced.git index-pack --stdin <spliced.pack &&
+		git -C ../spliced.git cat-file -e $(git rev-parse HEAD:large)
+	)
+'
+
+test_expect_success 'pack.fullPathHash keeps versions of a path together' '
+	git init same-name &&
+	(
+		cd same-name &&
+		size=2000 &&
+		for dir in one two three
+		do
+			mkdir -p $dir/deep/common/path &&
+			test-tool genrandom $dir $size >$dir/deep/common/path/file &&
+			size=$((size - 25)) || return 1
+		done &&
+		git add . &&
+		git commit -m base &&
+		for dir in one two three
+		do
+			test-tool genrandom $dir-more 100 >>$dir/deep/common/path/file ||
+			return 1
+		done &&
+		git commit -a -m grow &&
+
+		# All three paths share a name hash, so sorting by size puts
+		# the other paths between the two versions of each one.
+		git pack-objects --window=2 --all name-only </dev/null >name-only.hash &&
+		git -c pack.fullPathHash=true \
+			pack-objects --window=2 --all full-path </dev/null >full-path.hash &&
+		git verify-pack -v name-only-$(cat name-only.hash).idx >name-only.out &&
+		git verify-pack -v full-path-$(cat full-path.hash).idx >full-path.out &&
+		! grep "blob .* 1 $OID_REGEX" name-only.out &&
+		grep "blob .* 1 $OID_REGEX" full-path.out >deltas &&
+		test_line_count = 3 deltas
+	)
+'
+
 test_expect_success 'setup: fake a SHA1 hash collision' '
 	git init corrupt &&
 	(
@@ -284,4 +284,40 @@ test_expect_success 'index-pack -v --stdin produces progress for both phases' '
 	test_i18ngrep "Resolving deltas" err
 '
 
+test_expect_success 'index-pack --report-foreign lists objects outside the pack' '
+	git init foreign &&
+	(
+		cd foreign &&
+		mkdir dir &&
+		echo one >dir/file &&
+		echo one >top &&
+		git add dir top &&
+		git commit -m one &&
+		echo two >top &&
+		git commit -am two &&
+		pack=$(printf "HEAD\n^HEAD^\n" | git pack-objects --revs new) &&
+		git rev-parse HEAD^ HEAD:dir | sort >expect &&
+		git index-pack --report-foreign -o new.idx new-$pack.pack &&
+		sort new-$pack.foreign >actual &&
+		test_cmp expect actual &&
+		git init --bare ../empty.git &&
+		git --git-dir=../empty.git index-pack --report-foreign \
+			--stdin <new-$pack.pack &&
+		test_path_is_file ../empty.git/objects/pack/pack-$pack.pack &&
+		test_path_is_missing ../empty.git/objects/pack/pack-$pack.foreign
+	)
+'
+
+test_expect_success 'receive-pack asks for foreign objects only if configured' '
+	git init --bare foreign-dst.git &&
+	git -C foreign-dst.git config receive.unpackLimit 1 &&
+	GIT_TRACE="$(pwd)/trace" git -C foreign push ../foreign-dst.git HEAD^:refs/heads/one &&
+	grep "git index-pack" trace &&
+	! grep "report-foreign" trace &&
+	git -C foreign-dst.git config receive.connectivityFromPack true &&
+	GIT_TRACE="$(pwd)/trace" git -C foreign push ../foreign-dst.git HEAD:refs/heads/two &&
+	grep "git index-pack.*--report-foreign" trace &&
+	git -C foreign-dst.git fsck
+'
+
 test_done
@@ -68,6 +68,19 @@ rev_list_tests() {
 		test_cmp expect actual
 	'
 
+	test_expect_success "for-each-ref ahead-behind via bitmap ($state)" '
+		git for-each-ref --format="%(refname)" refs/heads >refs &&
+		while read ref
+		do
+			echo "$ref $(git rev-list --count other..$ref) $(git rev-list --count $ref..other)" ||
+			return 1
+		done <refs >expect &&
+		echo "refs/tags/tagged-blob " >>expect &&
+		git for-each-ref --format="%(refname) %(ahead-behind:other)" \
+			refs/heads refs/tags/tagged-blob >actual &&
+		test_cmp expect actual
+	'
+
 	test_expect_success "counting commits with limiting ($state)" '
 		git rev-list --count HEAD -- 1.t >expect &&
 		git rev-list --use-bitmap-index --count HEAD -- 1.t >actual &&
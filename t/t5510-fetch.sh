@@ -913,6 +913,46 @@ test_expect_success 'branchname D/F conflict resolved by --prune' '
 	test_cmp expect actual
 '
 
+test_expect_success 'D/F conflicts between refs written by the same fetch' '
+	git init df-same-fetch &&
+	(
+		cd df-same-fetch &&
+		test_commit base &&
+		git branch other &&
+		test_must_fail git fetch . other:refs/heads/d1/f base:refs/heads/d1 &&
+		test_must_fail git rev-parse --verify refs/heads/d1 &&
+		test_must_fail git fetch . base:refs/heads/d2 other:refs/heads/d2/f &&
+		test_must_fail git rev-parse --verify refs/heads/d2/f &&
+		git for-each-ref --format="%(refname)" refs/heads/d1 refs/heads/d2 >actual &&
+		cat >expect <<-\EOF &&
+		refs/heads/d1/f
+		refs/heads/d2
+		EOF
+		test_cmp expect actual
+	)
+'
+
+test_expect_success 'symrefs stay right across the updates of one fetch' '
+	git init symref-upstream &&
+	test_commit -C symref-upstream one &&
+	git -C symref-upstream branch d &&
+	git clone symref-upstream symref-clone &&
+	test_commit -C symref-upstream two &&
+	git -C symref-upstream branch -D d &&
+	git -C symref-upstream branch d/f &&
+	git -C symref-clone fetch --prune origin &&
+	git -C symref-upstream rev-parse HEAD >expect &&
+	git -C symref-clone rev-parse origin/HEAD >actual &&
+	test_cmp expect actual &&
+	git -C symref-clone for-each-ref --format="%(refname)" refs/remotes >actual &&
+	cat >expect <<-\EOF &&
+	refs/remotes/origin/HEAD
+	refs/remotes/origin/d/f
+	refs/remotes/origin/master
+	EOF
+	test_cmp expect actual
+'
+
 test_expect_success 'fetching a one-level ref works' '
 	test_commit extra &&
 	git reset --hard HEAD^ &&
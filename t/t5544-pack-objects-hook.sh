@@ -59,4 +59,43 @@ test_expect_success 'hook does not run from repo config' '
 	test_path_is_missing .git/hook.stdout
 '
 
+test_expect_success 'uploadpack.packCache replays an identical fetch' '
+	clear_hook_results &&
+	test_config uploadpack.packCache true &&
+	git clone --no-local . dst.git &&
+	ls .git/upload-pack-cache/*/* >cached &&
+	test_line_count = 1 cached &&
+	rm -rf dst.git &&
+	GIT_TRACE="$(pwd)/trace" git clone --no-local . dst.git &&
+	! grep "built-in: git pack-objects" trace &&
+	git -C dst.git fsck &&
+	git -C dst.git rev-parse two >actual &&
+	git rev-parse two >expect &&
+	test_cmp expect actual
+'
+
+test_expect_success 'uploadpack.packCache is abandoned when refs change' '
+	clear_hook_results &&
+	test_config uploadpack.packCache true &&
+	old=$(ls .git/upload-pack-cache) &&
+	test_commit three &&
+	git clone --no-local . dst.git &&
+	git -C dst.git rev-parse three &&
+	test_path_is_missing .git/upload-pack-cache/$old &&
+	ls .git/upload-pack-cache/*/* >cached &&
+	test_line_count = 1 cached
+'
+
+test_expect_success 'uploadpack.packCacheMaxSize evicts the oldest packs' '
+	clear_hook_results &&
+	test_config uploadpack.packCache true &&
+	old=$(ls .git/upload-pack-cache/*/*) &&
+	test-tool chmtime =-10 $old &&
+	test_config uploadpack.packCacheMaxSize $(test-tool path-utils file-size $old) &&
+	git clone --no-local --depth=1 "file://$(pwd)" shallow.git &&
+	test_path_is_missing $old &&
+	ls .git/upload-pack-cache/*/* >cached &&
+	test_line_count = 1 cached
+'
+
 test_done
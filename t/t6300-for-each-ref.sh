@@ -1030,4 +1030,45 @@ test_expect_success 'for-each-ref --ignore-case works on multiple sort keys' '
 	test_cmp expect actual
 '
 
+test_expect_success 'for-each-ref --format=%(ahead-behind:<base>)' '
+	test_when_finished "git checkout master && git branch -D ab-base ab-side" &&
+	git checkout -b ab-base refs/heads/master &&
+	test_commit ab-one &&
+	git checkout -b ab-side HEAD^ &&
+	test_commit ab-two &&
+	test_commit ab-three &&
+	cat >expect <<-EOF &&
+	refs/heads/ab-base 0 0
+	refs/heads/ab-side 2 1
+	EOF
+	git for-each-ref --format="%(refname) %(ahead-behind:ab-base)" \
+		refs/heads/ab-base refs/heads/ab-side >actual &&
+	test_cmp expect actual &&
+	test_must_fail git for-each-ref --format="%(ahead-behind)" refs/heads
+'
+
+test_expect_success 'for-each-ref --sort=ahead-behind:<base> compares numbers' '
+	test_when_finished "git checkout master && git branch -D ab-root ab-far ab-near ab-behind" &&
+	git checkout -b ab-root refs/heads/master &&
+	test_commit ab-root &&
+	git branch ab-behind HEAD^ &&
+	git checkout -b ab-far &&
+	for i in $(test_seq 10)
+	do
+		test_commit ab-far-$i || return 1
+	done &&
+	git checkout -b ab-near ab-root &&
+	test_commit ab-near-1 &&
+	test_commit ab-near-2 &&
+	cat >expect <<-EOF &&
+	refs/heads/ab-behind 0 1
+	refs/heads/ab-near 2 0
+	refs/heads/ab-far 10 0
+	EOF
+	git for-each-ref --sort=ahead-behind:ab-root \
+		--format="%(refname) %(ahead-behind:ab-root)" \
+		refs/heads/ab-far refs/heads/ab-near refs/heads/ab-behind >actual &&
+	test_cmp expect actual
+'
+
 test_done
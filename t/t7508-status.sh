@@ -1656,4 +1656,36 @@ test_expect_success '--no-optional-locks prevents index update' '
 	! grep ^1234567890 out
 '
 
+test_expect_success SYMLINKS 'preloading the index with and without io_uring' '
+	git init preload &&
+	(
+		cd preload &&
+		mkdir dir other &&
+		for i in 1 2 3 4 5 6 7 8
+		do
+			echo $i >file$i &&
+			echo $i >dir/file$i &&
+			echo $i >other/file$i || return 1
+		done &&
+		git add . &&
+		git commit -q -m initial &&
+		echo changed >file2 &&
+		rm file4 &&
+		test-tool chmtime +10 file6 &&
+		rm -r dir &&
+		ln -s other dir &&
+		git -c core.preloadIndex=false status --porcelain -uno >expect &&
+		git diff-files --name-only >expect.files &&
+		for io_uring in true false
+		do
+			test-tool chmtime +10 file6 &&
+			GIT_TEST_PRELOAD_INDEX=1 git -c core.ioUring=$io_uring \
+				status --porcelain -uno >actual &&
+			test_cmp expect actual &&
+			git diff-files --name-only >actual.files &&
+			test_cmp expect.files actual.files || return 1
+		done
+	)
+'
+
 test_done
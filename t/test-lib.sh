@@ -1514,7 +1514,9 @@ esac
 ( COLUMNS=1 && test $COLUMNS = 1 ) && test_set_prereq COLUMNS_CAN_BE_1
 test -z "$NO_PERL" && test_set_prereq PERL
 test -z "$NO_PTHREADS" && test_set_prereq PTHREADS
+test -n "$HAVE_SPLICE" && test_set_prereq SPLICE
 test -z "$NO_PYTHON" && test_set_prereq PYTHON
+test -z "$NO_TRACE2_TIMERS" && test_set_prereq TRACE2_TIMERS
 test -n "$USE_LIBPCRE1$USE_LIBPCRE2" && test_set_prereq PCRE
 test -n "$USE_LIBPCRE1" && test_set_prereq LIBPCRE1
 test -n "$USE_LIBPCRE2" && test_set_prereq LIBPCRE2
@@ -8,11 +8,13 @@
 #include "version.h"
 #include "trace2/tr2_cfg.h"
 #include "trace2/tr2_cmd_name.h"
+#include "trace2/tr2_ctr.h"
 #include "trace2/tr2_dst.h"
 #include "trace2/tr2_sid.h"
 #include "trace2/tr2_sysenv.h"
 #include "trace2/tr2_tgt.h"
 #include "trace2/tr2_tls.h"
+#include "trace2/tr2_tmr.h"
 
 static int trace2_enabled;
 
@@ -110,6 +112,20 @@ static void tr2main_atexit_handler(void)
 	 */
 	tr2tls_pop_unwind_self();
 
+	/*
+	 * Add the data of the main thread to that of the threads that
+	 * have already exited, and report the process totals.
+	 */
+	tr2_update_final_timers(&tr2tls_get_self()->timer_block);
+	tr2_update_final_counters(&tr2tls_get_self()->counter_block);
+
+	for_each_wanted_builtin (j, tgt_j) {
+		if (tgt_j->pfn_timer)
+			tr2_emit_final_timers(tgt_j->pfn_timer);
+		if (tgt_j->pfn_counter)
+			tr2_emit_final_counters(tgt_j->pfn_counter);
+	}
+
 	for_each_wanted_builtin (j, tgt_j)
 		if (tgt_j->pfn_atexit)
 			tgt_j->pfn_atexit(us_elapsed_absolute,
@@ -500,6 +516,19 @@ void trace2_thread_exit_fl(const char *file, int line)
 	tr2tls_pop_unwind_self();
 	us_elapsed_thread = tr2tls_region_elasped_self(us_now);
 
+	/*
+	 * Report the data of this thread, if wanted, and add it to the
+	 * process totals before the thread's TLS data goes away.
+	 */
+	for_each_wanted_builtin (j, tgt_j) {
+		if (tgt_j->pfn_timer)
+			tr2_emit_per_thread_timers(tgt_j->pfn_timer);
+		if (tgt_j->pfn_counter)
+			tr2_emit_per_thread_counters(tgt_j->pfn_counter);
+	}
+	tr2_update_final_timers(&tr2tls_get_self()->timer_block);
+	tr2_update_final_counters(&tr2tls_get_self()->counter_block);
+
 	for_each_wanted_builtin (j, tgt_j)
 		if (tgt_j->pfn_thread_exit_fl)
 			tgt_j->pfn_thread_exit_fl(file, line,
@@ -792,3 +821,38 @@ void trace2_printf(const char *fmt, ...)
 	va_end(ap);
 }
 #endif
+
+#ifndef NO_TRACE2_TIMERS
+void trace2_timer_start(enum trace2_timer_id tid)
+{
+	if (!trace2_enabled)
+		return;
+
+	if (tid < 0 || tid >= TRACE2_NUMBER_OF_TIMERS)
+		BUG("trace2_timer_start: invalid timer id: %d", tid);
+
+	tr2_start_timer(tid);
+}
+
+void trace2_timer_stop(enum trace2_timer_id tid)
+{
+	if (!trace2_enabled)
+		return;
+
+	if (tid < 0 || tid >= TRACE2_NUMBER_OF_TIMERS)
+		BUG("trace2_timer_stop: invalid timer id: %d", tid);
+
+	tr2_stop_timer(tid);
+}
+
+void trace2_counter_add(enum trace2_counter_id cid, uint64_t value)
+{
+	if (!trace2_enabled)
+		return;
+
+	if (cid < 0 || cid >= TRACE2_NUMBER_OF_COUNTERS)
+		BUG("trace2_counter_add: invalid counter id: %d", cid);
+
+	tr2_counter_increment(cid, value);
+}
+#endif
@@ -480,6 +480,90 @@ void trace2_printf(const char *fmt, ...);
 /* clang-format on */
 #endif
 
+/*
+ * Stopwatch timers.
+ *
+ * Timers accumulate the time spent in a section of code across all of
+ * the intervals in which it is run, so they can be put around code that
+ * runs far too often for a region.  Starts and stops of a timer are
+ * counted in the calling thread only, and the totals are written out
+ * as a single "timer" event per timer when the process exits.  Threads
+ * started with trace2_thread_start() add their totals to those of the
+ * process when they call trace2_thread_exit(); some timers also write a
+ * per-thread "th_timer" event at that point.
+ *
+ * Starts and stops of a timer must be balanced within a thread.  Nested
+ * (recursive) starts are allowed; only the outermost interval is timed.
+ *
+ * To add a timer, add an id here and describe it in the table in
+ * trace2/tr2_tmr.c.
+ */
+enum trace2_timer_id {
+	/*
+	 * Timers used by t/helper/test-trace2.c.
+	 */
+	TRACE2_TIMER_ID_TEST1 = 0,
+	TRACE2_TIMER_ID_TEST2,
+
+	TRACE2_TIMER_ID_UNPACK_ENTRY,
+	TRACE2_TIMER_ID_INFLATE,
+	TRACE2_TIMER_ID_INDEX_READ,
+	TRACE2_TIMER_ID_INDEX_WRITE,
+	TRACE2_TIMER_ID_REFS_ITERATE,
+
+	/* Add additional timer definitions before here. */
+	TRACE2_NUMBER_OF_TIMERS
+};
+
+/*
+ * Global counters.
+ *
+ * Counters are summed per thread and written out just like timers,
+ * as "counter" and "th_counter" events.
+ *
+ * To add a counter, add an id here and describe it in the table in
+ * trace2/tr2_ctr.c.
+ */
+enum trace2_counter_id {
+	/*
+	 * Counters used by t/helper/test-trace2.c.
+	 */
+	TRACE2_COUNTER_ID_TEST1 = 0,
+	TRACE2_COUNTER_ID_TEST2,
+
+	TRACE2_COUNTER_ID_PACK_WINDOWS,
+	TRACE2_COUNTER_ID_INFLATED_BYTES,
+	TRACE2_COUNTER_ID_REFS_ITERATED,
+
+	/* Add additional counter definitions before here. */
+	TRACE2_NUMBER_OF_COUNTERS
+};
+
+/*
+ * Building with NO_TRACE2_TIMERS compiles all timers and counters
+ * away, for when even the cost of checking whether trace2 is enabled
+ * is too much.
+ */
+#ifdef NO_TRACE2_TIMERS
+#define trace2_timer_start(tid) \
+	do {                    \
+	} while (0)
+#define trace2_timer_stop(tid) \
+	do {                   \
+	} while (0)
+#define trace2_counter_add(cid, value) \
+	do {                           \
+	} while (0)
+#else
+void trace2_timer_start(enum trace2_timer_id tid);
+void trace2_timer_stop(enum trace2_timer_id tid);
+
+/*
+ * Add `value` to the counter in the calling thread.
+ */
+void trace2_counter_add(enum trace2_counter_id cid, uint64_t value);
+#endif
+
 /*
  * Optional platform-specific code to dump information about the
  * current and any parent process(es).  This is intended to allow
@@ -0,0 +1,89 @@
+#include "cache.h"
+#include "thread-utils.h"
+#include "trace2/tr2_ctr.h"
+#include "trace2/tr2_tls.h"
+
+/*
+ * A table of the counters in `enum trace2_counter_id`, indexed by id.
+ */
+/* clang-format off */
+static struct tr2_counter_metadata tr2_counter_metadata[TRACE2_NUMBER_OF_COUNTERS] = {
+	[TRACE2_COUNTER_ID_TEST1] = {
+		.category = "test",
+		.name = "test1",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_COUNTER_ID_TEST2] = {
+		.category = "test",
+		.name = "test2",
+		.want_per_thread_events = 1,
+	},
+	[TRACE2_COUNTER_ID_PACK_WINDOWS] = {
+		.category = "pack",
+		.name = "windows_mapped",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_COUNTER_ID_INFLATED_BYTES] = {
+		.category = "zlib",
+		.name = "inflated_bytes",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_COUNTER_ID_REFS_ITERATED] = {
+		.category = "refs",
+		.name = "iterated",
+		.want_per_thread_events = 0,
+	},
+};
+/* clang-format on */
+
+/*
+ * The totals of the threads that have exited, and eventually of the
+ * main thread.  Modify under tr2tls_lock().
+ */
+static struct tr2_counter_block final_counter_block;
+
+void tr2_counter_increment(enum trace2_counter_id cid, uint64_t value)
+{
+	struct tr2tls_thread_ctx *ctx = tr2tls_get_self();
+
+	ctx->counter_block.counter[cid].value += value;
+}
+
+void tr2_update_final_counters(const struct tr2_counter_block *block)
+{
+	int cid;
+
+	tr2tls_lock();
+
+	for (cid = 0; cid < TRACE2_NUMBER_OF_COUNTERS; cid++)
+		final_counter_block.counter[cid].value +=
+			block->counter[cid].value;
+
+	tr2tls_unlock();
+}
+
+void tr2_emit_per_thread_counters(tr2_tgt_evt_counter_t *fn)
+{
+	struct tr2tls_thread_ctx *ctx = tr2tls_get_self();
+	int cid;
+
+	for (cid = 0; cid < TRACE2_NUMBER_OF_COUNTERS; cid++) {
+		struct tr2_counter_metadata *meta = &tr2_counter_metadata[cid];
+		struct tr2_counter *c = &ctx->counter_block.counter[cid];
+
+		if (meta->want_per_thread_events && c->value)
+			fn(meta, c, 0);
+	}
+}
+
+void tr2_emit_final_counters(tr2_tgt_evt_counter_t *fn)
+{
+	int cid;
+
+	for (cid = 0; cid < TRACE2_NUMBER_OF_COUNTERS; cid++) {
+		struct tr2_counter *final = &final_counter_block.counter[cid];
+
+		if (final->value)
+			fn(&tr2_counter_metadata[cid], final, 1);
+	}
+}
@@ -0,0 +1,55 @@
+#ifndef TR2_CTR_H
+#define TR2_CTR_H
+
+#include "trace2.h"
+
+/*
+ * Static description of a counter, see the table in tr2_ctr.c.
+ */
+struct tr2_counter_metadata {
+	const char *category;
+	const char *name;
+
+	/*
+	 * Write a "th_counter" event for each thread that used the
+	 * counter, in addition to the "counter" event with the process
+	 * totals.
+	 */
+	unsigned int want_per_thread_events:1;
+};
+
+struct tr2_counter {
+	uint64_t value;
+};
+
+struct tr2_counter_block {
+	struct tr2_counter counter[TRACE2_NUMBER_OF_COUNTERS];
+};
+
+/*
+ * Add `value` to a counter in the calling thread.
+ */
+void tr2_counter_increment(enum trace2_counter_id cid, uint64_t value);
+
+/*
+ * Add the counters of a thread to the process totals.  This is called
+ * once per thread, when it exits.
+ */
+void tr2_update_final_counters(const struct tr2_counter_block *block);
+
+typedef void(tr2_tgt_evt_counter_t)(const struct tr2_counter_metadata *meta,
+				    const struct tr2_counter *counter,
+				    int is_final_data);
+
+/*
+ * Call `fn` for each counter of the calling thread that wants
+ * per-thread events and is non-zero.
+ */
+void tr2_emit_per_thread_counters(tr2_tgt_evt_counter_t *fn);
+
+/*
+ * Call `fn` for each counter that is non-zero in the process totals.
+ */
+void tr2_emit_final_counters(tr2_tgt_evt_counter_t *fn);
+
+#endif /* TR2_CTR_H */
@@ -1,6 +1,9 @@
 #ifndef TR2_TGT_H
 #define TR2_TGT_H
 
+#include "trace2/tr2_ctr.h"
+#include "trace2/tr2_tmr.h"
+
 struct child_process;
 struct repository;
 struct json_writer;
@@ -124,6 +127,8 @@ struct tr2_tgt {
 	tr2_tgt_evt_data_fl_t                   *pfn_data_fl;
 	tr2_tgt_evt_data_json_fl_t              *pfn_data_json_fl;
 	tr2_tgt_evt_printf_va_fl_t              *pfn_printf_va_fl;
+	tr2_tgt_evt_timer_t                     *pfn_timer;
+	tr2_tgt_evt_counter_t                   *pfn_counter;
 };
 /* clang-format on */
 
@@ -87,6 +87,13 @@ int tr2tls_is_main_thread(void)
 	return pthread_getspecific(tr2tls_key) == tr2tls_thread_main;
 }
 
+static void free_ctx(struct tr2tls_thread_ctx *ctx)
+{
+	strbuf_release(&ctx->thread_name);
+	free(ctx->array_us_start);
+	free(ctx);
+}
+
 void tr2tls_unset_self(void)
 {
 	struct tr2tls_thread_ctx *ctx;
@@ -95,10 +102,26 @@ void tr2tls_unset_self(void)
 
 	pthread_setspecific(tr2tls_key, NULL);
 
-	free(ctx->array_us_start);
-	free(ctx);
+	free_ctx(ctx);
 }
 
+#ifndef NO_PTHREADS
+/*
+ * Called when a thread exits that still has TLS data, because its
+ * thread-proc did not call trace2_thread_exit() (most do not), or
+ * because it used a timer or counter without trace2_thread_start().
+ * Keep what it measured in the process totals.
+ */
+static void tr2tls_destroy_ctx(void *data)
+{
+	struct tr2tls_thread_ctx *ctx = data;
+
+	tr2_update_final_timers(&ctx->timer_block);
+	tr2_update_final_counters(&ctx->counter_block);
+	free_ctx(ctx);
+}
+#endif
+
 void tr2tls_push_self(uint64_t us_now)
 {
 	struct tr2tls_thread_ctx *ctx = tr2tls_get_self();
@@ -151,7 +174,11 @@ void tr2tls_init(void)
 {
 	tr2tls_start_process_clock();
 
+#ifndef NO_PTHREADS
+	pthread_key_create(&tr2tls_key, tr2tls_destroy_ctx);
+#else
 	pthread_key_create(&tr2tls_key, NULL);
+#endif
 	init_recursive_mutex(&tr2tls_mutex);
 
 	tr2tls_thread_main =
@@ -178,3 +205,13 @@ int tr2tls_locked_increment(int *p)
 
 	return current_value;
 }
+
+void tr2tls_lock(void)
+{
+	pthread_mutex_lock(&tr2tls_mutex);
+}
+
+void tr2tls_unlock(void)
+{
+	pthread_mutex_unlock(&tr2tls_mutex);
+}
@@ -0,0 +1,139 @@
+#include "cache.h"
+#include "thread-utils.h"
+#include "trace2/tr2_tls.h"
+#include "trace2/tr2_tmr.h"
+
+/*
+ * A table of the timers in `enum trace2_timer_id`, indexed by id.
+ */
+/* clang-format off */
+static struct tr2_timer_metadata tr2_timer_metadata[TRACE2_NUMBER_OF_TIMERS] = {
+	[TRACE2_TIMER_ID_TEST1] = {
+		.category = "test",
+		.name = "test1",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_TIMER_ID_TEST2] = {
+		.category = "test",
+		.name = "test2",
+		.want_per_thread_events = 1,
+	},
+	[TRACE2_TIMER_ID_UNPACK_ENTRY] = {
+		.category = "pack",
+		.name = "unpack_entry",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_TIMER_ID_INFLATE] = {
+		.category = "zlib",
+		.name = "inflate",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_TIMER_ID_INDEX_READ] = {
+		.category = "index",
+		.name = "read",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_TIMER_ID_INDEX_WRITE] = {
+		.category = "index",
+		.name = "write",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_TIMER_ID_REFS_ITERATE] = {
+		.category = "refs",
+		.name = "iterate",
+		.want_per_thread_events = 0,
+	},
+};
+/* clang-format on */
+
+/*
+ * The totals of the threads that have exited, and eventually of the
+ * main thread.  Modify under tr2tls_lock().
+ */
+static struct tr2_timer_block final_timer_block;
+
+void tr2_start_timer(enum trace2_timer_id tid)
+{
+	struct tr2tls_thread_ctx *ctx = tr2tls_get_self();
+	struct tr2_timer *t = &ctx->timer_block.timer[tid];
+
+	if (!t->recursion_count++)
+		t->start_ns = getnanotime();
+}
+
+void tr2_stop_timer(enum trace2_timer_id tid)
+{
+	struct tr2tls_thread_ctx *ctx = tr2tls_get_self();
+	struct tr2_timer *t = &ctx->timer_block.timer[tid];
+	uint64_t ns;
+
+	if (!t->recursion_count)
+		BUG("unbalanced stop of timer '%s.%s' in thread '%s'",
+		    tr2_timer_metadata[tid].category,
+		    tr2_timer_metadata[tid].name, ctx->thread_name.buf);
+
+	if (--t->recursion_count)
+		return;
+
+	ns = getnanotime() - t->start_ns;
+	t->total_ns += ns;
+	if (!t->interval_count || ns < t->min_ns)
+		t->min_ns = ns;
+	if (ns > t->max_ns)
+		t->max_ns = ns;
+	t->interval_count++;
+}
+
+void tr2_update_final_timers(const struct tr2_timer_block *block)
+{
+	int tid;
+
+	tr2tls_lock();
+
+	for (tid = 0; tid < TRACE2_NUMBER_OF_TIMERS; tid++) {
+		struct tr2_timer *final = &final_timer_block.timer[tid];
+		const struct tr2_timer *t = &block->timer[tid];
+
+		/*
+		 * A timer still running in an exiting thread has an
+		 * unbalanced start; its open interval is dropped.
+		 */
+		if (!t->interval_count)
+			continue;
+
+		if (!final->interval_count || t->min_ns < final->min_ns)
+			final->min_ns = t->min_ns;
+		if (t->max_ns > final->max_ns)
+			final->max_ns = t->max_ns;
+		final->total_ns += t->total_ns;
+		final->interval_count += t->interval_count;
+	}
+
+	tr2tls_unlock();
+}
+
+void tr2_emit_per_thread_timers(tr2_tgt_evt_timer_t *fn)
+{
+	struct tr2tls_thread_ctx *ctx = tr2tls_get_self();
+	int tid;
+
+	for (tid = 0; tid < TRACE2_NUMBER_OF_TIMERS; tid++) {
+		struct tr2_timer_metadata *meta = &tr2_timer_metadata[tid];
+		struct tr2_timer *t = &ctx->timer_block.timer[tid];
+
+		if (meta->want_per_thread_events && t->interval_count)
+			fn(meta, t, 0);
+	}
+}
+
+void tr2_emit_final_timers(tr2_tgt_evt_timer_t *fn)
+{
+	int tid;
+
+	for (tid = 0; tid < TRACE2_NUMBER_OF_TIMERS; tid++) {
+		struct tr2_timer *final = &final_timer_block.timer[tid];
+
+		if (final->interval_count)
+			fn(&tr2_timer_metadata[tid], final, 1);
+	}
+}
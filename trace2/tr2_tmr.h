@@ -0,0 +1,64 @@
+#ifndef TR2_TMR_H
+#define TR2_TMR_H
+
+#include "trace2.h"
+
+/*
+ * Static description of a timer, see the table in tr2_tmr.c.
+ */
+struct tr2_timer_metadata {
+	const char *category;
+	const char *name;
+
+	/*
+	 * Write a "th_timer" event for each thread that used the timer,
+	 * in addition to the "timer" event with the process totals.
+	 */
+	unsigned int want_per_thread_events:1;
+};
+
+/*
+ * The accumulated time of one timer.
+ */
+struct tr2_timer {
+	uint64_t recursion_count;
+	uint64_t start_ns;
+
+	uint64_t total_ns;
+	uint64_t min_ns;
+	uint64_t max_ns;
+	uint64_t interval_count;
+};
+
+struct tr2_timer_block {
+	struct tr2_timer timer[TRACE2_NUMBER_OF_TIMERS];
+};
+
+/*
+ * Start or stop a timer in the calling thread.
+ */
+void tr2_start_timer(enum trace2_timer_id tid);
+void tr2_stop_timer(enum trace2_timer_id tid);
+
+/*
+ * Add the timers of a thread to the process totals.  This is called
+ * once per thread, when it exits.
+ */
+void tr2_update_final_timers(const struct tr2_timer_block *block);
+
+typedef void(tr2_tgt_evt_timer_t)(const struct tr2_timer_metadata *meta,
+				  const struct tr2_timer *timer,
+				  int is_final_data);
+
+/*
+ * Call `fn` for each timer of the calling thread that wants per-thread
+ * events and has been used.
+ */
+void tr2_emit_per_thread_timers(tr2_tgt_evt_timer_t *fn);
+
+/*
+ * Call `fn` for each timer that has been used by any thread.
+ */
+void tr2_emit_final_timers(tr2_tgt_evt_timer_t *fn);
+
+#endif /* TR2_TMR_H */
@@ -1414,8 +1414,18 @@ void transport_unlock_pack(struct transport *transport)
 {
 	int i;
 
-	for (i = 0; i < transport->pack_lockfiles.nr; i++)
-		unlink_or_warn(transport->pack_lockfiles.items[i].string);
+	for (i = 0; i < transport->pack_lockfiles.nr; i++) {
+		const char *keep = transport->pack_lockfiles.items[i].string;
+		size_t len;
+
+		/* left behind by index-pack --report-foreign, if unused */
+		if (keep && strip_suffix(keep, ".keep", &len)) {
+			char *foreign = xstrfmt("%.*s.foreign", (int)len, keep);
+			unlink_or_warn(foreign);
+			free(foreign);
+		}
+		unlink_or_warn(keep);
+	}
 	string_list_clear(&transport->pack_lockfiles, 0);
 }
 
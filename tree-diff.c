@@ -311,6 +311,57 @@ static void skip_uninteresting(struct tree_desc *t, struct strbuf *base,
 }
 
 
+/*
+ * Length of the common prefix of a[] and b[], up to n bytes. Compare a
+ * word at a time first; most trees that are diffed against each other
+ * share long runs of identical entries.
+ */
+static size_t common_prefix_len(const char *a, const char *b, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+		uint64_t x, y;
+		memcpy(&x, a + i, sizeof(x));
+		memcpy(&y, b + i, sizeof(y));
+		if (x != y)
+			break;
+	}
+	while (i < n && a[i] == b[i])
+		i++;
+	return i;
+}
+
+/*
+ * Skip over the run of entries that are byte-for-byte identical (same
+ * mode, name and object name) at the front of both t and tp. They cannot
+ * contribute anything to a two-tree diff, so there is no need to compare
+ * their paths and object names one by one.
+ */
+static void skip_identical_entries(struct tree_desc *t, struct tree_desc *tp)
+{
+	const unsigned hashsz = the_hash_algo->rawsz;
+	size_t common, skipped = 0;
+
+	if (!t->size || !tp->size)
+		return;
+
+	common = common_prefix_len(t->buffer, tp->buffer,
+				   t->size < tp->size ? t->size : tp->size);
+	while (t->size) {
+		size_t len = t->entry.path - (const char *)t->buffer +
+			     t->entry.pathlen + 1 + hashsz;
+		if (skipped + len > common)
+			break;
+		skipped += len;
+		update_tree_entry(t);
+	}
+	if (skipped)
+		/* tp holds the same bytes up to here */
+		init_tree_desc(tp, (const char *)tp->buffer + skipped,
+			       tp->size - skipped);
+}
+
 /*
  * generate paths for combined diff D(sha1,parents_oid[])
  *
@@ -437,6 +488,9 @@ static struct combine_diff_path *ll_diff_tree_paths(
 		if (opt->max_changes && diff_queued_diff.nr > opt->max_changes)
 			break;
 
+		if (nparent == 1 && !opt->flags.find_copies_harder)
+			skip_identical_entries(&t, &tp[0]);
+
 		if (opt->pathspec.nr) {
 			skip_uninteresting(&t, base, opt);
 			for (i = 0; i < nparent; i++)
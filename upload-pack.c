@@ -27,6 +27,8 @@
 #include "commit-graph.h"
 #include "commit-reach.h"
 #include "shallow.h"
+#include "tempfile.h"
+#include "dir.h"
 
 /* Remember to update object flag allocation in object.h */
 #define THEY_HAVE	(1u << 11)
@@ -106,6 +108,8 @@ struct upload_pack_data {
 	unsigned allow_filter : 1;
 	unsigned allow_filter_fallback : 1;
 	unsigned long tree_filter_max_depth;
+	unsigned pack_cache : 1;
+	unsigned long pack_cache_max_size;
 
 	unsigned done : 1;					/* v2 only */
 	unsigned allow_ref_in_want : 1;				/* v2 only */
@@ -138,6 +142,7 @@ static void upload_pack_data_init(struct upload_pack_data *data)
 	data->allowed_filters = allowed_filters;
 	data->allow_filter_fallback = 1;
 	data->tree_filter_max_depth = ULONG_MAX;
+	data->pack_cache_max_size = 1024 * 1024 * 1024;
 	packet_writer_init(&data->writer, 1);
 
 	data->keepalive = 5;
@@ -184,19 +189,221 @@ static void send_client_data(int fd, const char *data, ssize_t sz,
 
 static int write_one_shallow(const struct commit_graft *graft, void *cb_data)
 {
-	FILE *fp = cb_data;
+	struct strbuf *buf = cb_data;
 	if (graft->nr_parent == -1)
-		fprintf(fp, "--shallow %s\n", oid_to_hex(&graft->oid));
+		strbuf_addf(buf, "--shallow %s\n", oid_to_hex(&graft->oid));
 	return 0;
 }
 
 struct output_state {
 	char buffer[8193];
 	int used;
+	/* if non-NULL, a copy of everything pack-objects says goes here */
+	struct tempfile *cache;
+	/* how much of the pack the kernel moved for us with splice() */
+	uintmax_t spliced;
 	unsigned packfile_uris_started : 1;
 	unsigned packfile_started : 1;
 };
 
+static int hash_one_ref(const char *refname, const struct object_id *oid,
+			int flag, void *cb_data)
+{
+	git_hash_ctx *ctx = cb_data;
+
+	the_hash_algo->update_fn(ctx, oid->hash, the_hash_algo->rawsz);
+	the_hash_algo->update_fn(ctx, refname, strlen(refname) + 1);
+	return 0;
+}
+
+/* Remove the cached packs made for any other state of the refs. */
+static void prune_pack_cache(const char *keep)
+{
+	struct strbuf path = STRBUF_INIT;
+	struct dirent *de;
+	size_t baselen;
+	DIR *dir;
+
+	strbuf_git_path(&path, "upload-pack-cache");
+	dir = opendir(path.buf);
+	if (!dir)
+		goto out;
+	strbuf_addch(&path, '/');
+	baselen = path.len;
+	while ((de = readdir(dir)) != NULL) {
+		if (is_dot_or_dotdot(de->d_name) || !strcmp(de->d_name, keep))
+			continue;
+		strbuf_setlen(&path, baselen);
+		strbuf_addstr(&path, de->d_name);
+		remove_dir_recursively(&path, 0);
+	}
+	closedir(dir);
+out:
+	strbuf_release(&path);
+}
+
+struct cached_pack {
+	char *path;
+	time_t mtime;
+	off_t size;
+};
+
+static int cached_pack_cmp(const void *va, const void *vb)
+{
+	const struct cached_pack *a = va, *b = vb;
+
+	if (a->mtime != b->mtime)
+		return a->mtime < b->mtime ? -1 : 1;
+	return strcmp(a->path, b->path);
+}
+
+/*
+ * Remove the least recently used packs in the directory "dirpath" until
+ * the ones that are left take up no more than "max_size" bytes. A pack
+ * is used when it is written, and every time it answers a request.
+ */
+static void trim_pack_cache(const char *dirpath, unsigned long max_size)
+{
+	struct cached_pack *packs = NULL;
+	size_t nr = 0, alloc = 0, i;
+	struct strbuf path = STRBUF_INIT;
+	uintmax_t total = 0;
+	struct dirent *de;
+	size_t baselen;
+	DIR *dir;
+
+	dir = opendir(dirpath);
+	if (!dir)
+		return;
+	strbuf_addf(&path, "%s/", dirpath);
+	baselen = path.len;
+	while ((de = readdir(dir)) != NULL) {
+		struct stat st;
+
+		/* skip "." and "..", and packs still being written */
+		if (de->d_name[0] == '.' || strchr(de->d_name, '-'))
+			continue;
+		strbuf_setlen(&path, baselen);
+		strbuf_addstr(&path, de->d_name);
+		if (lstat(path.buf, &st) || !S_ISREG(st.st_mode))
+			continue;
+		ALLOC_GROW(packs, nr + 1, alloc);
+		packs[nr].path = xstrdup(path.buf);
+		packs[nr].mtime = st.st_mtime;
+		packs[nr].size = st.st_size;
+		total += st.st_size;
+		nr++;
+	}
+	closedir(dir);
+
+	QSORT(packs, nr, cached_pack_cmp);
+	for (i = 0; i < nr; i++) {
+		if (total > max_size && !unlink(packs[i].path))
+			total -= packs[i].size;
+		free(packs[i].path);
+	}
+	free(packs);
+	strbuf_release(&path);
+}
+
+/*
+ * Look for the output of an earlier pack-objects run with the same
+ * arguments and input, made while the refs were exactly as they are
+ * now; the refs decide which tags --include-tag adds, and any change
+ * to them abandons the whole cache. Returns a descriptor to read that
+ * output from, or -1 after arranging for "os" to record this run into
+ * a temporary file that should be renamed to "path" when it succeeds.
+ */
+static int open_pack_cache(const struct strvec *args,
+			   const struct strbuf *input,
+			   struct output_state *os, struct strbuf *path)
+{
+	git_hash_ctx ctx;
+	unsigned char hash[GIT_MAX_RAWSZ];
+	char refs_hex[GIT_MAX_HEXSZ + 1];
+	int i, fd;
+
+	the_hash_algo->init_fn(&ctx);
+	head_ref(hash_one_ref, &ctx);
+	for_each_rawref(hash_one_ref, &ctx);
+	the_hash_algo->final_fn(hash, &ctx);
+	hash_to_hex_algop_r(refs_hex, hash, the_hash_algo);
+
+	the_hash_algo->init_fn(&ctx);
+	for (i = 0; i < args->nr; i++) {
+		/* progress goes to stderr and is not part of what we keep */
+		if (!strcmp(args->v[i], "--progress"))
+			continue;
+		the_hash_algo->update_fn(&ctx, args->v[i], strlen(args->v[i]) + 1);
+	}
+	the_hash_algo->update_fn(&ctx, input->buf, input->len);
+	the_hash_algo->final_fn(hash, &ctx);
+
+	strbuf_git_path(path, "upload-pack-cache/%s/%s",
+			refs_hex, hash_to_hex(hash));
+	fd = open(path->buf, O_RDONLY);
+	if (fd >= 0) {
+		/* keep it from being the next one to go */
+		utime(path->buf, NULL);
+		return fd;
+	}
+
+	prune_pack_cache(refs_hex);
+	if (!safe_create_leading_directories_const(path->buf)) {
+		struct strbuf tmp = STRBUF_INIT;
+
+		strbuf_addf(&tmp, "%s-XXXXXX", path->buf);
+		os->cache = mks_tempfile(tmp.buf);
+		strbuf_release(&tmp);
+	}
+	return -1;
+}
+
+#ifdef HAVE_SPLICE
+/*
+ * Without a sideband the pack goes out exactly as pack-objects wrote
+ * it, so let the kernel move it from the pipe to our output. To keep
+ * holding back the last byte (see relay_pack_data()), we leave one
+ * byte in the pipe and read it into our buffer afterwards.
+ *
+ * Return the number of bytes moved, or 0 if the caller should read
+ * from the pipe itself.
+ */
+static ssize_t splice_pack_data(int pack_objects_out, struct output_state *os)
+{
+	static int splice_broken;
+	int avail;
+	ssize_t ret;
+
+	if (splice_broken ||
+	    ioctl(pack_objects_out, FIONREAD, &avail) < 0 || avail < 2)
+		return 0;
+
+	if (os->used) {
+		send_client_data(1, os->buffer, os->used, 0);
+		os->used = 0;
+	}
+
+	do {
+		ret = splice(pack_objects_out, NULL, 1, NULL, avail - 1,
+			     SPLICE_F_MOVE | SPLICE_F_MORE);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0 && (errno == EINVAL || errno == ENOSYS)) {
+		/* Our output does not support it; never try again. */
+		splice_broken = 1;
+		return 0;
+	}
+	if (ret < 0)
+		die_errno(_("unable to send pack data"));
+
+	if (xread(pack_objects_out, os->buffer, 1) != 1)
+		die_errno(_("unable to read pack data"));
+	os->used = 1;
+	os->spliced += ret;
+	return ret + 1;
+}
+#endif
+
 static int relay_pack_data(int pack_objects_out, struct output_state *os,
 			   int use_sideband, int write_packfile_line)
 {
@@ -212,11 +419,23 @@ static int relay_pack_data(int pack_objects_out, struct output_state *os,
 	 */
 	ssize_t readsz;
 
+#ifdef HAVE_SPLICE
+	if (!use_sideband && os->packfile_started && !os->cache) {
+		readsz = splice_pack_data(pack_objects_out, os);
+		if (readsz)
+			return readsz;
+	}
+#endif
+
 	readsz = xread(pack_objects_out, os->buffer + os->used,
 		       sizeof(os->buffer) - os->used);
 	if (readsz < 0) {
 		return readsz;
 	}
+	if (os->cache &&
+	    write_in_full(get_tempfile_fd(os->cache),
+			  os->buffer + os->used, readsz) < 0)
+		delete_tempfile(&os->cache);
 	os->used += readsz;
 
 	while (!os->packfile_started) {
@@ -272,7 +491,9 @@ static void create_pack_file(struct upload_pack_data *pack_data,
 		"corruption on the remote side.";
 	ssize_t sz;
 	int i;
-	FILE *pipe_fd;
+	struct strbuf input = STRBUF_INIT;
+	struct strbuf cache_path = STRBUF_INIT;
+	int cache_fd = -1;
 
 	if (!pack_data->pack_objects_hook)
 		pack_objects.git_cmd = 1;
@@ -318,6 +539,35 @@ static void create_pack_file(struct upload_pack_data *pack_data,
 					 uri_protocols->items[i].string);
 	}
 
+	if (pack_data->shallow_nr)
+		for_each_commit_graft(write_one_shallow, &input);
+
+	for (i = 0; i < pack_data->want_obj.nr; i++)
+		strbuf_addf(&input, "%s\n",
+			    oid_to_hex(&pack_data->want_obj.objects[i].item->oid));
+	strbuf_addstr(&input, "--not\n");
+	for (i = 0; i < pack_data->have_obj.nr; i++)
+		strbuf_addf(&input, "%s\n",
+			    oid_to_hex(&pack_data->have_obj.objects[i].item->oid));
+	for (i = 0; i < pack_data->extra_edge_obj.nr; i++)
+		strbuf_addf(&input, "%s\n",
+			    oid_to_hex(&pack_data->extra_edge_obj.objects[i].item->oid));
+	strbuf_addch(&input, '\n');
+
+	if (pack_data->pack_cache && !pack_data->pack_objects_hook)
+		cache_fd = open_pack_cache(&pack_objects.args, &input,
+					   &output_state, &cache_path);
+	if (cache_fd >= 0) {
+		while ((sz = relay_pack_data(cache_fd, &output_state,
+					     pack_data->use_sideband,
+					     !!uri_protocols)) > 0)
+			; /* keep going */
+		close(cache_fd);
+		if (sz < 0)
+			goto fail;
+		goto flush;
+	}
+
 	pack_objects.in = -1;
 	pack_objects.out = -1;
 	pack_objects.err = -1;
@@ -325,24 +575,8 @@ static void create_pack_file(struct upload_pack_data *pack_data,
 	if (start_command(&pack_objects))
 		die("git upload-pack: unable to fork git-pack-objects");
 
-	pipe_fd = xfdopen(pack_objects.in, "w");
-
-	if (pack_data->shallow_nr)
-		for_each_commit_graft(write_one_shallow, pipe_fd);
-
-	for (i = 0; i < pack_data->want_obj.nr; i++)
-		fprintf(pipe_fd, "%s\n",
-			oid_to_hex(&pack_data->want_obj.objects[i].item->oid));
-	fprintf(pipe_fd, "--not\n");
-	for (i = 0; i < pack_data->have_obj.nr; i++)
-		fprintf(pipe_fd, "%s\n",
-			oid_to_hex(&pack_data->have_obj.objects[i].item->oid));
-	for (i = 0; i < pack_data->extra_edge_obj.nr; i++)
-		fprintf(pipe_fd, "%s\n",
-			oid_to_hex(&pack_data->extra_edge_obj.objects[i].item->oid));
-	fprintf(pipe_fd, "\n");
-	fflush(pipe_fd);
-	fclose(pipe_fd);
+	write_in_full(pack_objects.in, input.buf, input.len);
+	close(pack_objects.in);
 
 	/* We read from pack_objects.err to capture stderr output for
 	 * progress bar, and pack_objects.out to capture the pack data.
@@ -439,7 +673,18 @@ static void create_pack_file(struct upload_pack_data *pack_data,
 		error("git upload-pack: git-pack-objects died with error.");
 		goto fail;
 	}
+	if (output_state.spliced)
+		trace2_data_intmax("upload-pack", the_repository,
+				   "spliced-bytes", output_state.spliced);
+	if (output_state.cache &&
+	    !rename_tempfile(&output_state.cache, cache_path.buf)) {
+		char *slash = find_last_dir_sep(cache_path.buf);
+
+		strbuf_setlen(&cache_path, slash - cache_path.buf);
+		trim_pack_cache(cache_path.buf, pack_data->pack_cache_max_size);
+	}
 
+flush:
 	/* flush the data */
 	if (output_state.used > 0) {
 		send_client_data(1, output_state.buffer, output_state.used,
@@ -448,6 +693,8 @@ static void create_pack_file(struct upload_pack_data *pack_data,
 	}
 	if (pack_data->use_sideband)
 		packet_flush(1);
+	strbuf_release(&input);
+	strbuf_release(&cache_path);
 	return;
 
  fail:
@@ -1297,6 +1544,10 @@ static int upload_pack_config(const char *var, const char *value, void *cb_data)
 		data->allow_ref_in_want = git_config_bool(var, value);
 	} else if (!strcmp("uploadpack.allowsidebandall", var)) {
 		data->allow_sideband_all = git_config_bool(var, value);
+	} else if (!strcmp("uploadpack.packcache", var)) {
+		data->pack_cache = git_config_bool(var, value);
+	} else if (!strcmp("uploadpack.packcachemaxsize", var)) {
+		data->pack_cache_max_size = git_config_ulong(var, value);
 	} else if (!strcmp("core.precomposeunicode", var)) {
 		precomposed_unicode = git_config_bool(var, value);
 	}
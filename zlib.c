@@ -111,7 +111,9 @@ void git_inflate_end(git_zstream *strm)
 int git_inflate(git_zstream *strm, int flush)
 {
 	int status;
+	unsigned long total_out = strm->total_out;
 
+	trace2_timer_start(TRACE2_TIMER_ID_INFLATE);
 	for (;;) {
 		zlib_pre_call(strm);
 		/* Never say Z_FINISH unless we are feeding everything */
@@ -131,6 +133,9 @@ int git_inflate(git_zstream *strm, int flush)
 			continue;
 		break;
 	}
+	trace2_timer_stop(TRACE2_TIMER_ID_INFLATE);
+	trace2_counter_add(TRACE2_COUNTER_ID_INFLATED_BYTES,
+			   strm->total_out - total_out);
 
 	switch (status) {
 	/* Z_BUF_ERROR: normal, needs more space in the output buffer */